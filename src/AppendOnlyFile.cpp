@@ -0,0 +1,554 @@
+#include "AppendOnlyFile.h"
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+// 读取一个"前缀+数字\r\n"形式的长度行
+bool readLength(std::string_view data, size_t &position, char prefix, long &length)
+{
+    if (position >= data.size() || data[position] != prefix)
+    {
+        return false;
+    }
+    size_t end = data.find("\r\n", position);
+    if (end == std::string_view::npos)
+    {
+        return false;
+    }
+    try
+    {
+        length = std::stol(std::string(data.substr(position + 1, end - position - 1)));
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    position = end + 2;
+    return length >= 0;
+}
+
+// 从position处解析一条RESP数组记录，成功时position移到记录之后，tokens指向data中的参数
+bool parseRecord(std::string_view data, size_t &position, TokenBuffer &tokens)
+{
+    long number = 0;
+    tokens.clear();
+    if (!readLength(data, position, '*', number))
+    {
+        return false;
+    }
+    for (long i = 0; i < number; i++)
+    {
+        long length = 0;
+        if (!readLength(data, position, '$', length) || position + length + 2 > data.size())
+        {
+            return false;
+        }
+        tokens.push_back(data.substr(position, length));
+        position += length + 2;
+    }
+    return !tokens.empty();
+}
+
+// 记录是否是日志开头的代数记录，是则通过generation返回代数
+bool parseHeader(TokenSpan tokens, uint64_t &generation)
+{
+    if (tokens.size() != 2 || tokens[0] != AOF_HEADER_COMMAND || tokens[1].empty())
+    {
+        return false;
+    }
+    std::string value(tokens[1]);
+    char *end = nullptr;
+    errno = 0;
+    uint64_t parsed = std::strtoull(value.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || parsed == 0)
+    {
+        return false;
+    }
+    generation = parsed;
+    return true;
+}
+}
+
+/**
+ * 打开日志文件并启动写线程。新建的日志先写入代数记录，已有的日志沿用文件开头记录的代数。
+ *
+ * @param filePath 日志文件路径。
+ * @param policy 刷盘策略。
+ */
+AppendOnlyFile::AppendOnlyFile(const std::string &filePath, FsyncPolicy policy)
+    : filePath(filePath), policy(policy)
+{
+    fd = open(filePath.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        std::cout << "文件：" << filePath << "打开失败" << std::endl;
+        return;
+    }
+    off_t size = lseek(fd, 0, SEEK_END);
+    fileSize = size > 0 ? size : 0;
+    if (fileSize == 0)
+    {
+        generation = newGeneration();
+        std::string header;
+        encodeHeader(generation, header);
+        if (!writeAll(fd, header) || fsync(fd) != 0)
+        {
+            std::cout << "文件：" << filePath << "写入失败" << std::endl;
+        }
+        fileSize = header.size();
+        syncDirectory(filePath);
+    }
+    else
+    {
+        generation = readGeneration(filePath);
+    }
+    appendedSize = fileSize;
+    writer = std::thread(&AppendOnlyFile::writerLoop, this);
+}
+
+/**
+ * 写完缓冲区中剩余的数据并刷盘，然后关闭文件。
+ */
+AppendOnlyFile::~AppendOnlyFile()
+{
+    if (fd < 0)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopWriter = true;
+    }
+    writerCondition.notify_one();
+    writer.join();
+    if (nextFd >= 0)
+    {
+        close(fd);
+        fd = nextFd;
+    }
+    fsync(fd);
+    close(fd);
+}
+
+void AppendOnlyFile::encodeCommand(TokenSpan tokens, std::string &out)
+{
+    out += "*" + std::to_string(tokens.size()) + "\r\n";
+    for (std::string_view token : tokens)
+    {
+        out += "$" + std::to_string(token.size()) + "\r\n";
+        out += token;
+        out += "\r\n";
+    }
+}
+
+void AppendOnlyFile::encodeCommand(const std::vector<std::string> &tokens, std::string &out)
+{
+    TokenBuffer views;
+    viewTokens(tokens, views);
+    encodeCommand(TokenSpan(views), out);
+}
+
+void AppendOnlyFile::encodeHeader(uint64_t generation, std::string &out)
+{
+    encodeCommand({AOF_HEADER_COMMAND, std::to_string(generation)}, out);
+}
+
+/**
+ * 生成新的代数。代数要在重启后仍能区分不同的日志文件，所以用随机数而不是计数器。
+ *
+ * @return 返回非零的代数。
+ */
+uint64_t AppendOnlyFile::newGeneration()
+{
+    std::random_device device;
+    uint64_t value = 0;
+    while (value == 0)
+    {
+        value = (static_cast<uint64_t>(device()) << 32) ^ device() ^
+                static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    }
+    return value;
+}
+
+uint64_t AppendOnlyFile::readGeneration(const std::string &filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    char data[64]; // 代数记录不超过64字节
+    file.read(data, sizeof(data));
+    size_t position = 0;
+    TokenBuffer tokens;
+    uint64_t generation = 0;
+    if (parseRecord(std::string_view(data, file.gcount()), position, tokens))
+    {
+        parseHeader(tokens, generation);
+    }
+    return generation;
+}
+
+/**
+ * 刷盘文件所在的目录。rename只修改目录项，目录刷盘后替换才能在断电后保留。
+ *
+ * @param filePath 目录中的文件路径。
+ */
+void AppendOnlyFile::syncDirectory(const std::string &filePath)
+{
+    size_t slash = filePath.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : filePath.substr(0, slash + 1);
+    int directoryFd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directoryFd >= 0)
+    {
+        fsync(directoryFd);
+        close(directoryFd);
+    }
+}
+
+/**
+ * 追加一条命令。命令所在的数据库和上一条记录不同时，先追加一条select记录。
+ * 只放入缓冲区，不等待写入；调用方通常在分片锁内追加，释放锁后再调用waitWritten，
+ * 这样always策略下等待刷盘时不占用分片锁，多条命令仍能合并成一次fsync。
+ *
+ * @param dataBaseIndex 命令执行时所在的数据库。
+ * @param tokens 命令及其参数。
+ * @return 返回记录的编号，日志没有打开时返回0。
+ */
+uint64_t AppendOnlyFile::append(int dataBaseIndex, TokenSpan tokens)
+{
+    if (fd < 0)
+    {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    size_t pendingSize = pending.size();
+    if (dataBaseIndex != lastDataBase)
+    {
+        encodeCommand({"select", std::to_string(dataBaseIndex)}, pending);
+        lastDataBase = dataBaseIndex;
+    }
+    size_t commandStart = pending.size();
+    encodeCommand(tokens, pending);
+    if (rewriting)
+    {
+        // 重写缓冲区有自己的数据库上下文，select记录单独判断
+        if (dataBaseIndex != rewriteLastDataBase)
+        {
+            encodeCommand({"select", std::to_string(dataBaseIndex)}, rewriteBuffer);
+            rewriteLastDataBase = dataBaseIndex;
+        }
+        rewriteBuffer.append(pending, commandStart, std::string::npos);
+    }
+    appendedSize += pending.size() - pendingSize;
+    uint64_t number = ++appendedNumber;
+    writerCondition.notify_one();
+    return number;
+}
+
+/**
+ * always策略下等到编号为number的记录刷盘后才返回，其他策略下直接返回。
+ *
+ * @param number append返回的记录编号，0表示没有记录需要等待。
+ */
+void AppendOnlyFile::waitWritten(uint64_t number)
+{
+    if (policy != FSYNC_ALWAYS || number == 0)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    writtenCondition.wait(lock, [this, number]
+                          { return writtenNumber >= number; });
+}
+
+/**
+ * 清空日志。先等写线程写完缓冲区中的数据，再截断文件，写入新代数的记录。
+ * 之后的重放从0号数据库开始，所以下一条记录如果不在0号数据库会先写入select。
+ */
+void AppendOnlyFile::truncate()
+{
+    if (fd < 0)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    writtenCondition.wait(lock, [this]
+                          { return writtenNumber >= appendedNumber; });
+    generation = newGeneration();
+    std::string header;
+    encodeHeader(generation, header);
+    if (ftruncate(fd, 0) != 0 || !writeAll(fd, header))
+    {
+        std::cout << "文件：" << filePath << "截断失败" << std::endl;
+    }
+    fsync(fd);
+    lastDataBase = 0;
+    fileSize = header.size();
+    appendedSize = fileSize;
+    rewriteBaseSize = 0;
+}
+
+bool AppendOnlyFile::writeAll(int fd, const std::string &data)
+{
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        ssize_t written = write(fd, data.data() + offset, data.size() - offset);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        offset += written;
+    }
+    return true;
+}
+
+/**
+ * 写线程：每次取走缓冲区中的全部数据，一次写入；按刷盘策略决定是否fsync。
+ * 写完后唤醒所有等待这一批记录的调用方。
+ * 重写完成后由写线程切换到新文件，保证切换前后的数据写入正确的文件。
+ */
+void AppendOnlyFile::writerLoop()
+{
+    std::string batch;
+    auto lastSync = std::chrono::steady_clock::now();
+    bool unsynced = false; //是否有已写入但未刷盘的数据
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        writerCondition.wait_for(lock, std::chrono::seconds(1), [this]
+                                 { return stopWriter || !pending.empty() || nextFd >= 0; });
+        int oldFd = -1;
+        if (nextFd >= 0)
+        {
+            oldFd = fd;
+            fd = nextFd;
+            nextFd = -1;
+        }
+        if (pending.empty() && stopWriter)
+        {
+            if (oldFd >= 0)
+            {
+                close(oldFd);
+            }
+            break;
+        }
+        batch.clear();
+        batch.swap(pending);
+        uint64_t number = appendedNumber;
+        int currentFd = fd;
+        lock.unlock();
+        if (oldFd >= 0)
+        {
+            close(oldFd); // 旧文件的内容在切换前已经刷盘
+        }
+        if (!batch.empty())
+        {
+            if (!writeAll(currentFd, batch))
+            {
+                std::cout << "文件：" << filePath << "写入失败" << std::endl;
+            }
+            unsynced = true;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (unsynced && (policy == FSYNC_ALWAYS || (policy == FSYNC_EVERYSEC && now - lastSync >= std::chrono::seconds(1))))
+        {
+            fdatasync(currentFd);
+            lastSync = now;
+            unsynced = false;
+        }
+        lock.lock();
+        writtenNumber = number;
+        fileSize += batch.size();
+        writtenCondition.notify_all();
+    }
+}
+
+/**
+ * 日志是否需要自动重写：超过最小大小，并且比上次重写后增长了AOF_REWRITE_PERCENTAGE。
+ *
+ * @return 需要重写返回true。
+ */
+bool AppendOnlyFile::needsRewrite()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0 || rewriting || fileSize < AOF_REWRITE_MIN_SIZE)
+    {
+        return false;
+    }
+    return fileSize >= rewriteBaseSize + rewriteBaseSize * AOF_REWRITE_PERCENTAGE / 100;
+}
+
+/**
+ * 开始重写：之后追加的记录同时复制一份到重写缓冲区。
+ * 调用方需保证和fork之间没有并发的append，这样缓冲区正好接在子进程看到的数据之后。
+ *
+ * @param dataBaseIndex fork时所在的数据库，也是重写后的日志结束时所在的数据库。
+ * @return 返回重写后的日志使用的代数，子进程把它写在新日志的开头。
+ */
+uint64_t AppendOnlyFile::startRewrite(int dataBaseIndex)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    rewriting = true;
+    rewriteBuffer.clear();
+    rewriteLastDataBase = dataBaseIndex;
+    rewriteGeneration = newGeneration();
+    return rewriteGeneration;
+}
+
+void AppendOnlyFile::abortRewrite()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    rewriting = false;
+    std::string().swap(rewriteBuffer);
+}
+
+/**
+ * 完成重写：把重写期间缓冲的记录追加到子进程写好的新日志，刷盘后用rename原子地替换旧日志，
+ * 再通知写线程切换到新文件。调用方需保证期间没有并发的append。
+ *
+ * @param imagePath 子进程写好的新日志路径。
+ * @return 替换成功返回true；失败时删除新日志，旧日志保持不变。
+ */
+bool AppendOnlyFile::finishRewrite(const std::string &imagePath)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    rewriting = false;
+    // 等写线程把旧日志写完，保证替换之后不会再有数据写入旧文件
+    writtenCondition.wait(lock, [this]
+                          { return writtenNumber >= appendedNumber && nextFd < 0; });
+    int imageFd = open(imagePath.c_str(), O_WRONLY | O_APPEND);
+    bool success = imageFd >= 0 && writeAll(imageFd, rewriteBuffer) && fsync(imageFd) == 0;
+    if (success && std::rename(imagePath.c_str(), filePath.c_str()) != 0)
+    {
+        success = false;
+    }
+    if (!success)
+    {
+        if (imageFd >= 0)
+        {
+            close(imageFd);
+        }
+        std::remove(imagePath.c_str());
+        std::string().swap(rewriteBuffer);
+        return false;
+    }
+    syncDirectory(filePath);
+    off_t size = lseek(imageFd, 0, SEEK_END);
+    fileSize = size > 0 ? size : 0;
+    rewriteBaseSize = fileSize;
+    appendedSize = fileSize;
+    generation = rewriteGeneration;
+    lastDataBase = rewriteLastDataBase;
+    std::string().swap(rewriteBuffer);
+    fdatasync(fd); // 旧日志的内容已被新日志包含，这里只是保证切换前的数据不丢
+    nextFd = imageFd;
+    writerCondition.notify_one();
+    return true;
+}
+
+/**
+ * 记录当前日志末尾的位置（包括还在缓冲区中的记录）。
+ *
+ * @return 返回当前位置。
+ */
+AppendOnlyFile::Position AppendOnlyFile::position()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Position current;
+    current.generation = generation;
+    current.offset = appendedSize;
+    current.dataBaseIndex = lastDataBase;
+    return current;
+}
+
+uint64_t AppendOnlyFile::size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return appendedSize;
+}
+
+/**
+ * 先写入代数记录，再把producer产生的命令编码后写入文件，按块写入，最后刷盘。
+ *
+ * @param filePath 要写入的文件路径。
+ * @param generation 新日志的代数，由startRewrite生成。
+ * @param producer 产生命令的函数，每条命令交给传入的回调。
+ * @return 全部写入并刷盘成功返回true。
+ */
+bool AppendOnlyFile::writeImage(const std::string &filePath, uint64_t generation, const std::function<void(const CommandSink &)> &producer)
+{
+    int imageFd = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (imageFd < 0)
+    {
+        return false;
+    }
+    std::string buffer;
+    encodeHeader(generation, buffer);
+    bool success = true;
+    producer([&buffer, &success, imageFd](const std::vector<std::string> &tokens)
+             {
+        encodeCommand(tokens, buffer);
+        if (buffer.size() >= 64 * 1024)
+        {
+            success = success && writeAll(imageFd, buffer);
+            buffer.clear();
+        } });
+    success = success && writeAll(imageFd, buffer) && fsync(imageFd) == 0;
+    close(imageFd);
+    return success;
+}
+
+/**
+ * 读取日志文件并逐条重放。文件末尾不完整的记录（写入过程中崩溃）会被忽略。
+ * 开头的代数记录不交给apply；日志中的select记录由append插入，据此跟踪之后每条记录所在的数据库。
+ *
+ * @param filePath 日志文件路径。
+ * @param apply 执行一条命令的回调，参数直接指向读入的文件内容，只在回调期间有效；
+ *              同时给出记录的位置，调用方据此跳过快照已经包含的记录。
+ * @return 返回读到的命令条数。
+ */
+int AppendOnlyFile::replay(const std::string &filePath, const std::function<void(TokenSpan, const Position &)> &apply)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open())
+    {
+        return 0;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t position = 0;
+    int count = 0;
+    Position record; //当前记录的位置，没有代数记录的旧日志代数为0
+    TokenBuffer tokens;
+    while (position < data.size())
+    {
+        size_t recordStart = position;
+        if (!parseRecord(data, position, tokens))
+        {
+            std::cout << "文件：" << filePath << "在偏移" << recordStart << "处的记录不完整，已忽略之后的内容" << std::endl;
+            break;
+        }
+        if (recordStart == 0 && parseHeader(tokens, record.generation))
+        {
+            continue;
+        }
+        record.offset = recordStart;
+        apply(tokens, record);
+        count++;
+        if (tokens.size() == 2 && tokens[0] == "select")
+        {
+            record.dataBaseIndex = std::atoi(std::string(tokens[1]).c_str());
+        }
+    }
+    return count;
+}
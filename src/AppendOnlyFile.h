@@ -0,0 +1,107 @@
+#ifndef APPEND_ONLY_FILE_H
+#define APPEND_ONLY_FILE_H
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TokenSpan.h"
+#define DEFAULT_AOF_FILE_NAME "appendonly.aof"
+#define DEFAULT_FSYNC_POLICY FSYNC_EVERYSEC //默认每秒刷盘一次
+#define AOF_REWRITE_MIN_SIZE (64 * 1024 * 1024) //日志超过这个大小才会自动重写
+#define AOF_REWRITE_PERCENTAGE 100 //日志比上次重写后增长超过这个百分比时自动重写
+#define AOF_HEADER_COMMAND "aof-generation" //每份日志文件的第一条记录，参数是这份日志的代数
+
+// 刷盘策略
+enum FsyncPolicy
+{
+    FSYNC_ALWAYS,   // 每条命令返回前都已刷盘
+    FSYNC_EVERYSEC, // 每秒刷盘一次，最多丢失一秒的数据
+    FSYNC_NO        // 只写入操作系统缓存，由操作系统决定何时刷盘
+};
+
+/*
+    追加日志：以RESP格式（*参数个数 $长度 内容）记录修改数据的命令，启动时重放。
+    日志只记录上一次完整写入快照之后的命令，快照写完后调用truncate清空。
+    命令所在的数据库变化时自动插入一条select记录，重放从0号数据库开始。
+    每份日志文件以一条AOF_HEADER_COMMAND记录开头，记下这份日志的代数（随机生成的非零值），
+    重启后代数不变。快照记下写入时日志的代数和偏移，重放时跳过快照已经包含的记录，
+    所以快照替换和日志清空之间崩溃不会重复执行命令。
+    写入由专门的线程完成：调用方把记录放入缓冲区后返回，写线程一次取走缓冲区中的
+    所有记录，一次write、一次fsync提交一批（group commit）。
+    always策略下命令返回前用waitWritten等到自己的记录刷盘。
+    重写：子进程把fork时的数据库写成一份重建命令（writeImage），期间新的记录除了照常写入旧日志，
+    还会复制一份到重写缓冲区；子进程完成后把缓冲区追加到新日志，再原子地替换旧日志。
+    后台保存快照：fork时用position记下日志的位置，写在快照头部；日志不在保存后裁剪，
+    重放时跳过快照已包含的记录，日志的大小由自动重写控制。
+    日志被清空或重写后换成新的代数，之前记下的位置随之失效。
+*/
+class AppendOnlyFile
+{
+private:
+    std::string filePath;
+    FsyncPolicy policy;
+    int fd = -1;
+    std::mutex mutex;
+    std::condition_variable writerCondition; //通知写线程有新数据
+    std::condition_variable writtenCondition; //通知等待者数据已写入
+    std::string pending; //等待写线程写入的数据
+    uint64_t appendedNumber = 0; //已放入缓冲区的记录数
+    uint64_t writtenNumber = 0; //已写入文件（always策略下已刷盘）的记录数
+    int lastDataBase = 0; //最后一条记录所在的数据库
+    int nextFd = -1; //重写完成后写线程要切换到的新文件
+    uint64_t fileSize = 0; //日志文件当前大小
+    uint64_t rewriteBaseSize = 0; //上次重写完成时的日志大小
+    bool rewriting = false; //是否正在重写
+    std::string rewriteBuffer; //重写期间到达的记录
+    int rewriteLastDataBase = 0; //重写缓冲区中最后一条记录所在的数据库
+    uint64_t appendedSize = 0; //缓冲区中的数据全部写入后日志文件的大小
+    uint64_t generation = 0; //当前日志文件的代数，0表示旧版本没有文件头的日志
+    uint64_t rewriteGeneration = 0; //重写后的日志使用的代数
+    bool stopWriter = false;
+    std::thread writer;
+
+private:
+    void writerLoop();
+    static bool writeAll(int fd, const std::string &data);
+    static uint64_t newGeneration(); //生成一个新的非零代数
+    static void encodeHeader(uint64_t generation, std::string &out); //编码日志文件开头的代数记录
+    static uint64_t readGeneration(const std::string &filePath); //读取日志文件开头记录的代数，没有时返回0
+
+public:
+    typedef std::function<void(const std::vector<std::string> &)> CommandSink; //接收一条命令的回调
+    // 日志中的一个位置
+    struct Position
+    {
+        uint64_t generation = 0; //记录位置时日志的代数，0表示不对应任何日志
+        uint64_t offset = 0; //位置在文件中的偏移
+        int dataBaseIndex = 0; //位置之前最后一条记录所在的数据库
+    };
+    AppendOnlyFile(const std::string &filePath, FsyncPolicy policy = DEFAULT_FSYNC_POLICY);
+    ~AppendOnlyFile();
+    AppendOnlyFile(const AppendOnlyFile &) = delete;
+    AppendOnlyFile &operator=(const AppendOnlyFile &) = delete;
+    bool isOpen() const { return fd >= 0; }
+    uint64_t append(int dataBaseIndex, TokenSpan tokens); //追加一条命令，返回记录的编号，不等待写入
+    void waitWritten(uint64_t number); //always策略下等待编号为number的记录刷盘
+    void truncate(); //快照写完后清空日志，调用方需保证期间没有并发的append
+    bool needsRewrite(); //日志是否增长到需要自动重写
+    //开始缓冲重写期间的记录，dataBaseIndex是fork时所在的数据库，返回重写后的日志使用的代数
+    uint64_t startRewrite(int dataBaseIndex);
+    bool finishRewrite(const std::string &imagePath); //追加缓冲区到新日志并替换旧日志
+    void abortRewrite(); //放弃重写，丢弃缓冲区
+    Position position(); //当前日志末尾的位置，调用方需保证和fork之间没有并发的append
+    uint64_t size(); //日志当前大小
+    static void encodeCommand(TokenSpan tokens, std::string &out); //编码成RESP数组
+    static void encodeCommand(const std::vector<std::string> &tokens, std::string &out);
+    //写入代数记录和producer产生的命令并刷盘，用于在子进程中生成重写后的日志
+    static bool writeImage(const std::string &filePath, uint64_t generation, const std::function<void(const CommandSink &)> &producer);
+    //按顺序读取日志中的命令交给apply执行，同时给出记录的位置（代数、记录开头的偏移和记录所在的数据库），
+    //返回读到的命令数，代数记录不交给apply，末尾不完整的记录会被忽略
+    static int replay(const std::string &filePath, const std::function<void(TokenSpan, const Position &)> &apply);
+    static void syncDirectory(const std::string &filePath); //刷盘filePath所在的目录，保证rename后的目录项不会丢失
+};
+
+#endif
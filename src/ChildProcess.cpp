@@ -0,0 +1,138 @@
+#include "ChildProcess.h"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+// 统计当前进程的Private_Dirty（KB），子进程中这部分就是fork之后因写时复制而独占的内存
+long privateDirtySize()
+{
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    if (!smaps.is_open())
+    {
+        smaps.open("/proc/self/smaps");
+    }
+    if (!smaps.is_open())
+    {
+        return -1;
+    }
+    long total = 0;
+    std::string line;
+    while (std::getline(smaps, line))
+    {
+        if (line.compare(0, 14, "Private_Dirty:") == 0)
+        {
+            total += std::atol(line.c_str() + 14);
+        }
+    }
+    return total;
+}
+}
+
+/**
+ * fork一个子进程执行childMain，子进程以childMain的返回值退出。
+ *
+ * @param childMain 子进程中执行的函数，返回0表示成功。
+ * @param cowFd 不为空时创建管道并输出读端，子进程退出前写入写时复制的大小。
+ * @return 父进程中返回子进程的pid，fork失败返回-1。
+ */
+pid_t ChildProcess::start(const std::function<int()> &childMain, int *cowFd)
+{
+    int pipeFds[2] = {-1, -1};
+    if (cowFd != nullptr && pipe2(pipeFds, O_CLOEXEC) != 0)
+    {
+        pipeFds[0] = pipeFds[1] = -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // 子进程不能走正常退出流程，否则会执行静态对象的析构（例如把数据库写回文件）
+        int exitCode = 1;
+        try
+        {
+            exitCode = childMain();
+        }
+        catch (...)
+        {
+        }
+        if (pipeFds[1] >= 0)
+        {
+            std::string report = std::to_string(privateDirtySize()) + "\n";
+            ssize_t written = write(pipeFds[1], report.data(), report.size());
+            (void)written;
+        }
+        _exit(exitCode);
+    }
+    if (pipeFds[1] >= 0)
+    {
+        close(pipeFds[1]);
+    }
+    if (cowFd != nullptr)
+    {
+        if (pid < 0 && pipeFds[0] >= 0)
+        {
+            close(pipeFds[0]);
+            pipeFds[0] = -1;
+        }
+        *cowFd = pipeFds[0];
+    }
+    return pid;
+}
+
+/**
+ * 读取子进程写入管道的写时复制大小，子进程结束后调用，读取后关闭管道。
+ *
+ * @param cowFd 管道读端。
+ * @return 返回写时复制的大小（KB），子进程没有报告时返回-1。
+ */
+long ChildProcess::readCowSize(int cowFd)
+{
+    if (cowFd < 0)
+    {
+        return -1;
+    }
+    char buffer[32] = {0};
+    ssize_t length = read(cowFd, buffer, sizeof(buffer) - 1);
+    close(cowFd);
+    if (length <= 0)
+    {
+        return -1;
+    }
+    return std::atol(buffer);
+}
+
+/**
+ * 非阻塞地检查子进程的状态。
+ *
+ * @param pid 子进程pid。
+ * @param exitCode 子进程结束时输出退出码，被信号杀死时为-1。
+ * @return 子进程已结束返回true，仍在运行返回false。
+ */
+bool ChildProcess::poll(pid_t pid, int &exitCode)
+{
+    int status = 0;
+    pid_t result = waitpid(pid, &status, WNOHANG);
+    if (result == 0)
+    {
+        return false;
+    }
+    if (result < 0)
+    {
+        exitCode = -1;
+        return true;
+    }
+    exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    return true;
+}
+
+void ChildProcess::terminate(pid_t pid)
+{
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
@@ -0,0 +1,22 @@
+#ifndef CHILD_PROCESS_H
+#define CHILD_PROCESS_H
+#include <functional>
+#include <sys/types.h>
+
+/*
+    子进程辅助类：fork出子进程执行后台任务（重写日志、保存快照），
+    子进程借助写时复制看到fork那一刻的内存，执行完后直接_exit，不运行父进程的析构和退出处理。
+    可以传入cowFd取得一个管道，子进程退出前把自己的Private_Dirty大小（写时复制产生的内存）写入管道。
+    调用方负责在fork前让数据处于一致状态（RedisHelper::forkChild会持有所有分片的读锁）。
+*/
+class ChildProcess
+{
+public:
+    //fork并在子进程中执行childMain，失败返回-1；cowFd不为空时输出读取写时复制大小的管道
+    static pid_t start(const std::function<int()> &childMain, int *cowFd = nullptr);
+    static long readCowSize(int cowFd); //读取子进程报告的写时复制大小（KB）并关闭管道，没有报告时返回-1
+    static bool poll(pid_t pid, int &exitCode); //非阻塞地检查子进程是否结束，结束时返回true并回收
+    static void terminate(pid_t pid); //杀死并回收子进程
+};
+
+#endif
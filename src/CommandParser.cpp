@@ -5,271 +5,355 @@ std::shared_ptr<RedisHelper> CommandParser::redisHelper = std::make_shared<Redis
 
 // SelectParser 
 //select命令来选择数据库
-std::string SelectParser::parse(std::vector<std::string>& tokens) {
+std::string SelectParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for SELECT.";
+        return errorReply("wrong number of arguments for SELECT.");
     }
     int index = 0;
     try {
-        index = std::stoi(tokens[1]); //将字符串转换为整数
+        index = std::stoi(std::string(tokens[1])); //将字符串转换为整数
     } catch (std::invalid_argument const& e) { //如果转换失败
-        return tokens[1] + " is not a numeric type"; //返回错误信息
+        return errorReply(std::string(tokens[1]) + " is not a numeric type"); //返回错误信息
     }
     return redisHelper->select(index); //调用RedisHelper的select方法
 }
 
 // SetParser 
-std::string SetParser::parse(std::vector<std::string>& tokens) {
+std::string SetParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for SET.";
+        return errorReply("wrong number of arguments for SET.");
     }
     if (tokens.size() == 4) {
         if (tokens.back() == "NX") {
-            return redisHelper->set(tokens[1], tokens[2], NX);
+            return redisHelper->set(std::string(tokens[1]), std::string(tokens[2]), NX);
         } else if (tokens.back() == "XX") {
-            return redisHelper->set(tokens[1], tokens[2], XX);
+            return redisHelper->set(std::string(tokens[1]), std::string(tokens[2]), XX);
         }
     }
-    return redisHelper->set(tokens[1], tokens[2]);
+    return redisHelper->set(std::string(tokens[1]), std::string(tokens[2]));
 }
 
 // SetnxParser 
-std::string SetnxParser::parse(std::vector<std::string>& tokens) {
+std::string SetnxParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for SETNX.";
+        return errorReply("wrong number of arguments for SETNX.");
     }
-    return redisHelper->setnx(tokens[1], tokens[2]);
+    return redisHelper->setnx(std::string(tokens[1]), std::string(tokens[2]));
 }
 
 // SetexParser 
-std::string SetexParser::parse(std::vector<std::string>& tokens) {
+std::string SetexParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for SETEX.";
+        return errorReply("wrong number of arguments for SETEX.");
     }
-    return redisHelper->setex(tokens[1], tokens[2]);
+    return redisHelper->setex(std::string(tokens[1]), std::string(tokens[2]));
 }
 
 // GetParser 
-std::string GetParser::parse(std::vector<std::string>& tokens) {
+std::string GetParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for GET.";
+        return errorReply("wrong number of arguments for GET.");
     }
-    return redisHelper->get(tokens[1]);
+    return redisHelper->get(std::string(tokens[1]));
 }
 
 // KeysParser 
-std::string KeysParser::parse(std::vector<std::string>& tokens) {
+std::string KeysParser::parse(TokenSpan tokens) {
     return redisHelper->keys();
 }
 
 // DBSizeParser 
-std::string DBSizeParser::parse(std::vector<std::string>& tokens) {
+std::string DBSizeParser::parse(TokenSpan tokens) {
     return redisHelper->dbsize();
 }
 
 // ExistsParser 
-std::string ExistsParser::parse(std::vector<std::string>& tokens) {
+std::string ExistsParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for EXISTS.";
+        return errorReply("wrong number of arguments for EXISTS.");
     }
-    tokens.erase(tokens.begin()); // 移除命令本身
-    return redisHelper->exists(tokens);
+    return redisHelper->exists(tokens.subspan(1)); // 去掉命令本身，不移动参数
 }
 
 // DelParser 
-std::string DelParser::parse(std::vector<std::string>& tokens) {
+std::string DelParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for DEL.";
+        return errorReply("wrong number of arguments for DEL.");
     }
-    tokens.erase(tokens.begin()); // 移除命令本身
-    return redisHelper->del(tokens);
+    return redisHelper->del(tokens.subspan(1)); // 去掉命令本身，不移动参数
 }
 
 // RenameParser 
-std::string RenameParser::parse(std::vector<std::string>& tokens) {
+std::string RenameParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for RENAME.";
+        return errorReply("wrong number of arguments for RENAME.");
     }
-    return redisHelper->rename(tokens[1], tokens[2]);
+    return redisHelper->rename(std::string(tokens[1]), std::string(tokens[2]));
 }
 
 // IncrParser 
-std::string IncrParser::parse(std::vector<std::string>& tokens) {
+std::string IncrParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for INCR.";
+        return errorReply("wrong number of arguments for INCR.");
     }
-    return redisHelper->incr(tokens[1]);
+    return redisHelper->incr(std::string(tokens[1]));
 }
 
 // IncrbyParser 
-std::string IncrbyParser::parse(std::vector<std::string>& tokens) {
+std::string IncrbyParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for INCRBY.";
+        return errorReply("wrong number of arguments for INCRBY.");
     }
-    int increment = 0;
-    try {
-        increment = std::stoi(tokens[2]);
-    } catch (std::invalid_argument const& e) {
-        return tokens[2] + " is not a numeric type";
+    int64_t increment = 0;
+    if (!RedisValue::parseInteger(tokens[2], increment)) { //不是整数或超出int64范围
+        return errorReply(std::string(tokens[2]) + " is not a numeric type");
     }
-    return redisHelper->incrby(tokens[1], increment);
+    return redisHelper->incrby(std::string(tokens[1]), increment);
 }
 
 // IncrbyfloatParser 
-std::string IncrbyfloatParser::parse(std::vector<std::string>& tokens) {
+std::string IncrbyfloatParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for INCRBYFLOAT.";
+        return errorReply("wrong number of arguments for INCRBYFLOAT.");
     }
     double increment = 0.0;
-    try {
-        increment = std::stod(tokens[2]);
-    } catch (std::invalid_argument const& e) {
-        return tokens[2] + " is not a numeric type";
+    if (!RedisValue::parseDouble(tokens[2], increment)) {
+        return errorReply(std::string(tokens[2]) + " is not a numeric type");
     }
-    return redisHelper->incrbyfloat(tokens[1], increment);
+    return redisHelper->incrbyfloat(std::string(tokens[1]), increment);
 }
 
 // DecrParser 
-std::string DecrParser::parse(std::vector<std::string>& tokens) {
+std::string DecrParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for DECR.";
+        return errorReply("wrong number of arguments for DECR.");
     }
-    return redisHelper->decr(tokens[1]);
+    return redisHelper->decr(std::string(tokens[1]));
 }
 
 // DecrbyParser 
-std::string DecrbyParser::parse(std::vector<std::string>& tokens) {
+std::string DecrbyParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for DECRBY.";
+        return errorReply("wrong number of arguments for DECRBY.");
     }
-    int decrement = 0;
-    try {
-        decrement = std::stoi(tokens[2]);
-    } catch (std::invalid_argument const& e) {
-        return tokens[2] + " is not a numeric type";
+    int64_t decrement = 0;
+    if (!RedisValue::parseInteger(tokens[2], decrement)) { //不是整数或超出int64范围
+        return errorReply(std::string(tokens[2]) + " is not a numeric type");
     }
-    return redisHelper->decrby(tokens[1], decrement);
+    return redisHelper->decrby(std::string(tokens[1]), decrement);
 }
 
 // MSetParser 
-std::string MSetParser::parse(std::vector<std::string>& tokens) {
+std::string MSetParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3 || tokens.size() % 2 == 0) { // 需要成对的键值
-        return "wrong number of arguments for MSET.";
+        return errorReply("wrong number of arguments for MSET.");
     }
-    tokens.erase(tokens.begin()); // 移除命令本身
-    return redisHelper->mset(tokens);
+    return redisHelper->mset(tokens.subspan(1)); // 去掉命令本身，不移动参数
 }
 
 // MGetParser 
 /**
  * 使用给定的tokens进行MGET命令解析。
  *
- * @param tokens 一个包含待解析字符串的向量，其中第一个元素为命令本身，后续元素为待获取的键名。
+ * @param tokens 命令参数的视图，其中第一个元素为命令本身，后续元素为待获取的键名。
  * @return 如果tokens的大小小于2（即没有给出待获取的键名），则返回错误信息"wrong number of arguments for MGET."；否则，调用redisHelper的mget方法进行实际的键值获取，并返回结果。
  */
-std::string MGetParser::parse(std::vector<std::string>& tokens) {
+std::string MGetParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for MGET.";
+        return errorReply("wrong number of arguments for MGET.");
     }
-    tokens.erase(tokens.begin()); // 移除命令本身
-    return redisHelper->mget(tokens);
+    return redisHelper->mget(tokens.subspan(1)); // 去掉命令本身，不移动参数
 }
 
 // StrlenParser 
-std::string StrlenParser::parse(std::vector<std::string>& tokens) {
+std::string StrlenParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for STRLEN.";
+        return errorReply("wrong number of arguments for STRLEN.");
     }
-    return redisHelper->strlen(tokens[1]);
+    return redisHelper->strlen(std::string(tokens[1]));
 }
 
 // AppendParser 
-std::string AppendParser::parse(std::vector<std::string>& tokens) {
+std::string AppendParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for APPEND.";
+        return errorReply("wrong number of arguments for APPEND.");
     }
-    return redisHelper->append(tokens[1], tokens[2]);
+    return redisHelper->append(std::string(tokens[1]), std::string(tokens[2]));
 }
 
 
-std::string LPushParser::parse(std::vector<std::string>& tokens) {
+std::string LPushParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for LPUSH.";
+        return errorReply("wrong number of arguments for LPUSH.");
     }
-    return redisHelper->lpush(tokens[1],tokens[2]);
+    return redisHelper->lpush(std::string(tokens[1]),tokens.subspan(2));
 }
-std::string RPushParser::parse(std::vector<std::string>& tokens) {
+std::string RPushParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for RPUSH.";
+        return errorReply("wrong number of arguments for RPUSH.");
     }
-    return redisHelper->rpush(tokens[1],tokens[2]);
+    return redisHelper->rpush(std::string(tokens[1]),tokens.subspan(2));
 }
-std::string LPopParser::parse(std::vector<std::string>& tokens) {
+std::string LPopParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for LPOP.";
+        return errorReply("wrong number of arguments for LPOP.");
     }
-    return redisHelper->lpop(tokens[1]);
+    return redisHelper->lpop(std::string(tokens[1]));
 }
-std::string RPopParser::parse(std::vector<std::string>& tokens) {
+std::string RPopParser::parse(TokenSpan tokens) {
     if (tokens.size() < 2) {
-        return "wrong number of arguments for LPOP.";
+        return errorReply("wrong number of arguments for RPOP.");
     }
-    return redisHelper->rpop(tokens[1]);
+    return redisHelper->rpop(std::string(tokens[1]));
 }
-std::string LRangeParser::parse(std::vector<std::string>& tokens) {
+std::string LRangeParser::parse(TokenSpan tokens) {
     if (tokens.size() < 4) {
-        return "wrong number of arguments for LPOP.";
+        return errorReply("wrong number of arguments for LRANGE.");
     }
-    int start = 0;
-    int end = 0;
-    try {
-        start = std::stoi(tokens[2]);
-        end = std::stoi(tokens[3]);
-    } catch (std::invalid_argument const& e) {
-        return tokens[2]+" or "+tokens[3] + " is not a integer type";
+    int64_t start = 0;
+    int64_t end = 0;
+    if (!RedisValue::parseInteger(tokens[2], start) || !RedisValue::parseInteger(tokens[3], end)) {
+        return errorReply(std::string(tokens[2])+" or "+std::string(tokens[3]) + " is not a integer type");
+    }
+    return redisHelper->lrange(std::string(tokens[1]),start,end);
+}
+std::string LIndexParser::parse(TokenSpan tokens) {
+    if (tokens.size() < 3) {
+        return errorReply("wrong number of arguments for LINDEX.");
+    }
+    int64_t index = 0;
+    if (!RedisValue::parseInteger(tokens[2], index)) {
+        return errorReply(std::string(tokens[2]) + " is not a integer type");
+    }
+    return redisHelper->lindex(std::string(tokens[1]),index);
+}
+std::string LSetParser::parse(TokenSpan tokens) {
+    if (tokens.size() < 4) {
+        return errorReply("wrong number of arguments for LSET.");
+    }
+    int64_t index = 0;
+    if (!RedisValue::parseInteger(tokens[2], index)) {
+        return errorReply(std::string(tokens[2]) + " is not a integer type");
+    }
+    return redisHelper->lset(std::string(tokens[1]),index,std::string(tokens[3]));
+}
+std::string LTrimParser::parse(TokenSpan tokens) {
+    if (tokens.size() < 4) {
+        return errorReply("wrong number of arguments for LTRIM.");
+    }
+    int64_t start = 0;
+    int64_t end = 0;
+    if (!RedisValue::parseInteger(tokens[2], start) || !RedisValue::parseInteger(tokens[3], end)) {
+        return errorReply(std::string(tokens[2])+" or "+std::string(tokens[3]) + " is not a integer type");
     }
-    return redisHelper->lrange(tokens[1],tokens[2],tokens[3]);
+    return redisHelper->ltrim(std::string(tokens[1]),start,end);
+}
+std::string LLenParser::parse(TokenSpan tokens) {
+    if (tokens.size() < 2) {
+        return errorReply("wrong number of arguments for LLEN.");
+    }
+    return redisHelper->llen(std::string(tokens[1]));
 }
 
 
 // HSetParser
-std::string HSetParser::parse(std::vector<std::string>& tokens) {
+std::string HSetParser::parse(TokenSpan tokens) {
     if (tokens.size() < 4||tokens.size()%2!=0) {
-        return "wrong number of arguments for HSET.";
+        return errorReply("wrong number of arguments for HSET.");
     }
-    std::vector<std::string> fields(tokens.begin() + 2, tokens.end());
-    return redisHelper->hset(tokens[1], fields);
+    return redisHelper->hset(std::string(tokens[1]), tokens.subspan(2));
 }
 
 // HGetParser
-std::string HGetParser::parse(std::vector<std::string>& tokens) {
+std::string HGetParser::parse(TokenSpan tokens) {
     if (tokens.size() != 3) {
-        return "wrong number of arguments for HGET.";
+        return errorReply("wrong number of arguments for HGET.");
     }
-    return redisHelper->hget(tokens[1], tokens[2]);
+    return redisHelper->hget(std::string(tokens[1]), std::string(tokens[2]));
 }
 
 // HDelParser
-std::string HDelParser::parse(std::vector<std::string>& tokens) {
+std::string HDelParser::parse(TokenSpan tokens) {
     if (tokens.size() < 3) {
-        return "wrong number of arguments for HDEL.";
+        return errorReply("wrong number of arguments for HDEL.");
     }
-    std::vector<std::string> fields(tokens.begin() + 2, tokens.end());
-    return redisHelper->hdel(tokens[1], fields);
+    return redisHelper->hdel(std::string(tokens[1]), tokens.subspan(2));
 }
 
 // HKeysParser
-std::string HKeysParser::parse(std::vector<std::string>& tokens) {
+std::string HKeysParser::parse(TokenSpan tokens) {
     if (tokens.size() != 2) {
-        return "wrong number of arguments for HKEYS.";
+        return errorReply("wrong number of arguments for HKEYS.");
     }
-    return redisHelper->hkeys(tokens[1]);
+    return redisHelper->hkeys(std::string(tokens[1]));
 }
 
 // HValsParser
-std::string HValsParser::parse(std::vector<std::string>& tokens) {
+std::string HValsParser::parse(TokenSpan tokens) {
+    if (tokens.size() != 2) {
+        return errorReply("wrong number of arguments for HVALS.");
+    }
+    return redisHelper->hvals(std::string(tokens[1]));
+}
+
+// HMGetParser
+std::string HMGetParser::parse(TokenSpan tokens) {
+    if (tokens.size() < 3) {
+        return errorReply("wrong number of arguments for HMGET.");
+    }
+    return redisHelper->hmget(std::string(tokens[1]), tokens.subspan(2));
+}
+
+// HGetAllParser
+std::string HGetAllParser::parse(TokenSpan tokens) {
     if (tokens.size() != 2) {
-        return "wrong number of arguments for HVALS.";
+        return errorReply("wrong number of arguments for HGETALL.");
+    }
+    return redisHelper->hgetall(std::string(tokens[1]));
+}
+
+// HIncrbyParser
+std::string HIncrbyParser::parse(TokenSpan tokens) {
+    if (tokens.size() != 4) {
+        return errorReply("wrong number of arguments for HINCRBY.");
+    }
+    int64_t increment = 0;
+    if (!RedisValue::parseInteger(tokens[3], increment)) {
+        return errorReply(std::string(tokens[3]) + " is not a numeric type");
+    }
+    return redisHelper->hincrby(std::string(tokens[1]), std::string(tokens[2]), increment);
+}
+
+// FlushdbParser
+std::string FlushdbParser::parse(TokenSpan tokens) {
+    return redisHelper->flushdb();
+}
+
+// SwapdbParser
+std::string SwapdbParser::parse(TokenSpan tokens) {
+    if (tokens.size() != 3) {
+        return errorReply("wrong number of arguments for SWAPDB.");
+    }
+    int index1 = 0, index2 = 0;
+    try {
+        index1 = std::stoi(std::string(tokens[1]));
+        index2 = std::stoi(std::string(tokens[2]));
+    } catch (std::invalid_argument const& e) {
+        return errorReply("invalid first or second DB index.");
+    }
+    return redisHelper->swapdb(index1, index2);
+}
+
+// MoveParser
+std::string MoveParser::parse(TokenSpan tokens) {
+    if (tokens.size() != 3) {
+        return errorReply("wrong number of arguments for MOVE.");
+    }
+    int index = 0;
+    try {
+        index = std::stoi(std::string(tokens[2]));
+    } catch (std::invalid_argument const& e) {
+        return errorReply(std::string(tokens[2]) + " is not a numeric type");
     }
-    return redisHelper->hvals(tokens[1]);
+    return redisHelper->move(std::string(tokens[1]), index);
 }
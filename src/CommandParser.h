@@ -5,6 +5,7 @@
 #include <vector>
 #include <string>
 #include "RedisHelper.h" 
+#include "TokenSpan.h"
 
 /*
     CommandParser 是解析器的基类，它定义了解析器的接口
@@ -19,181 +20,241 @@ public:
         redisHelper = helper; 
     }
     static std::shared_ptr<RedisHelper> getRedisHelper() { return redisHelper; }  //饿汉模式
-    virtual std::string parse(std::vector<std::string>& tokens) = 0; //纯虚函数，解析命令
+    virtual std::string parse(TokenSpan tokens) = 0; //纯虚函数，解析命令
 };
 
 // SelectParser 
 class SelectParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // SetParser 
 class SetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // SetnxParser 
 class SetnxParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // SetexParser 
 class SetexParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // GetParser 
 class GetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // KeysParser 
 class KeysParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // DBSizeParser 
 class DBSizeParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // ExistsParser 
 class ExistsParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // DelParser 
 class DelParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // RenameParser 
 class RenameParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // IncrParser 
 class IncrParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // IncrbyParser 
 class IncrbyParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // IncrbyfloatParser 
 class IncrbyfloatParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // DecrParser 
 class DecrParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // DecrbyParser 
 class DecrbyParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // MSetParser 
 class MSetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // MGetParser 
 class MGetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // StrlenParser 
 class StrlenParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // AppendParser 
 class AppendParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // LPushParser
 class LPushParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // RPushParser
 class RPushParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // LPopParser
 class LPopParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // RPopParser
 class RPopParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 //LRangeParser
 class LRangeParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
+};
+
+// LIndexParser
+class LIndexParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
+};
+
+// LSetParser
+class LSetParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
+};
+
+// LTrimParser
+class LTrimParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
+};
+
+// LLenParser
+class LLenParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
 };
 
 // HSetParser
 class HSetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // HGetParser
 class HGetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // HDelParser
 class HDelParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // HKeysParser
 class HKeysParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
 };
 
 // HValsParser
 class HValsParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    std::string parse(TokenSpan tokens) override;
+};
+
+// HMGetParser
+class HMGetParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
+};
+
+// HGetAllParser
+class HGetAllParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
+};
+
+// HIncrbyParser
+class HIncrbyParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
+};
+
+// FlushdbParser
+class FlushdbParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
+};
+
+// SwapdbParser
+class SwapdbParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
+};
+
+// MoveParser
+class MoveParser : public CommandParser {
+public:
+    std::string parse(TokenSpan tokens) override;
 };
 
 
@@ -0,0 +1,92 @@
+#include "EpochManager.h"
+#include <stdexcept>
+
+namespace {
+// 每个线程的登记信息：占用的槽位和临界区嵌套深度
+struct ThreadRecord{
+    int slot=-1;
+    int depth=0;
+    ~ThreadRecord(){
+        if(slot>=0){
+            EpochManager::getInstance().releaseSlot(slot);
+        }
+    }
+};
+thread_local ThreadRecord threadRecord;
+}
+
+EpochManager& EpochManager::getInstance(){
+    static EpochManager manager;
+    return manager;
+}
+
+/**
+ * 为当前线程分配一个空闲槽位。
+ *
+ * @return 返回槽位下标；所有槽位都被占用时抛出异常。
+ */
+int EpochManager::acquireSlot(){
+    for(int i=0;i<MAX_EPOCH_THREADS;i++){
+        bool expected=false;
+        if(!slots[i].inUse.load()&&slots[i].inUse.compare_exchange_strong(expected,true)){
+            int highWater=slotHighWater.load();
+            while(highWater<i+1&&!slotHighWater.compare_exchange_weak(highWater,i+1)){
+            }
+            return i;
+        }
+    }
+    throw std::runtime_error("too many threads registered in EpochManager");
+}
+
+void EpochManager::releaseSlot(int index){
+    slots[index].epoch.store(0);
+    slots[index].inUse.store(false);
+}
+
+/**
+ * 进入临界区，在当前线程的槽位上登记全局纪元。
+ * 嵌套调用时只有最外层真正登记。
+ */
+void EpochManager::enter(){
+    if(threadRecord.depth++>0){
+        return;
+    }
+    if(threadRecord.slot<0){
+        threadRecord.slot=acquireSlot();
+    }
+    ThreadSlot& slot=slots[threadRecord.slot];
+    uint64_t epoch=globalEpoch.load();
+    // 登记后再确认一次全局纪元没有变化，避免登记了一个已经过时的纪元
+    while(true){
+        slot.epoch.store(epoch);
+        uint64_t now=globalEpoch.load();
+        if(now==epoch){
+            break;
+        }
+        epoch=now;
+    }
+}
+
+void EpochManager::exit(){
+    if(--threadRecord.depth>0){
+        return;
+    }
+    slots[threadRecord.slot].epoch.store(0,std::memory_order_release);
+}
+
+/**
+ * 尝试推进全局纪元。只有当所有处于临界区内的线程都已登记了当前纪元时才能推进。
+ *
+ * @return 推进成功返回true，否则返回false。
+ */
+bool EpochManager::tryAdvance(){
+    uint64_t epoch=globalEpoch.load();
+    int highWater=slotHighWater.load();
+    for(int i=0;i<highWater;i++){
+        uint64_t slotEpoch=slots[i].epoch.load();
+        if(slotEpoch!=0&&slotEpoch!=epoch){
+            return false;
+        }
+    }
+    return globalEpoch.compare_exchange_strong(epoch,epoch+1);
+}
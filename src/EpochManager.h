@@ -0,0 +1,49 @@
+#ifndef EPOCH_MANAGER_H
+#define EPOCH_MANAGER_H
+#include<atomic>
+#include<cstdint>
+#define MAX_EPOCH_THREADS 256
+
+/*
+    基于纪元(epoch)的内存回收管理器
+    线程访问无锁结构前登记当前的全局纪元，访问结束后清除登记；
+    被摘除的节点记录摘除时的全局纪元，等全局纪元再前进两次后，
+    就不会再有线程持有它的引用，此时才可以真正释放。
+*/
+class EpochManager{
+private:
+    struct alignas(64) ThreadSlot{ //每个线程独占一个槽位，按缓存行对齐避免伪共享
+        std::atomic<uint64_t> epoch{0}; //线程登记的纪元，0表示线程不在临界区内
+        std::atomic<bool> inUse{false}; //槽位是否已被线程占用
+    };
+    ThreadSlot slots[MAX_EPOCH_THREADS];
+    std::atomic<int> slotHighWater{0}; //曾经使用过的最大槽位数，推进纪元时只扫描这一段
+    std::atomic<uint64_t> globalEpoch{1}; //全局纪元
+private:
+    EpochManager()=default;
+    int acquireSlot(); //为当前线程分配槽位
+public:
+    EpochManager(const EpochManager&)=delete;
+    EpochManager& operator=(const EpochManager&)=delete;
+    static EpochManager& getInstance();
+    void enter(); //进入临界区，支持嵌套
+    void exit(); //退出临界区
+    void releaseSlot(int index); //线程退出时归还槽位
+    uint64_t currentEpoch() const{ return globalEpoch.load(); }
+    bool tryAdvance(); //所有在临界区内的线程都已看到当前纪元时，推进全局纪元
+    //在retireEpoch纪元被摘除的对象现在是否可以释放
+    bool isSafe(uint64_t retireEpoch) const{ return retireEpoch+2<=globalEpoch.load(); }
+};
+
+/*
+    RAII方式持有纪元，作用域内读到的跳表节点不会被回收
+*/
+class EpochGuard{
+public:
+    EpochGuard(){ EpochManager::getInstance().enter(); }
+    ~EpochGuard(){ EpochManager::getInstance().exit(); }
+    EpochGuard(const EpochGuard&)=delete;
+    EpochGuard& operator=(const EpochGuard&)=delete;
+};
+
+#endif
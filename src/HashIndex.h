@@ -0,0 +1,204 @@
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+#include<atomic>
+#include<cstdint>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<vector>
+#include"EpochManager.h"
+#define HASH_INDEX_MIN_CAPACITY 16
+#define HASH_INDEX_MAX_LOAD 0.5 //已用槽位(含墓碑)超过容量的这个比例时重建
+
+/*
+    开放寻址(线性探测)的哈希索引，把key映射到跳表节点，用于O(1)的单点查找
+    查找不加锁，只读取槽位；插入和删除由写锁串行化，删除时留下墓碑；
+    装载过高时重建一张新表并整体替换，旧表按纪元延迟释放。
+    find返回的节点指针只在调用方持有EpochGuard期间有效，节点是否已被删除由调用方判断。
+*/
+template<typename Key,typename Node>
+class HashIndex{
+private:
+    struct Slot{
+        std::atomic<size_t> hash{0};
+        std::atomic<Node*> node{nullptr}; //nullptr表示空槽位，tombstone()表示已删除
+    };
+    struct Table{
+        size_t capacity;
+        std::unique_ptr<Slot[]> slots;
+        uint64_t retireEpoch=0;
+        explicit Table(size_t capacity):capacity(capacity),slots(new Slot[capacity]){}
+    };
+    std::atomic<Table*> table;
+    std::mutex writeMutex; //插入、删除、重建之间互斥
+    size_t liveNumber=0; //有效槽位数
+    size_t usedNumber=0; //有效槽位和墓碑的总数
+    std::vector<Table*> retiredTables; //等待释放的旧表
+    std::hash<Key> hasher;
+private:
+    static Node* tombstone(){ return reinterpret_cast<Node*>(uintptr_t(1)); }
+    void rebuild(size_t minLive); //按当前有效元素重建一张更合适的表
+    void reclaimTables(); //释放已经没有线程引用的旧表
+public:
+    HashIndex():table(new Table(HASH_INDEX_MIN_CAPACITY)){}
+    ~HashIndex();
+    HashIndex(const HashIndex&)=delete;
+    HashIndex& operator=(const HashIndex&)=delete;
+    Node* find(const Key& key) const; //查找key对应的节点
+    void insert(const Key& key,Node* node); //插入或替换key对应的节点
+    void erase(const Key& key,Node* node); //key仍然指向node时删除
+};
+
+template<typename Key,typename Node>
+HashIndex<Key,Node>::~HashIndex(){
+    delete table.load();
+    for(Table* retired:retiredTables){
+        delete retired;
+    }
+}
+
+/**
+ * 从key的哈希位置开始线性探测，遇到空槽位说明key不存在。
+ *
+ * @param key 要查找的key。
+ * @return 返回索引中key对应的节点，不存在时返回nullptr。
+ */
+template<typename Key,typename Node>
+Node* HashIndex<Key,Node>::find(const Key& key) const{
+    size_t hash=hasher(key);
+    Table* current=table.load(std::memory_order_acquire);
+    size_t mask=current->capacity-1;
+    for(size_t i=hash&mask,probe=0;probe<current->capacity;i=(i+1)&mask,probe++){
+        Slot& slot=current->slots[i];
+        Node* node=slot.node.load(std::memory_order_acquire);
+        if(node==nullptr){
+            return nullptr;
+        }
+        if(node!=tombstone()&&slot.hash.load(std::memory_order_relaxed)==hash&&node->key==key){
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * 插入key到node的映射。key已存在时直接替换节点指针（旧节点已被删除、新节点重新插入的情况）。
+ *
+ * @param key 节点的key。
+ * @param node 跳表节点。
+ */
+template<typename Key,typename Node>
+void HashIndex<Key,Node>::insert(const Key& key,Node* node){
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if(!retiredTables.empty()){
+        reclaimTables();
+    }
+    if((usedNumber+1)>table.load()->capacity*HASH_INDEX_MAX_LOAD){
+        rebuild(liveNumber+1);
+    }
+    size_t hash=hasher(key);
+    Table* current=table.load();
+    size_t mask=current->capacity-1;
+    Slot* target=nullptr;
+    for(size_t i=hash&mask;;i=(i+1)&mask){
+        Slot& slot=current->slots[i];
+        Node* existing=slot.node.load(std::memory_order_relaxed);
+        if(existing==nullptr){
+            if(target==nullptr){
+                target=&slot;
+                usedNumber++;
+            }
+            break;
+        }
+        if(existing==tombstone()){
+            if(target==nullptr){
+                target=&slot; //复用第一个墓碑，但要继续确认key不在后面
+            }
+            continue;
+        }
+        if(slot.hash.load(std::memory_order_relaxed)==hash&&existing->key==key){
+            slot.node.store(node,std::memory_order_release);
+            return;
+        }
+    }
+    target->hash.store(hash,std::memory_order_relaxed);
+    target->node.store(node,std::memory_order_release);
+    liveNumber++;
+}
+
+/**
+ * 删除key的映射。只有槽位中仍是node时才删除，避免误删同key新插入的节点。
+ *
+ * @param key 节点的key。
+ * @param node 要删除的跳表节点。
+ */
+template<typename Key,typename Node>
+void HashIndex<Key,Node>::erase(const Key& key,Node* node){
+    std::lock_guard<std::mutex> lock(writeMutex);
+    size_t hash=hasher(key);
+    Table* current=table.load();
+    size_t mask=current->capacity-1;
+    for(size_t i=hash&mask,probe=0;probe<current->capacity;i=(i+1)&mask,probe++){
+        Slot& slot=current->slots[i];
+        Node* existing=slot.node.load(std::memory_order_relaxed);
+        if(existing==nullptr){
+            return;
+        }
+        if(existing==node){
+            slot.node.store(tombstone(),std::memory_order_release);
+            liveNumber--;
+            return;
+        }
+    }
+}
+
+/**
+ * 重建索引表：容量取能容纳minLive个元素且装载不超过1/4的最小2的幂，墓碑在重建时被清除。
+ * 新表发布后，仍在读旧表的线程不受影响，旧表等纪元安全后再释放。
+ *
+ * @param minLive 重建后至少要容纳的元素个数。
+ */
+template<typename Key,typename Node>
+void HashIndex<Key,Node>::rebuild(size_t minLive){
+    Table* old=table.load();
+    size_t capacity=HASH_INDEX_MIN_CAPACITY;
+    while(capacity<minLive*4){
+        capacity<<=1;
+    }
+    Table* fresh=new Table(capacity);
+    size_t mask=capacity-1;
+    for(size_t i=0;i<old->capacity;i++){
+        Node* node=old->slots[i].node.load(std::memory_order_relaxed);
+        if(node==nullptr||node==tombstone()){
+            continue;
+        }
+        size_t hash=old->slots[i].hash.load(std::memory_order_relaxed);
+        size_t j=hash&mask;
+        while(fresh->slots[j].node.load(std::memory_order_relaxed)!=nullptr){
+            j=(j+1)&mask;
+        }
+        fresh->slots[j].hash.store(hash,std::memory_order_relaxed);
+        fresh->slots[j].node.store(node,std::memory_order_relaxed);
+    }
+    usedNumber=liveNumber;
+    table.store(fresh,std::memory_order_release);
+    old->retireEpoch=EpochManager::getInstance().currentEpoch();
+    retiredTables.push_back(old);
+}
+
+template<typename Key,typename Node>
+void HashIndex<Key,Node>::reclaimTables(){
+    EpochManager& epochManager=EpochManager::getInstance();
+    epochManager.tryAdvance();
+    size_t kept=0;
+    for(Table* retired:retiredTables){
+        if(epochManager.isSafe(retired->retireEpoch)){
+            delete retired;
+        }else{
+            retiredTables[kept++]=retired;
+        }
+    }
+    retiredTables.resize(kept);
+}
+
+#endif
@@ -1,148 +1,132 @@
 #include"ParserFlyweightFactory.h"
+#include<cstdint>
 
-std::shared_ptr<CommandParser> ParserFlyweightFactory::getParser(std::string& command){
-    if(parserMaps.find(command)!=parserMaps.end()){
-        return parserMaps[command];
-    }
-    return createCommandParser(command);
-}
+namespace{
 
+//每种解析器一个静态实例，解析器没有成员变量，常量初始化，不需要运行时构造
+template<typename Parser>
+Parser parserInstance;
 
+//以限定名调用parse，编译器直接调用（可以内联），不经过虚函数表
+template<typename Parser>
+std::string parseWith(TokenSpan tokens){
+    return parserInstance<Parser>.Parser::parse(tokens);
+}
 
 /**
- * 创建并返回一个命令解析器。
+ * 返回命令对应的解析函数。
  *
- * @param command 需要创建的命令字符串。
- * @return 如果命令存在，则返回对应的命令解析器；如果命令不存在，则返回nullptr。
+ * @param command 命令枚举。
+ * @return 如果命令存在，则返回对应的解析函数；如果命令不存在，则返回nullptr。
  */
-std::shared_ptr<CommandParser> ParserFlyweightFactory::createCommandParser(std::string& command){
-    Command op;
-    if(commandMaps.find(command)==commandMaps.end()){ //命令不存在
-        op=INVALID_COMMAND;
-    }else{
-        op=commandMaps[command]; //获取命令
+constexpr ParserHandler handlerOf(Command command){
+    switch(command){
+        case SET: return &parseWith<SetParser>;
+        case SETNX: return &parseWith<SetnxParser>;
+        case SETEX: return &parseWith<SetexParser>;
+        case DBSIZE: return &parseWith<DBSizeParser>;
+        case GET: return &parseWith<GetParser>;
+        case KEYS: return &parseWith<KeysParser>;
+        case EXISTS: return &parseWith<ExistsParser>;
+        case DEL: return &parseWith<DelParser>;
+        case RENAME: return &parseWith<RenameParser>;
+        case INCR: return &parseWith<IncrParser>;
+        case INCRBY: return &parseWith<IncrbyParser>;
+        case INCRBYFLOAT: return &parseWith<IncrbyfloatParser>;
+        case DECR: return &parseWith<DecrParser>;
+        case DECRBY: return &parseWith<DecrbyParser>;
+        case MSET: return &parseWith<MSetParser>;
+        case MGET: return &parseWith<MGetParser>;
+        case STRLEN: return &parseWith<StrlenParser>;
+        case APPEND: return &parseWith<AppendParser>;
+        case SELECT: return &parseWith<SelectParser>;
+        case LPUSH: return &parseWith<LPushParser>;
+        case RPUSH: return &parseWith<RPushParser>;
+        case LPOP: return &parseWith<LPopParser>;
+        case RPOP: return &parseWith<RPopParser>;
+        case LRANGE: return &parseWith<LRangeParser>;
+        case LINDEX: return &parseWith<LIndexParser>;
+        case LSET: return &parseWith<LSetParser>;
+        case LTRIM: return &parseWith<LTrimParser>;
+        case LLEN: return &parseWith<LLenParser>;
+        case HSET: return &parseWith<HSetParser>;
+        case HGET: return &parseWith<HGetParser>;
+        case HDEL: return &parseWith<HDelParser>;
+        case HKEYS: return &parseWith<HKeysParser>;
+        case HVALS: return &parseWith<HValsParser>;
+        case HMGET: return &parseWith<HMGetParser>;
+        case HGETALL: return &parseWith<HGetAllParser>;
+        case HINCRBY: return &parseWith<HIncrbyParser>;
+        case FLUSHDB: return &parseWith<FlushdbParser>;
+        case SWAPDB: return &parseWith<SwapdbParser>;
+        case MOVE: return &parseWith<MoveParser>;
+        default: return nullptr;
     }
-    
-    switch(op){
-        case SET:{
-            parserMaps[command]=std::make_shared<SetParser>();
-            break;
-        }
-        case SETNX:{
-            parserMaps[command]=std::make_shared<SetnxParser>();
-            break;
-        }
-        case SETEX:{
-            parserMaps[command]=std::make_shared<SetexParser>();
-            break;
-        }
-        case DBSIZE:{
-            parserMaps[command]=std::make_shared<DBSizeParser>();
-            break;
-        }
-        case GET:{
-            parserMaps[command]=std::make_shared<GetParser>();
-            break;
-        }
-        case KEYS:{
-            parserMaps[command]=std::make_shared<KeysParser>();
-            break;
-        }
-        case EXISTS:{
-            parserMaps[command]=std::make_shared<ExistsParser>();
-            break;
-        }
-        case DEL:{
-            parserMaps[command]=std::make_shared<DelParser>();
-            break;
-        }
-        case RENAME:{
-            parserMaps[command]=std::make_shared<RenameParser>();
-            break;
-        }
-        case INCR:{
-            parserMaps[command]=std::make_shared<IncrParser>();
-            break;
-        }
-        case INCRBY:{
-            parserMaps[command]=std::make_shared<IncrbyParser>();
-            break;
-        }
-        case INCRBYFLOAT:{
-            parserMaps[command]=std::make_shared<IncrbyfloatParser>();
-            break;
-        }
-        case DECR:{
-            parserMaps[command]=std::make_shared<DecrParser>();
-            break;
-        }
-        case DECRBY:{
-            parserMaps[command]=std::make_shared<DecrbyParser>();
-            break;
-        }
-        case MSET:{
-            parserMaps[command]=std::make_shared<MSetParser>();
-            break;
-        }
-        case MGET:{
-            parserMaps[command]=std::make_shared<MGetParser>();
-            break;
-        }
-        case STRLEN:{
-            parserMaps[command]=std::make_shared<StrlenParser>();
-            break;
-        }
-        case APPEND:{
-            parserMaps[command]=std::make_shared<AppendParser>();
-            break;
-        }
-        case SELECT:{
-            parserMaps[command]=std::make_shared<SelectParser>();
-            break;
-        }
-        case LPUSH:{
-            parserMaps[command]=std::make_shared<LPushParser>();
-            break;
-        }
-        case RPUSH:{
-            parserMaps[command]=std::make_shared<RPushParser>();
-            break;
-        }
-        case LPOP:{
-            parserMaps[command]=std::make_shared<LPopParser>();
-            break;
-        }
-        case RPOP:{
-            parserMaps[command]=std::make_shared<RPopParser>();
-            break;
-        }
-        case LRANGE:{
-            parserMaps[command]=std::make_shared<LRangeParser>();
-            break;
-        }
-        case HSET:{
-            parserMaps[command]=std::make_shared<HSetParser>();
-            break;
-        }
-        case HGET:{
-            parserMaps[command]=std::make_shared<HGetParser>();
-            break;
-        }
-        case HDEL:{
-            parserMaps[command]=std::make_shared<HDelParser>();
-            break;
-        }
-        case HKEYS:{
-            parserMaps[command]=std::make_shared<HKeysParser>();
-            break;
-        }
-        case HVALS:{
-            parserMaps[command]=std::make_shared<HValsParser>();
-            break;
-        }
-        default:{
-            return nullptr;
+}
+
+constexpr char lowerCase(char c){ return c>='A'&&c<='Z' ? static_cast<char>(c-'A'+'a') : c; }
+
+//带种子的FNV-1a哈希，大写字母按小写计算，同一个命令名不论大小写都落在同一个槽位
+constexpr size_t slotOf(std::string_view name,uint32_t seed){
+    uint32_t hash=2166136261u^seed;
+    for(char c:name){
+        hash=(hash^static_cast<uint8_t>(lowerCase(c)))*16777619u;
+    }
+    return (hash^(hash>>16))&(PARSER_TABLE_SIZE-1); //低位混入高位，乘法后高位更随机
+}
+
+constexpr bool equalsIgnoreCase(std::string_view lower,std::string_view name){
+    if(lower.size()!=name.size()) return false;
+    for(size_t i=0;i<name.size();i++){
+        if(lower[i]!=lowerCase(name[i])) return false;
+    }
+    return true;
+}
+
+struct ParserTable{
+    ParserEntry slots[PARSER_TABLE_SIZE];
+    uint32_t seed;
+    bool valid; //找到了无冲突的种子，且每个命令都有解析器
+};
+
+//编译期逐个尝试种子，直到commandInfos中的命令名两两不冲突
+constexpr ParserTable buildParserTable(){
+    for(uint32_t seed=0;seed<(1u<<16);seed++){
+        ParserTable table{};
+        bool placed=true;
+        for(const CommandInfo &info:commandInfos){
+            ParserEntry &slot=table.slots[slotOf(info.name,seed)];
+            if(slot.parse!=nullptr||handlerOf(info.command)==nullptr){
+                placed=false;
+                break;
+            }
+            slot=ParserEntry{info.name,handlerOf(info.command),info.write,info.keys};
+        }
+        if(placed){
+            table.seed=seed;
+            table.valid=true;
+            return table;
         }
     }
-    return parserMaps[command];
-}
\ No newline at end of file
+    return ParserTable{};
+}
+
+constexpr ParserTable parserTable=buildParserTable();
+static_assert(parserTable.valid,"no collision-free seed for the command table, enlarge PARSER_TABLE_SIZE");
+
+}
+
+/**
+ * 查找命令对应的解析器，命令名不区分大小写。
+ *
+ * @param command 命令名。
+ * @return 如果命令存在，则返回分发表中的项；如果命令不存在，则返回nullptr。
+ */
+const ParserEntry* ParserFlyweightFactory::getParser(std::string_view command) const{
+    const ParserEntry &entry=parserTable.slots[slotOf(command,parserTable.seed)];
+    //命令名通常已经是小写，先直接比较
+    if(entry.parse==nullptr||(entry.name!=command&&!equalsIgnoreCase(entry.name,command))){
+        return nullptr;
+    }
+    return &entry;
+}
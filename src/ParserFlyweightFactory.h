@@ -1,17 +1,29 @@
 #ifndef PARSER_FLYWEIGHT_FACTORY
 #define PARSER_FLYWEIGHT_FACTORY
 #include"CommandParser.h"
-#include<unordered_map>
+#include<string_view>
+#define PARSER_TABLE_SIZE 256 //分发表的槽位数，2的幂，至少是命令数的4倍，编译期容易找到无冲突的种子
+
+typedef std::string (*ParserHandler)(TokenSpan tokens); //解析并执行一条命令
+
+struct ParserEntry{ //分发表的一项
+    std::string_view name; //小写的命令名，为空表示空槽
+    ParserHandler parse;
+    bool write; //是否修改数据，需要写入追加日志
+    KeySpec keys; //命令中key的位置，first为0表示无法确定
+};
+
 //享元模式工厂
 /*
     这个类用来返回解析器的
+    解析器没有状态，每种解析器只有一个静态分配的实例，通过限定名直接调用parse，不经过虚函数表。
+    命令名到解析器的分发表在编译期由global.h中的commandInfos生成：编译时逐个尝试哈希种子，
+    直到所有命令名落在不同的槽位上（完美哈希）。查找时算一次哈希、比较一次命令名，命令名不区分大小写；
+    返回指向常量表的指针，没有引用计数，多个工作线程可以同时获取解析器。
 */
 class ParserFlyweightFactory{
-private:
-    std::unordered_map<std::string,std::shared_ptr<CommandParser>> parserMaps; //解析器映射
-    std::shared_ptr<CommandParser> createCommandParser(std::string& command); //创建解析器
 public:
-    std::shared_ptr<CommandParser> getParser(std::string& command); //获取解析器
+    const ParserEntry* getParser(std::string_view command) const; //获取解析器，命令不存在时返回nullptr
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,64 +1,319 @@
 #include "RedisHelper.h"
+#include "RedisValue/CompactHash.h"
+#include "RedisValue/QuickList.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
 #include "FileCreator.h"
+#include "Snapshot.h"
+#include "ChildProcess.h"
+
+thread_local std::vector<RedisHelper::HeldLock> RedisHelper::heldLocks;
+thread_local std::atomic<int> *RedisHelper::sessionDataBaseIndex = nullptr;
+thread_local RedisHelper::LoggedCommand *RedisHelper::loggedCommand = nullptr;
+
+/**
+ * 判断当前线程是否已经在事务中持有足够的锁：独占持有时读写都不用再加锁，共享持有时只有读不用再加锁。
+ *
+ * @param mutex 要加的锁。
+ * @param exclusive 是否要独占持有。
+ * @return 已持有足够的锁时返回true。
+ */
+bool RedisHelper::isHeld(std::shared_mutex &mutex, bool exclusive)
+{
+    for (const HeldLock &held : heldLocks)
+    {
+        if (held.mutex == &mutex)
+        {
+            return held.exclusive || !exclusive;
+        }
+    }
+    return false;
+}
+
+/**
+ * 锁住事务涉及的分片。先共享持有数据库表，再按(数据库下标, 分片下标)递增的顺序独占持有分片，
+ * 和普通命令的加锁顺序一致，不会死锁。
+ *
+ * @param helper 数据库。
+ * @param keys 事务中的命令访问的(数据库下标, key)。
+ */
+RedisHelper::TransactionLocks::TransactionLocks(RedisHelper &helper, const std::vector<std::pair<int, std::string>> &keys)
+    : heldBefore(heldLocks.size())
+{
+    tableReadLock = std::shared_lock<std::shared_mutex>(helper.dataBasesMutex);
+    heldLocks.push_back({&helper.dataBasesMutex, false});
+    std::vector<std::pair<int, size_t>> shards;
+    for (const auto &key : keys)
+    {
+        shards.emplace_back(key.first, helper.getShardIndex(key.second));
+    }
+    std::sort(shards.begin(), shards.end());
+    shards.erase(std::unique(shards.begin(), shards.end()), shards.end());
+    for (const auto &shard : shards)
+    {
+        std::shared_mutex &mutex = helper.dataBases[shard.first]->shards[shard.second]->mutex;
+        shardLocks.emplace_back(mutex);
+        heldLocks.push_back({&mutex, true});
+    }
+}
+
+/**
+ * 独占持有数据库表，用于无法事先确定访问哪些key的事务。
+ *
+ * @param helper 数据库。
+ */
+RedisHelper::TransactionLocks::TransactionLocks(RedisHelper &helper)
+    : tableWriteLock(helper.dataBasesMutex), heldBefore(heldLocks.size())
+{
+    heldLocks.push_back({&helper.dataBasesMutex, true});
+}
+
+RedisHelper::TransactionLocks::~TransactionLocks()
+{
+    heldLocks.resize(heldBefore);
+}
 
 /**
  * 使用RedisHelper类中的flush方法，将redis数据库中的数据写入到文件中。
+ * 写入期间持有所有数据库所有分片的读锁，保证写出的是同一时刻的数据。
  *
- * @param 无参数。
+ * @param logPosition 此时追加日志的末尾，记在每个快照的头部。
  *
  * @return 无返回值。
  */
-void RedisHelper::flush()
+void RedisHelper::flush(const AppendOnlyFile::Position &logPosition)
+{
+    ReadLock tableLock(dataBasesMutex);
+    std::vector<ReadLock> locks = lockAllShards();
+    if (writeAllData("", logPosition) && flushCallback)
+    {
+        flushCallback();
+    }
+}
+
+/**
+ * 按数据库下标、分片下标的顺序加所有分片的读锁。
+ *
+ * @return 返回持有的锁。
+ */
+std::vector<RedisHelper::ReadLock> RedisHelper::lockAllShards()
+{
+    std::vector<ReadLock> locks;
+    for (auto &keySpace : dataBases)
+    {
+        for (auto &shard : keySpace->shards)
+        {
+            locks.emplace_back(shard->mutex);
+        }
+    }
+    return locks;
+}
+
+/**
+ * 将一个数据库所有分片的数据以二进制快照格式写入到指定文件，调用方需持有所有分片的锁。
+ *
+ * @param keySpace 要写入的数据库。
+ * @param filePath 要写入的文件路径。
+ * @param logPosition 快照包含到追加日志的哪个位置。
+ * @return 写入成功返回true，否则返回false。
+ */
+bool RedisHelper::writeData(KeySpace &keySpace, const std::string &filePath, const AppendOnlyFile::Position &logPosition)
 {
-    // 打开文件并覆盖写入
-    std::string filePath = getFilePath();
-    std::ofstream outputFile(filePath);
+    // 写入临时文件，完成后替换原文件
+    SnapshotWriter writer(filePath, logPosition);
     // 检查文件是否成功打开
-    if (!outputFile)
+    if (!writer.isOpen())
     {
         std::cout << "文件：" << filePath << "打开失败" << std::endl;
-        return;
+        return false;
+    }
+    for (auto &shard : keySpace.shards)
+    {
+        shard->dataBase->forEach([&writer](const std::string &key, const RedisValue &value)
+                                 {
+            if (!key.empty())
+                writer.writeEntry(key, value); });
+    }
+    if (!writer.finish())
+    {
+        std::cout << "文件：" << filePath << "写入失败" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 把每个数据库写入各自的快照文件，调用方需持有所有分片的锁。
+ *
+ * @param suffix 文件名后缀，为空时直接写入快照文件。
+ * @param logPosition 快照包含到追加日志的哪个位置。
+ * @return 全部写入成功返回true。
+ */
+bool RedisHelper::writeAllData(const std::string &suffix, const AppendOnlyFile::Position &logPosition)
+{
+    bool success = true;
+    for (size_t i = 0; i < dataBases.size(); i++)
+    {
+        success = writeData(*dataBases[i], getFilePath(i) + suffix, logPosition) && success;
+    }
+    return success;
+}
+
+/**
+ * 用saveSnapshot写好的文件逐个替换快照文件。每个快照记着自己包含到日志的哪个位置，
+ * 中途失败或崩溃时已替换和未替换的文件都能和日志正确地组合。
+ *
+ * @param suffix saveSnapshot使用的文件名后缀。
+ * @return 全部替换成功返回true。
+ */
+bool RedisHelper::replaceSnapshot(const std::string &suffix)
+{
+    bool success = true;
+    for (size_t i = 0; i < dataBases.size(); i++)
+    {
+        std::string filePath = getFilePath(i);
+        success = std::rename((filePath + suffix).c_str(), filePath.c_str()) == 0 && success;
     }
-    auto currentNode = redisDataBase->getHead();
-    while (currentNode != nullptr)
+    return success;
+}
+
+void RedisHelper::discardSnapshot(const std::string &suffix)
+{
+    for (size_t i = 0; i < dataBases.size(); i++)
     {
-        std::string key = currentNode->key;
-        RedisValue value = currentNode->value;
-        if (!key.empty())
-            outputFile << key << ":" << value.dump() << std::endl;
-        currentNode = currentNode->forward[0];
+        std::string filePath = getFilePath(i) + suffix;
+        std::remove(filePath.c_str());
+        std::remove((filePath + ".tmp").c_str());
     }
-    // 关闭文件
-    outputFile.close();
 }
 
 /**
  * 获取Redis数据库文件的完整路径。
  *
+ * @param index 数据库索引。
  * @return 返回一个字符串，表示Redis数据库文件的完整路径。该路径由默认数据库文件夹名、数据库文件名和数据库索引号拼接而成。
  */
-std::string RedisHelper::getFilePath()
+std::string RedisHelper::getFilePath(int index)
 {
-    std::string folder = DEFAULT_DB_FOLDER;                         // 文件夹名
-    std::string fileName = DATABASE_FILE_NAME;                      // 文件名
-    std::string filePath = folder + "/" + fileName + dataBaseIndex; // 文件路径
+    std::string folder = DEFAULT_DB_FOLDER;                                 // 文件夹名
+    std::string fileName = DATABASE_FILE_NAME;                              // 文件名
+    std::string filePath = folder + "/" + fileName + std::to_string(index); // 文件路径
     return filePath;
 }
 
+/**
+ * 清空数据库，调用方需持有所有分片的写锁或保证没有其他线程访问。
+ *
+ * @param keySpace 要清空的数据库。
+ */
+void RedisHelper::resetKeySpace(KeySpace &keySpace)
+{
+    for (auto &shard : keySpace.shards)
+    {
+        shard->dataBase = std::make_shared<DataBase>(true);
+    }
+}
+
 // 从文件中加载
 /**
- * 使用给定的路径加载Redis数据库中的数据。
+ * 使用给定的路径加载Redis数据库中的数据，调用方需保证没有其他线程访问分片。
  *
+ * @param keySpace 数据加载到的数据库。
  * @param loadPath 用于加载数据的字符串路径。
+ * @return 返回快照头部记录的追加日志位置；文本格式或损坏的文件不对应任何日志，代数为0。
+ */
+AppendOnlyFile::Position RedisHelper::loadData(KeySpace &keySpace, std::string loadPath)
+{
+    SnapshotReader reader(loadPath);
+    if (!reader.isSnapshot())
+    {
+        loadTextData(keySpace, loadPath); // 旧版本的文本格式
+        return AppendOnlyFile::Position();
+    }
+    std::string key;
+    RedisValue value;
+    bool valid = true;
+    try
+    {
+        while (reader.readEntry(key, value))
+        {
+            keySpace.shards[getShardIndex(key)]->dataBase->addItem(key, value);
+        }
+        valid = reader.isValid();
+    }
+    catch (const std::exception &e)
+    {
+        // 损坏的数据导致分配内存失败等异常时同样按损坏处理，不让异常在启动时终止进程
+        std::cout << "文件：" << loadPath << "读取失败：" << e.what() << std::endl;
+        valid = false;
+    }
+    if (!valid)
+    {
+        // 文件损坏时不加载部分数据，把损坏的文件移到一边，避免下次写入时被覆盖
+        std::cout << "文件：" << loadPath << "已损坏，未加载，已重命名为" << loadPath << ".corrupt" << std::endl;
+        std::rename(loadPath.c_str(), (loadPath + ".corrupt").c_str());
+        resetKeySpace(keySpace);
+        return AppendOnlyFile::Position();
+    }
+    return reader.getLogPosition();
+}
+
+/**
+ * 加载旧版本的文本格式数据文件，每行的格式为key:value。
+ * 下次写入时会以二进制快照格式保存。
+ *
+ * @param keySpace 数据加载到的数据库。
+ * @param loadPath 数据文件路径。
  */
-void RedisHelper::loadData(std::string loadPath)
+void RedisHelper::loadTextData(KeySpace &keySpace, const std::string &loadPath)
 {
-    redisDataBase->loadFile(loadPath);
+    std::ifstream inputFile(loadPath);
+    if (!inputFile.is_open())
+    {
+        return;
+    }
+    std::string line;
+    std::string err;
+    while (std::getline(inputFile, line))
+    {
+        size_t index = line.find(':');
+        if (line.empty() || index == std::string::npos)
+        {
+            continue;
+        }
+        // 按key路由到对应分片
+        std::string key = line.substr(0, index);
+        RedisValue value = RedisValue::parse(line.substr(index + 1), err);
+        if (value.isArray())
+        {
+            // 旧格式的列表是字符串数组，转换为列表类型
+            QuickList valueList;
+            for (auto &element : value.arrayItems())
+            {
+                valueList.pushBack(element.toString());
+            }
+            value = RedisValue(std::move(valueList));
+        }
+        else if (value.isObject())
+        {
+            // 旧格式的哈希表是JSON对象，转换为哈希类型
+            CompactHash valueMap;
+            for (auto &field : value.objectItems())
+            {
+                valueMap.set(field.first, field.second.toString());
+            }
+            value = RedisValue(std::move(valueMap));
+        }
+        keySpace.shards[getShardIndex(key)]->dataBase->addItem(key, value);
+    }
+    inputFile.close();
 }
 
 // 选择数据库
 /**
- * 选择指定的Redis数据库。
+ * 选择指定的Redis数据库。所有数据库都常驻内存，只修改当前数据库下标。
  *
  * @param index 要选择的数据库的索引。如果索引超出范围，则返回错误信息。
  * @return 如果成功选择了数据库，返回"OK"；否则返回错误信息。
@@ -67,16 +322,74 @@ std::string RedisHelper::select(int index)
 {
     if (index < 0 || index > DATABASE_FILE_NUMBER - 1)
     {
-        return "database index out of range.";
+        return errorReply("database index out of range.");
+    }
+    currentIndex() = index;
+    return "OK";
+}
+// 交换数据库
+// 语法：swapdb index1 index2
+// 127.0.0.1:6379> swapdb 0 1
+// OK
+/**
+ * 交换两个数据库的内容，只交换指针，时间复杂度O(1)。
+ *
+ * @param index1 第一个数据库的索引。
+ * @param index2 第二个数据库的索引。
+ * @return 成功返回"OK"，索引超出范围时返回错误信息。
+ */
+std::string RedisHelper::swapdb(int index1, int index2)
+{
+    if (index1 < 0 || index1 > DATABASE_FILE_NUMBER - 1 || index2 < 0 || index2 > DATABASE_FILE_NUMBER - 1)
+    {
+        return errorReply("database index out of range.");
+    }
+    WriteLock tableLock(dataBasesMutex);
+    if (index1 != index2)
+    {
+        std::swap(dataBases[index1], dataBases[index2]);
+        logCommand(); // 其他命令写入日志时持有数据库表的读锁，swapdb的记录不会和它们交错
     }
-    flush(); // 选择数据库之前先写入一下
-    redisDataBase = std::make_shared<SkipList<std::string, RedisValue>>();
-    dataBaseIndex = std::to_string(index);
-    std::string filePath = getFilePath(); // 根据选择的数据库，修改文件路径，然后加载
-
-    loadData(filePath);
     return "OK";
 }
+// 移动键
+// 语法：move key db
+// 127.0.0.1:6379> move javastack 1
+// (integer) 1
+/**
+ * 把当前数据库中的key移动到指定数据库。
+ *
+ * @param key 要移动的键。
+ * @param index 目标数据库的索引。
+ * @return 移动成功返回"(integer) 1"；key不存在或目标数据库已有同名key时返回"(integer) 0"；索引非法时返回错误信息。
+ */
+std::string RedisHelper::move(const std::string &key, int index)
+{
+    if (index < 0 || index > DATABASE_FILE_NUMBER - 1)
+    {
+        return errorReply("database index out of range.");
+    }
+    int sourceIndex = currentIndex();
+    if (sourceIndex == index)
+    {
+        return errorReply("source and destination objects are the same");
+    }
+    ReadLock tableLock(dataBasesMutex);
+    // key在两个数据库中位于同一下标的分片，按数据库下标顺序加锁
+    size_t shardIndex = getShardIndex(key);
+    Shard &source = *dataBases[sourceIndex]->shards[shardIndex];
+    Shard &target = *dataBases[index]->shards[shardIndex];
+    WriteLock firstLock(sourceIndex < index ? source.mutex : target.mutex);
+    WriteLock secondLock(sourceIndex < index ? target.mutex : source.mutex);
+    auto currentNode = source.dataBase->searchItem(key);
+    if (currentNode == nullptr || !target.dataBase->findOrInsert(key, currentNode->value).second)
+    {
+        return "(integer) 0";
+    }
+    source.dataBase->deleteItem(key);
+    logCommand();
+    return "(integer) 1";
+}
 // key操作命令
 // 获取所有键
 // 语法：keys pattern
@@ -91,13 +404,21 @@ std::string RedisHelper::select(int index)
  */
 std::string RedisHelper::keys(const std::string pattern)
 {
+    // 各分片内部有序，合并后整体排序，保持和单个跳表时相同的输出顺序
+    std::vector<std::string> allKeys;
+    ReadLock tableLock(dataBasesMutex);
+    for (auto &shard : currentKeySpace().shards)
+    {
+        ReadLock lock(shard->mutex);
+        shard->dataBase->forEach([&allKeys](const std::string &key, const RedisValue &)
+                                 { allKeys.push_back(key); });
+    }
+    std::sort(allKeys.begin(), allKeys.end());
     std::string res = "";
-    auto node = redisDataBase->getHead()->forward[0];
     int count = 0;
-    while (node != nullptr)
+    for (auto &key : allKeys)
     {
-        res += std::to_string(++count) + ") " + "\"" + node->key + "\"" + "\n";
-        node = node->forward[0];
+        res += std::to_string(++count) + ") " + "\"" + key + "\"" + "\n";
     }
     if (!res.empty())
         res.pop_back();
@@ -117,11 +438,47 @@ std::string RedisHelper::keys(const std::string pattern)
  *
  * @return 返回一个字符串，该字符串以"(integer) "开头，后面跟着Redis数据库的大小。
  */
-std::string RedisHelper::dbsize() const
+std::string RedisHelper::dbsize()
 {
-    std::string res = "(integer) " + std::to_string(redisDataBase->size());
+    int size = 0;
+    ReadLock tableLock(dataBasesMutex);
+    for (auto &shard : currentKeySpace().shards)
+    {
+        size += shard->dataBase->size();
+    }
+    std::string res = "(integer) " + std::to_string(size);
     return res;
 }
+// 清空当前数据库
+// 语法：flushdb
+// 127.0.0.1:6379> flushdb
+// OK
+/**
+ * 删除当前数据库中的所有键。
+ *
+ * @return 返回"OK"。
+ */
+std::string RedisHelper::flushdb()
+{
+    ReadLock tableLock(dataBasesMutex);
+    KeySpace &keySpace = currentKeySpace();
+    std::vector<WriteLock> locks;
+    for (auto &shard : keySpace.shards)
+    {
+        locks.emplace_back(shard->mutex);
+    }
+    bool empty = true;
+    for (auto &shard : keySpace.shards)
+    {
+        empty = empty && shard->dataBase->size() == 0;
+    }
+    if (!empty)
+    {
+        resetKeySpace(keySpace);
+        logCommand();
+    }
+    return "OK";
+}
 // 查询键是否存在
 // 语法：exists key [key ...]
 // 127.0.0.1:6379> exists javastack java
@@ -130,17 +487,28 @@ std::string RedisHelper::dbsize() const
 /**
  * 检查给定的键是否存在于Redis数据库中，并返回存在的键的数量。
  *
- * @param keys 一个包含要检查的键的字符串向量。
+ * @param keys 要检查的键。
  * @return 返回一个字符串，表示在Redis数据库中找到的键的数量。格式为"(integer) " +找到的键的数量。
  */
-std::string RedisHelper::exists(const std::vector<std::string> &keys)
+std::string RedisHelper::exists(TokenSpan keys)
 {
     int count = 0;
-    for (auto &key : keys)
+    ReadLock tableLock(dataBasesMutex);
+    auto &shards = currentKeySpace().shards;
+    std::vector<std::vector<size_t>> groups = groupByShard(keys);
+    for (size_t i = 0; i < groups.size(); i++)
     {
-        if (redisDataBase->searchItem(key) != nullptr)
+        if (groups[i].empty())
         {
-            count++;
+            continue;
+        }
+        ReadLock lock(shards[i]->mutex);
+        for (size_t index : groups[i])
+        {
+            if (shards[i]->dataBase->searchItem(std::string(keys[index])) != nullptr)
+            {
+                count++;
+            }
         }
     }
     std::string res = "(integer) " + std::to_string(count);
@@ -154,17 +522,36 @@ std::string RedisHelper::exists(const std::vector<std::string> &keys)
 /**
  * 使用给定的键列表，从Redis数据库中删除相应的项。
  *
- * @param keys 一个包含要删除的键的字符串向量。
+ * @param keys 要删除的键。
  * @return 返回一个字符串，表示成功删除的项的数量。
  */
-std::string RedisHelper::del(const std::vector<std::string> &keys)
+std::string RedisHelper::del(TokenSpan keys)
 {
     int count = 0;
-    for (auto &key : keys)
+    ReadLock tableLock(dataBasesMutex);
+    auto &shards = currentKeySpace().shards;
+    std::vector<std::vector<size_t>> groups = groupByShard(keys);
+    TokenBuffer deleted; // 每个分片只记录实际删除的key
+    for (size_t i = 0; i < groups.size(); i++)
     {
-        if (redisDataBase->deleteItem(key))
+        if (groups[i].empty())
+        {
+            continue;
+        }
+        WriteLock lock(shards[i]->mutex);
+        deleted.clear();
+        deleted.push_back("del");
+        for (size_t index : groups[i])
+        {
+            if (shards[i]->dataBase->deleteItem(std::string(keys[index])))
+            {
+                deleted.push_back(keys[index]);
+                count++;
+            }
+        }
+        if (deleted.size() > 1)
         {
-            count++;
+            logCommand(deleted);
         }
     }
     std::string res = "(integer) " + std::to_string(count);
@@ -184,14 +571,35 @@ std::string RedisHelper::del(const std::vector<std::string> &keys)
  */
 std::string RedisHelper::rename(const std::string &oldName, const std::string &newName)
 {
-    auto currentNode = redisDataBase->searchItem(oldName);
+    ReadLock tableLock(dataBasesMutex);
+    auto &shards = currentKeySpace().shards;
+    // 两个key可能位于不同分片，按分片下标顺序加锁避免死锁
+    size_t oldIndex = getShardIndex(oldName);
+    size_t newIndex = getShardIndex(newName);
+    WriteLock firstLock(shards[std::min(oldIndex, newIndex)]->mutex);
+    WriteLock secondLock;
+    if (oldIndex != newIndex)
+    {
+        secondLock = WriteLock(shards[std::max(oldIndex, newIndex)]->mutex);
+    }
+    DataBase &oldDataBase = *shards[oldIndex]->dataBase;
+    DataBase &newDataBase = *shards[newIndex]->dataBase;
+    auto currentNode = oldDataBase.searchItem(oldName);
     std::string resMessage = "";
     if (currentNode == nullptr)
     {
-        resMessage += oldName + " does not exist!";
-        return resMessage;
+        return errorReply(oldName + " does not exist!");
+    }
+    if (oldName == newName)
+    {
+        return "OK";
     }
-    currentNode->key = newName;
+    // key决定节点在跳表中的位置，不能原地修改，需要以新key重新插入
+    RedisValue value = currentNode->value;
+    newDataBase.deleteItem(newName);
+    newDataBase.addItem(newName, value);
+    oldDataBase.deleteItem(oldName);
+    logCommand();
     resMessage = "OK";
     return resMessage;
 }
@@ -221,15 +629,11 @@ std::string RedisHelper::set(const std::string &key, const RedisValue &value, co
     }
     else
     {
-        auto currentNode = redisDataBase->searchItem(key);
-        if (currentNode == nullptr)
-        {
-            setnx(key, value);
-        }
-        else
-        {
-            setex(key, value);
-        }
+        ReadLock tableLock(dataBasesMutex);
+        Shard &shard = getShard(key);
+        WriteLock lock(shard.mutex);
+        putValue(*shard.dataBase, key, value);
+        logCommand();
     }
 
     return "OK";
@@ -244,15 +648,14 @@ std::string RedisHelper::set(const std::string &key, const RedisValue &value, co
  */
 std::string RedisHelper::setnx(const std::string &key, const RedisValue &value)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    if (currentNode != nullptr)
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    if (!shard.dataBase->findOrInsert(key, value).second)
     {
         return "key: " + key + "  exists!";
     }
-    else
-    {
-        redisDataBase->addItem(key, value);
-    }
+    logCommand();
     return "OK";
 }
 /**
@@ -264,7 +667,10 @@ std::string RedisHelper::setnx(const std::string &key, const RedisValue &value)
  */
 std::string RedisHelper::setex(const std::string &key, const RedisValue &value)
 {
-    auto currentNode = redisDataBase->searchItem(key);
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
     if (currentNode == nullptr)
     {
         return "key: " + key + " does not exist!";
@@ -272,6 +678,7 @@ std::string RedisHelper::setex(const std::string &key, const RedisValue &value)
     else
     {
         currentNode->value = value;
+        logCommand();
     }
     return "OK";
 }
@@ -289,12 +696,15 @@ std::string RedisHelper::setex(const std::string &key, const RedisValue &value)
  */
 std::string RedisHelper::get(const std::string &key)
 {
-    auto currentNode = redisDataBase->searchItem(key);
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    ReadLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
     if (currentNode == nullptr)
     {
         return "key: " + key + " does not exist!";
     }
-    return currentNode->value.dump();
+    return dumpString(currentNode->value);
 }
 // 值递增/递减
 // 如果字符串中的值是数字类型的，可以使用incr命令每次递增，不是数字类型则报错。
@@ -315,73 +725,124 @@ std::string RedisHelper::incr(const std::string &key)
 }
 /**
  * 使用给定的增量值增加Redis数据库中指定键的值。如果键不存在，则创建一个新的键并设置其值为增量值。
- * 如果键存在但其值不是数字类型，则返回错误信息。
+ * 值以int64整数编码保存，之后的递增直接修改原值；字符串形式的整数在第一次递增时转换为整数编码，
+ * incrbyfloat留下的浮点数编码（或数值字符串）只要是int64范围内的整数，也转换为整数编码。
  *
  * @param key 需要增加值的Redis键。
- * @param increment 需要增加的值。
- * @return 如果操作成功，返回"(integer) " + value，其中value是新的键值；如果键不存在或其值不是数字类型，返回相应的错误信息。
+ * @param increment 需要增加的值，可以为负数。
+ * @return 如果操作成功，返回"(integer) " + value，其中value是新的键值；如果值不是整数或结果溢出，返回相应的错误信息。
  */
-std::string RedisHelper::incrby(const std::string &key, int increment)
+std::string RedisHelper::incrby(const std::string &key, int64_t increment)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    std::string value = "";
-    if (currentNode == nullptr)
-    {
-        value = std::to_string(increment);
-        redisDataBase->addItem(key, value);
-        return "(integer) " + value;
-    }
-    value = currentNode->value.dump();
-    // 去掉双引号
-    value.erase(0, 1);
-    value.erase(value.size() - 1);
-    for (char ch : value)
-    {
-        if (!isdigit(ch))
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    std::string res = "";
+    bool modified = false;
+    // key不存在时直接以增量值创建，存在时在原节点上累加，只遍历一次跳表
+    shard.dataBase->upsert(key, RedisValue(increment), [&](RedisValue &currentValue, bool created)
+                           {
+        modified = created;
+        if (created)
+        {
+            res = "(integer) " + std::to_string(increment);
+            return;
+        }
+        if (!currentValue.isInteger())
+        {
+            int64_t value = 0;
+            double doubleValue = 0.0;
+            bool integral = currentValue.isString() && RedisValue::parseInteger(currentValue.stringValue(), value);
+            if (!integral && (currentValue.isNumber() || (currentValue.isString() && RedisValue::parseDouble(currentValue.stringValue(), doubleValue))))
+            {
+                if (currentValue.isNumber())
+                {
+                    doubleValue = currentValue.doubleValue();
+                }
+                // 2^63可以用double精确表示，范围检查用半开区间
+                integral = std::trunc(doubleValue) == doubleValue && doubleValue >= -9223372036854775808.0 && doubleValue < 9223372036854775808.0;
+                value = integral ? static_cast<int64_t>(doubleValue) : 0;
+            }
+            if (!integral)
+            {
+                res = errorReply("The value of " + key + " is not a numeric type");
+                return;
+            }
+            currentValue = RedisValue(value);
+        }
+        int64_t &value = currentValue.integerValue();
+        int64_t result = 0;
+        if (__builtin_add_overflow(value, increment, &result))
         {
-            std::string res = "The value of " + key + " is not a numeric type";
-            return res;
+            res = errorReply("increment or decrement would overflow");
+            return;
         }
+        value = result;
+        modified = true;
+        res = "(integer) " + std::to_string(result); });
+    if (modified)
+    {
+        logCommand();
     }
-    int curValue = std::stoi(value) + increment;
-    value = std::to_string(curValue);
-    currentNode->value = value;
-    std::string res = "(integer) " + value;
     return res;
 }
 /**
  * 使用给定的增量值增加指定键的值。如果键不存在，则创建一个新的键并设置其值为增量值。
- * 如果键存在但值不是数字类型，则返回错误信息。
+ * 值以double编码保存，整数编码和字符串形式的数值在第一次递增时转换。
  *
  * @param key 需要增加值的键。
  * @param increment 需要增加的值。
- * @return 如果操作成功，返回"(float) " + value；如果键不存在，返回"(float) " + increment；如果键存在但值不是数字类型，返回"The value of " + key + " is not a numeric type"。
+ * @return 如果操作成功，返回"(float) " + value；如果值不是数字类型或结果不是有限数，返回相应的错误信息。
  */
 std::string RedisHelper::incrbyfloat(const std::string &key, double increment)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    std::string value = "";
-    if (currentNode == nullptr)
-    {
-        value = std::to_string(increment);
-        redisDataBase->addItem(key, value);
-        return "(float) " + value;
-    }
-    value = currentNode->value.dump();
-    value.erase(0, 1);
-    value.erase(value.size() - 1);
-    double curValue = 0.0;
-    try
-    {
-        curValue = std::stod(value) + increment;
-    }
-    catch (std::invalid_argument const &e)
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    std::string res = "";
+    bool modified = false;
+    shard.dataBase->upsert(key, RedisValue(increment), [&](RedisValue &currentValue, bool created)
+                           {
+        modified = created;
+        if (created)
+        {
+            res = "(float) " + std::to_string(increment);
+            return;
+        }
+        double value = 0.0;
+        if (currentValue.isInteger())
+        {
+            value = static_cast<double>(currentValue.integerValue());
+        }
+        else if (currentValue.isNumber())
+        {
+            value = currentValue.doubleValue();
+        }
+        else if (!currentValue.isString() || !RedisValue::parseDouble(currentValue.stringValue(), value))
+        {
+            res = errorReply("The value of " + key + " is not a numeric type");
+            return;
+        }
+        value += increment;
+        if (!std::isfinite(value))
+        {
+            res = errorReply("increment would produce NaN or Infinity");
+            return;
+        }
+        if (currentValue.isNumber() && !currentValue.isInteger())
+        {
+            currentValue.doubleValue() = value;
+        }
+        else
+        {
+            currentValue = RedisValue(value);
+        }
+        modified = true;
+        res = "(float) " + std::to_string(value); });
+    if (modified)
     {
-        return "The value of " + key + " is not a numeric type";
+        logCommand();
     }
-    value = std::to_string(curValue);
-    currentNode->value = value;
-    std::string res = "(float) " + value;
     return res;
 }
 // 同样，递减使用decr、decrby命令。
@@ -402,8 +863,12 @@ std::string RedisHelper::decr(const std::string &key)
  * @param increment 要减去的增量值。
  * @return 返回操作后的键值。
  */
-std::string RedisHelper::decrby(const std::string &key, int increment)
+std::string RedisHelper::decrby(const std::string &key, int64_t increment)
 {
+    if (increment == std::numeric_limits<int64_t>::min())
+    {
+        return errorReply("increment or decrement would overflow"); // 取负会溢出
+    }
     return incrby(key, -increment);
 }
 // 批量存放键值
@@ -414,20 +879,35 @@ std::string RedisHelper::decrby(const std::string &key, int increment)
 /**
  * 使用给定的键值对列表，通过RedisHelper类的mset方法批量设置键值对。
  *
- * @param items 一个包含键值对的字符串向量，其中偶数索引处的元素为键，奇数索引处的元素为对应的值。
+ * @param items 键值对，其中偶数索引处的元素为键，奇数索引处的元素为对应的值。
  * @return 如果参数数量正确且所有键值对都成功设置，则返回"OK"；如果参数数量不正确，则返回错误信息"wrong number of arguments for MSET."。
  */
-std::string RedisHelper::mset(std::vector<std::string> &items)
+std::string RedisHelper::mset(TokenSpan items)
 {
     if (items.size() % 2 != 0)
     {
-        return "wrong number of arguments for MSET.";
+        return errorReply("wrong number of arguments for MSET.");
     }
-    for (int i = 0; i < items.size(); i += 2)
+    std::vector<std::vector<size_t>> groups = groupByShard(items, 2);
+    ReadLock tableLock(dataBasesMutex);
+    auto &shards = currentKeySpace().shards;
+    TokenBuffer written; // 每个分片只记录写入这个分片的键值对
+    for (size_t i = 0; i < groups.size(); i++)
     {
-        std::string key = items[i];
-        std::string value = items[i + 1];
-        set(key, value);
+        if (groups[i].empty())
+        {
+            continue;
+        }
+        WriteLock lock(shards[i]->mutex);
+        written.clear();
+        written.push_back("mset");
+        for (size_t index : groups[i])
+        {
+            putValue(*shards[i]->dataBase, std::string(items[index]), std::string(items[index + 1]));
+            written.push_back(items[index]);
+            written.push_back(items[index + 1]);
+        }
+        logCommand(written);
     }
     return "OK";
 }
@@ -440,33 +920,41 @@ std::string RedisHelper::mset(std::vector<std::string> &items)
 /**
  * 使用给定的键列表，从Redis数据库中获取对应的值。
  *
- * @param keys 一个包含要查询的键的字符串向量。
+ * @param keys 要查询的键。
  * @return 如果所有键都存在，返回一个字符串，其中包含每个键及其对应值的列表；如果某个键不存在，则在对应的位置上显示"(nil)"；如果传入的键列表为空，则返回错误信息"wrong number of arguments for MGET."。
  */
-std::string RedisHelper::mget(std::vector<std::string> &keys)
+std::string RedisHelper::mget(TokenSpan keys)
 {
     if (keys.size() == 0)
     {
-        return "wrong number of arguments for MGET.";
+        return errorReply("wrong number of arguments for MGET.");
     }
-    std::vector<std::string> values;
-    std::string res = "";
-    for (int i = 0; i < keys.size(); i++)
+    // 按分片分组读取，结果仍按参数顺序输出
+    std::vector<std::string> values(keys.size(), "(nil)");
+    std::vector<std::vector<size_t>> groups = groupByShard(keys);
+    ReadLock tableLock(dataBasesMutex);
+    auto &shards = currentKeySpace().shards;
+    for (size_t i = 0; i < groups.size(); i++)
     {
-        std::string &key = keys[i];
-        std::string value = "";
-        auto currentNode = redisDataBase->searchItem(key);
-        if (currentNode == nullptr)
+        if (groups[i].empty())
         {
-            value = "(nil)";
-            res += std::to_string(i + 1) + ") " + value + "\n";
+            continue;
         }
-        else
+        ReadLock lock(shards[i]->mutex);
+        for (size_t index : groups[i])
         {
-            value = currentNode->value.dump();
-            res += std::to_string(i + 1) + ") " + value + "\n";
+            auto currentNode = shards[i]->dataBase->searchItem(std::string(keys[index]));
+            if (currentNode != nullptr)
+            {
+                values[index] = dumpString(currentNode->value);
+            }
         }
     }
+    std::string res = "";
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        res += std::to_string(i + 1) + ") " + values[i] + "\n";
+    }
     res.pop_back();
     return res;
 }
@@ -481,12 +969,16 @@ std::string RedisHelper::mget(std::vector<std::string> &keys)
  */
 std::string RedisHelper::strlen(const std::string &key)
 {
-    auto currentNode = redisDataBase->searchItem(key);
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    ReadLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
     if (currentNode == nullptr)
     {
         return "(integer) 0";
     }
-    return "(integer) " + std::to_string(currentNode->value.dump().size());
+    RedisValue &value = currentNode->value;
+    return "(integer) " + std::to_string(value.isString() ? value.stringValue().size() : value.toString().size());
 }
 // 追加内容
 // 语法：append key value
@@ -502,329 +994,670 @@ std::string RedisHelper::strlen(const std::string &key)
  */
 std::string RedisHelper::append(const std::string &key, const std::string &value)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    if (currentNode == nullptr)
-    {
-        redisDataBase->addItem(key, value);
-        return "(integer) " + std::to_string(value.size());
-    }
-    currentNode->value = currentNode->value.dump() + value;
-    return "(integer) " + std::to_string(currentNode->value.dump().size());
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    auto result = shard.dataBase->upsert(key, value, [&value](RedisValue &currentValue, bool created)
+                                         {
+        if (created)
+            return;
+        if (currentValue.isString())
+            currentValue.stringValue() += value; // 字符串原地追加
+        else
+            currentValue = currentValue.toString() + value; });
+    logCommand();
+    return "(integer) " + std::to_string(result.first->value.stringValue().size());
 }
 
 /**
  * 构造函数，用于初始化RedisHelper对象。
- * 在默认数据库文件夹中创建文件和数据库文件，然后加载数据。
+ * 在默认数据库文件夹中创建文件和数据库文件，然后为每个数据库创建分片并加载数据。
  *
- * @param 无参数
+ * @param shardNumber 键空间的分片数，小于1时按1处理。
  * @return 无返回值
  */
-RedisHelper::RedisHelper()
+RedisHelper::RedisHelper(int shardNumber)
 {
+    this->shardNumber = std::max(shardNumber, 1);
     FileCreator::createFolderAndFiles(DEFAULT_DB_FOLDER, DATABASE_FILE_NAME, DATABASE_FILE_NUMBER);
-    std::string filePath = getFilePath();
-    loadData(filePath);
+    for (int i = 0; i < DATABASE_FILE_NUMBER; i++)
+    {
+        dataBases.emplace_back(new KeySpace());
+        for (int j = 0; j < this->shardNumber; j++)
+        {
+            dataBases[i]->shards.emplace_back(new Shard());
+        }
+        snapshotPositions.push_back(loadData(*dataBases[i], getFilePath(i)));
+    }
 }
-RedisHelper::~RedisHelper() { flush(); }
+// 快照由RedisServer在关闭时写入，这里不再写一次
+RedisHelper::~RedisHelper() = default;
 
-// 列表操作
-//  LPUSH key value：将一个值插入到列表头部。
-//  RPUSH key value：将一个值插入到列表尾部。
-//  LPOP key：移出并获取列表的第一个元素。
-//  RPOP key：移出并获取列表的最后一个元素。
-//  LRANGE key start stop：获取列表指定范围内的元素。
 /**
- * 使用给定的键和值，将值推入Redis数据库中对应的列表。如果键不存在，则创建一个新的列表并添加值；如果键存在但值不是列表，则返回错误信息；如果键存在且值是列表，则在列表头部插入值。
+ * fork子进程执行后台任务。fork期间持有所有数据库所有分片的读锁，保证子进程看到的每个值都不在修改中途。
  *
- * @param key 要操作的Redis数据库中的键。
- * @param value 要插入的值。
- * @return 如果操作成功，返回一个字符串，表示列表的新长度；如果键已存在但值不是列表，返回错误信息。
+ * @param childMain 子进程中执行的函数，参数是子进程中的RedisHelper，返回值作为子进程的退出码。
+ * @param cowFd 不为空时输出读取子进程写时复制大小的管道。
+ * @return 返回子进程pid，fork失败返回-1。
  */
-std::string RedisHelper::lpush(const std::string &key, const std::string &value)
+pid_t RedisHelper::forkChild(const std::function<int(RedisHelper &)> &childMain, int *cowFd)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int size = 0;
-    if (currentNode == nullptr)
+    ReadLock tableLock(dataBasesMutex);
+    std::vector<ReadLock> locks = lockAllShards();
+    return ChildProcess::start([this, &childMain]()
+                               { return childMain(*this); },
+                               cowFd);
+}
+
+/**
+ * 生成重建所有数据库的命令：依次select到每个数据库并清空，再逐个key写入，最后切回0号数据库。
+ * 字符串用set，列表每批最多REWRITE_ITEMS_PER_COMMAND个元素用一条rpush，哈希表每批最多REWRITE_ITEMS_PER_COMMAND个字段用一条hset。
+ * 空的列表和哈希表无法用命令重建，直接跳过。
+ *
+ * @param emit 接收每条命令的回调。
+ */
+void RedisHelper::rewriteCommands(const std::function<void(const std::vector<std::string> &)> &emit)
+{
+    std::vector<std::string> tokens;
+    for (size_t i = 0; i < dataBases.size(); i++)
     {
-        std::vector<RedisValue> data;
-        RedisValue redisList(data);
-        RedisValue::array &valueList = redisList.arrayItems();
-        valueList.insert(valueList.begin(), value);
-        redisDataBase->addItem(key, redisList);
-        size = 1;
-    }
-    else
-    {
-        if (currentNode->value.type() != RedisValue::ARRAY)
+        if (i != 0)
         {
-            resMessage = "The key:" + key + " " + "already exists and the value is not a list!";
-            return resMessage;
+            emit({"select", std::to_string(i)});
         }
-        else
+        emit({"flushdb"});
+        for (auto &shard : dataBases[i]->shards)
         {
-            RedisValue::array &valueList = currentNode->value.arrayItems();
-            valueList.insert(valueList.begin(), value);
-            size = valueList.size();
+            shard->dataBase->forEach([&emit, &tokens](const std::string &key, const RedisValue &value)
+                                     {
+                RedisValue item = value;
+                if (item.type() == RedisValue::STRING)
+                {
+                    emit({"set", key, item.stringValue()});
+                }
+                else if (item.type() == RedisValue::NUMBER)
+                {
+                    emit({"set", key, item.toString()});
+                }
+                else if (item.type() == RedisValue::LIST)
+                {
+                    QuickList &valueList = item.listItems();
+                    tokens.clear();
+                    for (size_t index = 0; index < valueList.size(); index++)
+                    {
+                        if (tokens.empty())
+                        {
+                            tokens = {"rpush", key};
+                        }
+                        tokens.push_back(valueList[index]);
+                        if (tokens.size() >= 2 + REWRITE_ITEMS_PER_COMMAND)
+                        {
+                            emit(tokens);
+                            tokens.clear();
+                        }
+                    }
+                    if (!tokens.empty())
+                    {
+                        emit(tokens);
+                    }
+                }
+                else if (item.type() == RedisValue::HASH)
+                {
+                    tokens.clear();
+                    item.hashItems().forEach([&](std::string_view field, std::string_view fieldValue)
+                                             {
+                        if (tokens.empty())
+                        {
+                            tokens = {"hset", key};
+                        }
+                        tokens.emplace_back(field);
+                        tokens.emplace_back(fieldValue);
+                        if (tokens.size() >= 2 + 2 * REWRITE_ITEMS_PER_COMMAND)
+                        {
+                            emit(tokens);
+                            tokens.clear();
+                        } });
+                    if (!tokens.empty())
+                    {
+                        emit(tokens);
+                    }
+                } });
         }
     }
+    emit({"select", "0"});
+}
 
-    resMessage = "(integer) " + std::to_string(size);
-    return resMessage;
+/**
+ * 使用FNV-1a哈希计算key所在的分片。
+ * 不使用std::hash：跳表的哈希索引用std::hash的低位定位槽位，分片也取低位会让同一分片内的key集中在少数槽位上。
+ *
+ * @param key 要定位的键。
+ * @return 返回分片下标。
+ */
+size_t RedisHelper::getShardIndex(std::string_view key) const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char ch : key)
+    {
+        hash ^= ch;
+        hash *= 1099511628211ULL;
+    }
+    return hash % shardNumber;
 }
+
 /**
- * 使用给定的键和值，将值添加到Redis数据库中的列表中。如果键不存在，则创建一个新的列表并添加值。如果键存在但对应的值不是列表，则返回错误消息。
+ * 把keys按所在分片分组，多key命令对每个分片只加一次锁。
  *
- * @param key 要添加到Redis数据库的键。
- * @param value 要添加到Redis数据库的值。
- * @return 如果操作成功，返回一个字符串，表示列表的新大小；如果键存在但对应的值不是列表，返回一个错误消息。
+ * @param keys 键数组。
+ * @param step 键在数组中的间隔，mset的参数是键值交替排列的，间隔为2。
+ * @return 返回每个分片对应的key在keys中的下标。
  */
-std::string RedisHelper::rpush(const std::string &key, const std::string &value)
+std::vector<std::vector<size_t>> RedisHelper::groupByShard(TokenSpan keys, size_t step) const
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int size = 0;
-    if (currentNode == nullptr)
+    std::vector<std::vector<size_t>> groups(shardNumber);
+    for (size_t i = 0; i < keys.size(); i += step)
     {
-        std::vector<RedisValue> data;
-        RedisValue redisList(data);
-        RedisValue::array &valueList = redisList.arrayItems();
-        valueList.push_back(value);
-        redisDataBase->addItem(key, redisList);
-        size = 1;
+        groups[getShardIndex(keys[i])].push_back(i);
     }
-    else
+    return groups;
+}
+
+/**
+ * 写入键值：key不存在时插入，存在时覆盖。调用方需持有key所在分片的写锁。
+ *
+ * @param dataBase key所在分片的跳表。
+ * @param key 键。
+ * @param value 值。
+ */
+void RedisHelper::putValue(DataBase &dataBase, const std::string &key, const RedisValue &value)
+{
+    dataBase.upsert(key, value, [&value](RedisValue &currentValue, bool created)
+                    {
+        if (!created)
+            currentValue = value; });
+}
+
+/**
+ * 把当前线程绑定的命令写入追加日志。调用方需持有修改的key所在分片的写锁（或独占数据库表），
+ * 这样同一个key上的命令写入日志的顺序和执行顺序一致。没有绑定命令或没有设置日志时不记录。
+ */
+void RedisHelper::logCommand()
+{
+    if (loggedCommand != nullptr)
+    {
+        logCommand(loggedCommand->tokens);
+    }
+}
+
+/**
+ * 以tokens代替当前线程绑定的命令写入追加日志，多key命令用它只记录一个分片里实际修改的部分。
+ * 调用方需持有这些key所在分片的写锁。
+ *
+ * @param tokens 要记录的命令及其参数。
+ */
+void RedisHelper::logCommand(TokenSpan tokens)
+{
+    if (appendOnlyFile == nullptr || loggedCommand == nullptr)
+    {
+        return;
+    }
+    loggedCommand->record = appendOnlyFile->append(currentIndex(), tokens);
+}
+
+/**
+ * 生成get、mget回复中的值。数值编码的值对客户端来说仍是字符串，和字符串一样加上引号；
+ * 整数和std::to_string生成的浮点数不含需要转义的字符。
+ *
+ * @param value 要输出的值。
+ * @return 值的文本形式。
+ */
+std::string RedisHelper::dumpString(const RedisValue &value)
+{
+    if (value.isNumber())
     {
-        if (currentNode->value.type() != RedisValue::ARRAY)
+        return "\"" + value.toString() + "\"";
+    }
+    return value.dump();
+}
+
+// 列表操作
+//  LPUSH key value [value ...]：将一个或多个值依次插入到列表头部。
+//  RPUSH key value [value ...]：将一个或多个值依次插入到列表尾部。
+//  LPOP key：移出并获取列表的第一个元素。
+//  RPOP key：移出并获取列表的最后一个元素。
+//  LRANGE key start stop：获取列表指定范围内的元素。
+//  LINDEX key index：获取列表中指定下标的元素。
+//  LSET key index value：修改列表中指定下标的元素。
+//  LTRIM key start stop：只保留列表指定范围内的元素。
+//  LLEN key：获取列表的长度。
+// 列表以QuickList保存，两端插入、删除和按下标访问都是O(1)。
+/**
+ * 把负数下标换算为正数，并把范围截到列表之内。
+ *
+ * @param start 起始下标（包含），换算后写回。
+ * @param end 结束下标（包含），换算后写回。
+ * @param size 列表长度。
+ * @return 范围内至少有一个元素时返回true，否则返回false。
+ */
+bool RedisHelper::normalizeRange(int64_t &start, int64_t &end, size_t size)
+{
+    int64_t length = static_cast<int64_t>(size);
+    if (start < 0)
+    {
+        start = std::max<int64_t>(start + length, 0);
+    }
+    if (end < 0)
+    {
+        end += length;
+    }
+    end = std::min(end, length - 1);
+    return start <= end && start < length;
+}
+/**
+ * 把values依次插入列表的头部或尾部。如果键不存在，则创建一个新的列表；如果键存在但值不是列表，则返回错误信息。
+ *
+ * @param key 要操作的Redis数据库中的键。
+ * @param values 要插入的值，插入头部时最后一个值在最前面。
+ * @param front 为true时插入头部，否则插入尾部。
+ * @return 如果操作成功，返回列表的新长度；如果键已存在但值不是列表，返回错误信息。
+ */
+std::string RedisHelper::push(const std::string &key, TokenSpan values, bool front)
+{
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    std::string resMessage = "";
+    bool modified = false;
+    // key不存在时以空列表创建节点，再统一插入元素
+    shard.dataBase->upsert(key, RedisValue(QuickList()), [&](RedisValue &currentValue, bool)
+                           {
+        if (!currentValue.isList())
         {
-            resMessage = "The key:" + key + " " + "already exists and the value is not a list!";
-            return resMessage;
+            resMessage = errorReply("The key:" + key + " " + "already exists and the value is not a list!", "WRONGTYPE");
+            return;
         }
-        else
+        QuickList &valueList = currentValue.listItems();
+        for (std::string_view value : values)
         {
-            RedisValue::array &valueList = currentNode->value.arrayItems();
-            valueList.push_back(value);
-            size = valueList.size();
+            if (front)
+                valueList.pushFront(std::string(value));
+            else
+                valueList.pushBack(std::string(value));
         }
+        modified = true;
+        resMessage = "(integer) " + std::to_string(valueList.size()); });
+    if (modified)
+    {
+        logCommand();
     }
-
-    resMessage = "(integer) " + std::to_string(size);
     return resMessage;
 }
 /**
- * 使用给定的键从Redis数据库中获取并移除列表的第一个元素。
+ * 使用给定的键和值，将值依次推入Redis数据库中对应列表的头部。
  *
- * @param key 要查询的键名。
- * @return 如果键存在并且对应的值是一个数组，返回数组的第一个元素的字符串表示；如果键不存在或者对应的值不是一个数组，返回"(nil)"。
+ * @param key 要操作的Redis数据库中的键。
+ * @param values 要插入的值。
+ * @return 如果操作成功，返回一个字符串，表示列表的新长度；如果键已存在但值不是列表，返回错误信息。
  */
-std::string RedisHelper::lpop(const std::string &key)
+std::string RedisHelper::lpush(const std::string &key, TokenSpan values)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int size = 0;
-    if (currentNode == nullptr || currentNode->value.type() != RedisValue::ARRAY)
+    return push(key, values, true);
+}
+/**
+ * 使用给定的键和值，将值依次添加到Redis数据库中对应列表的尾部。
+ *
+ * @param key 要添加到Redis数据库的键。
+ * @param values 要添加到Redis数据库的值。
+ * @return 如果操作成功，返回一个字符串，表示列表的新大小；如果键存在但对应的值不是列表，返回一个错误消息。
+ */
+std::string RedisHelper::rpush(const std::string &key, TokenSpan values)
+{
+    return push(key, values, false);
+}
+/**
+ * 移除并返回列表的第一个或最后一个元素，列表空了之后删除key。
+ *
+ * @param key 要操作的Redis键。
+ * @param front 为true时移除第一个元素，否则移除最后一个元素。
+ * @return 被移除的元素；如果键不存在或其值不是列表，返回"(nil)"。
+ */
+std::string RedisHelper::pop(const std::string &key, bool front)
+{
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
+    if (currentNode == nullptr || !currentNode->value.isList() || currentNode->value.listItems().empty())
     {
-        resMessage = "(nil)";
+        return "(nil)";
     }
-    else
+    QuickList &valueList = currentNode->value.listItems();
+    std::string resMessage = front ? valueList.popFront() : valueList.popBack();
+    if (valueList.empty())
     {
-
-        RedisValue::array &valueList = currentNode->value.arrayItems();
-        resMessage = (*valueList.begin()).dump();
-        valueList.erase(valueList.begin());
-        resMessage.erase(0, 1);
-        resMessage.erase(resMessage.size() - 1);
+        shard.dataBase->deleteItem(key);
     }
+    logCommand();
     return resMessage;
 }
+/**
+ * 使用给定的键从Redis数据库中获取并移除列表的第一个元素。
+ *
+ * @param key 要查询的键名。
+ * @return 如果键存在并且对应的值是一个列表，返回列表的第一个元素；如果键不存在或者对应的值不是一个列表，返回"(nil)"。
+ */
+std::string RedisHelper::lpop(const std::string &key)
+{
+    return pop(key, true);
+}
 /**
  * 使用给定的键从Redis数据库中移除并返回最后一个元素。
  *
  * @param key 要操作的Redis键。
- * @return 如果键存在并且其值是一个数组，则返回该数组的最后一个元素；如果键不存在或其值不是一个数组，则返回"(nil)"。
+ * @return 如果键存在并且其值是一个列表，则返回该列表的最后一个元素；如果键不存在或其值不是一个列表，则返回"(nil)"。
  */
 std::string RedisHelper::rpop(const std::string &key)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int size = 0;
-    if (currentNode == nullptr || currentNode->value.type() != RedisValue::ARRAY)
+    return pop(key, false);
+}
+/**
+ * 使用给定的键、起始和结束索引，从Redis数据库中获取列表指定范围内的元素，并以字符串形式返回。
+ *
+ * @param key 要查询的Redis键。
+ * @param start 要获取的元素的起始索引（包含），负数表示从末尾倒数。
+ * @param end 要获取的元素的结束索引（包含），负数表示从末尾倒数。
+ * @return 如果找到了对应的键并且其值是一个列表，则返回该列表中指定范围内的元素组成的字符串；如果找不到对应的键或者其值不是一个列表，则返回"(nil)"或"(empty list or set)"。
+ */
+std::string RedisHelper::lrange(const std::string &key, int64_t start, int64_t end)
+{
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    ReadLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
+    if (currentNode == nullptr || !currentNode->value.isList())
     {
-        resMessage = "(nil)";
+        return "(nil)";
     }
-    else
+    QuickList &valueList = currentNode->value.listItems();
+    if (!normalizeRange(start, end, valueList.size()))
+    {
+        return "(empty list or set)";
+    }
+    std::string resMessage = "";
+    for (int64_t i = start; i <= end; i++)
     {
-        RedisValue::array &valueList = currentNode->value.arrayItems();
-        resMessage = (valueList.back()).dump();
-        valueList.pop_back();
-        resMessage.erase(0, 1);
-        resMessage.erase(resMessage.size() - 1);
+        resMessage += std::to_string(i - start + 1) + ") ";
+        RedisValue::quoteString(valueList[i], resMessage);
+        if (i != end)
+        {
+            resMessage += "\n";
+        }
     }
     return resMessage;
 }
 /**
- * 使用给定的键、起始和结束索引，从Redis数据库中获取一个数组类型的值，并以字符串形式返回。
+ * 获取列表中指定下标的元素。
  *
  * @param key 要查询的Redis键。
- * @param start 要获取的数组元素的起始索引（包含）。
- * @param end 要获取的数组元素的结束索引（包含）。
- * @return 如果找到了对应的键并且其值是一个数组，则返回该数组中指定范围内的元素组成的字符串；如果找不到对应的键或者其值不是一个数组，则返回"(nil)"或"(empty list or set)"。
+ * @param index 元素下标，负数表示从末尾倒数。
+ * @return 元素加上引号后的字符串；如果键不存在、值不是列表或下标越界，返回"(nil)"。
  */
-std::string RedisHelper::lrange(const std::string &key, const std::string &start, const std::string &end)
+std::string RedisHelper::lindex(const std::string &key, int64_t index)
 {
-    auto currentNode = redisDataBase->searchItem(key);
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    ReadLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
+    if (currentNode == nullptr || !currentNode->value.isList())
+    {
+        return "(nil)";
+    }
+    QuickList &valueList = currentNode->value.listItems();
+    int64_t end = index;
+    if (!normalizeRange(index, end, valueList.size()) || index != end)
+    {
+        return "(nil)";
+    }
     std::string resMessage = "";
-    int size = 0;
-    if (currentNode == nullptr || currentNode->value.type() != RedisValue::ARRAY)
+    RedisValue::quoteString(valueList[index], resMessage);
+    return resMessage;
+}
+/**
+ * 修改列表中指定下标的元素。
+ *
+ * @param key 要修改的Redis键。
+ * @param index 元素下标，负数表示从末尾倒数。
+ * @param value 新的元素值。
+ * @return 修改成功返回"OK"；键不存在、值不是列表或下标越界时返回错误信息。
+ */
+std::string RedisHelper::lset(const std::string &key, int64_t index, const std::string &value)
+{
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
+    if (currentNode == nullptr)
+    {
+        return errorReply("key: " + key + " does not exist!");
+    }
+    if (!currentNode->value.isList())
     {
-        resMessage = "(nil)";
+        return errorReply("The key:" + key + " " + "already exists and the value is not a list!", "WRONGTYPE");
+    }
+    QuickList &valueList = currentNode->value.listItems();
+    int64_t end = index;
+    if (!normalizeRange(index, end, valueList.size()) || index != end)
+    {
+        return errorReply("index out of range");
+    }
+    valueList[index] = value;
+    logCommand();
+    return "OK";
+}
+/**
+ * 只保留列表中指定范围内的元素，范围为空时删除key。
+ *
+ * @param key 要修改的Redis键。
+ * @param start 保留的起始下标（包含），负数表示从末尾倒数。
+ * @param end 保留的结束下标（包含），负数表示从末尾倒数。
+ * @return 返回"OK"；键存在但值不是列表时返回错误信息。
+ */
+std::string RedisHelper::ltrim(const std::string &key, int64_t start, int64_t end)
+{
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
+    if (currentNode == nullptr)
+    {
+        return "OK";
+    }
+    if (!currentNode->value.isList())
+    {
+        return errorReply("The key:" + key + " " + "already exists and the value is not a list!", "WRONGTYPE");
+    }
+    QuickList &valueList = currentNode->value.listItems();
+    if (!normalizeRange(start, end, valueList.size()))
+    {
+        shard.dataBase->deleteItem(key);
     }
     else
     {
-
-        RedisValue::array &valueList = currentNode->value.arrayItems();
-        int left = std::stoi(start);
-        int right = std::stoi(end);
-        left = std::max(left, 0);
-        right = std::min(right, int(valueList.size() - 1));
-        if (right < left || left >= valueList.size())
-        {
-            resMessage = "(empty list or set)";
-        }
-        for (int i = left; i <= right; i++)
-        {
-            auto item = valueList[i];
-            resMessage += std::to_string(i + 1) + ") " + item.dump();
-            if (i != right)
-            {
-                resMessage += "\n";
-            }
-        }
+        valueList.trim(start, end);
     }
-    return resMessage;
+    logCommand();
+    return "OK";
+}
+/**
+ * 获取列表的长度。
+ *
+ * @param key 要查询的Redis键。
+ * @return 返回"(integer) "加上列表长度，键不存在时长度为0；键存在但值不是列表时返回错误信息。
+ */
+std::string RedisHelper::llen(const std::string &key)
+{
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    ReadLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
+    if (currentNode == nullptr)
+    {
+        return "(integer) 0";
+    }
+    if (!currentNode->value.isList())
+    {
+        return errorReply("The key:" + key + " " + "already exists and the value is not a list!", "WRONGTYPE");
+    }
+    return "(integer) " + std::to_string(currentNode->value.listItems().size());
 }
 
 // 哈希表操作
-// HSET key field value：向哈希表中添加一个字段及其值。
+// HSET key field value [field value ...]：向哈希表中添加或修改字段及其值。
 // HGET key field：获取哈希表中指定字段的值。
 // HDEL key field：删除哈希表 key 中的一个或多个指定字段。
 // HKEYS key：获取哈希表中的所有字段名。
 // HVALS key：获取哈希表中的所有值。
+// HMGET key field [field ...]：获取哈希表中多个字段的值。
+// HGETALL key：获取哈希表中的所有字段名和值。
+// HINCRBY key field increment：把哈希表中字段的整数值加上增量。
+// 哈希表以CompactHash保存，字段少时存放在一块连续内存中，字段多时使用开放寻址哈希表。
 
 /**
- * 使用给定的键和字段值，将数据添加到Redis数据库中。如果键不存在，则创建一个新的哈希表并添加数据。如果键存在并且其值不是哈希表，则返回错误消息。如果键存在并且其值是哈希表，则更新哈希表并返回成功插入的字段数。
+ * 使用给定的键和字段值，将数据添加到Redis数据库中。如果键不存在，则创建一个新的哈希表并添加数据。如果键存在并且其值不是哈希表，则返回错误消息。如果键存在并且其值是哈希表，则写入所有字段并返回新增的字段数。
  *
  * @param key 要添加到Redis数据库中的键。
- * @param filed 一个包含字段名和字段值的向量。每个字段名后面紧跟着一个字段值。
- * @return 如果操作成功，返回一个字符串，表示成功插入的字段数；如果键已存在但其值不是哈希表，返回一个错误消息。
+ * @param filed 字段名和字段值，每个字段名后面紧跟着一个字段值。
+ * @return 如果操作成功，返回一个字符串，表示新增的字段数；如果键已存在但其值不是哈希表，返回一个错误消息。
  */
-std::string RedisHelper::hset(const std::string &key, const std::vector<std::string> &filed)
+std::string RedisHelper::hset(const std::string &key, TokenSpan filed)
 {
-    auto currentNode = redisDataBase->searchItem(key);
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
     std::string resMessage = "";
-    int count = 0;
-    if (currentNode == nullptr)
-    {
-        std::map<std::string, RedisValue> data;
-        RedisValue redisHash(data);
-        RedisValue::object &valueMap = redisHash.objectItems();
-        for (int i = 0; i < filed.size(); i += 2)
+    bool modified = false;
+    // key不存在时以空哈希表创建节点，再统一插入字段
+    shard.dataBase->upsert(key, RedisValue(CompactHash()), [&](RedisValue &currentValue, bool)
+                           {
+        if (!currentValue.isHash())
         {
-            std::string hkey = filed[i];
-            RedisValue hval = filed[i + 1];
-            if (!valueMap.count(hkey))
-            {
-                valueMap[hkey] = hval;
-                count++;
-            }
+            resMessage = errorReply("The key:" + key + " " + "already exists and the value is not a hashtable!", "WRONGTYPE");
+            return;
         }
-        redisDataBase->addItem(key, valueMap);
-    }
-    else
-    {
-        if (currentNode->value.type() != RedisValue::OBJECT)
-        {
-            resMessage = "The key:" + key + " " + "already exists and the value is not a hashtable!";
-            return resMessage;
-        }
-        else
+        CompactHash &valueMap = currentValue.hashItems();
+        int count = 0;
+        for (size_t i = 0; i + 1 < filed.size(); i += 2)
         {
-            RedisValue::object &valueMap = currentNode->value.objectItems();
-            for (int i = 0; i < filed.size(); i += 2)
+            if (valueMap.set(filed[i], filed[i + 1]))
             {
-                std::string hkey = filed[i];
-                RedisValue hval = filed[i + 1];
-                if (!valueMap.count(hkey))
-                {
-                    valueMap[hkey] = hval;
-                    count++;
-                }
+                count++;
             }
         }
+        modified = true;
+        resMessage = "(integer) " + std::to_string(count); });
+    if (modified)
+    {
+        logCommand();
     }
-
-    resMessage = "(integer) " + std::to_string(count);
     return resMessage;
 }
 /**
  * 使用给定的键和字段从Redis数据库中获取值。
  *
  * @param key 要搜索的Redis数据库中的键。
- * @param filed 要获取的值在Redis对象中的字段。
+ * @param filed 要获取的值在哈希表中的字段。
  * @return 如果找到对应的键和字段，返回该字段的值；否则返回"(nil)"。
  */
 std::string RedisHelper::hget(const std::string &key, const std::string &filed)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int count = 0;
-    if (currentNode == nullptr || currentNode->value.type() != RedisValue::OBJECT)
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    ReadLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
+    std::string_view value;
+    if (currentNode == nullptr || !currentNode->value.isHash() || !currentNode->value.hashItems().find(filed, value))
     {
-        resMessage = "(nil)";
+        return "(nil)";
     }
-    else
-    {
-        RedisValue::object &valueMap = currentNode->value.objectItems();
-        if (!valueMap.count(filed))
-        {
-            resMessage = "(nil)";
-        }
-        else
-        {
-            resMessage = valueMap[filed].stringValue();
-        }
-    }
-    return resMessage;
+    return std::string(value);
 }
 /**
- * 使用给定的键和字段列表，从Redis数据库中删除对应的哈希表项。
+ * 使用给定的键和字段列表，从Redis数据库中删除对应的哈希表项，哈希表空了之后删除key。
  *
  * @param key 要操作的Redis哈希表的键。
  * @param filed 包含要从哈希表中删除的字段的列表。
  * @return 返回一个字符串，表示成功删除的字段数量。
  */
-std::string RedisHelper::hdel(const std::string &key, const std::vector<std::string> &filed)
+std::string RedisHelper::hdel(const std::string &key, TokenSpan filed)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    std::string resMessage = "";
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
     int count = 0;
-    if (currentNode == nullptr || currentNode->value.type() != RedisValue::OBJECT)
+    if (currentNode != nullptr && currentNode->value.isHash())
     {
-        count = 0;
-    }
-    else
-    {
-        RedisValue::object &valueMap = currentNode->value.objectItems();
-        for (auto &hkey : filed)
+        CompactHash &valueMap = currentNode->value.hashItems();
+        for (std::string_view field : filed)
         {
-            if (valueMap.count(hkey))
+            if (valueMap.erase(field))
             {
                 count++;
-                valueMap.erase(hkey);
             }
         }
+        if (valueMap.empty())
+        {
+            shard.dataBase->deleteItem(key);
+        }
+    }
+    if (count > 0)
+    {
+        logCommand();
+    }
+    return "(integer) " + std::to_string(count);
+}
+
+/**
+ * 列出哈希表的字段名和（或）值，每项一行，前面加上序号。
+ *
+ * @param key 要查询的键名。
+ * @param withFields 是否输出字段名。
+ * @param withValues 是否输出值，和字段名都输出时字段名在前。
+ * @return 如果键不存在，返回"The key:[key] does not exist!"；如果键存在但值不是哈希表，返回"The key:[key] already exists and the value is not a hashtable!"；否则返回列出的各项。
+ */
+std::string RedisHelper::listHash(const std::string &key, bool withFields, bool withValues)
+{
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    ReadLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
+    if (currentNode == nullptr)
+    {
+        return "The key:" + key + " " + "does not exist!";
+    }
+    if (!currentNode->value.isHash())
+    {
+        return errorReply("The key:" + key + " " + "already exists and the value is not a hashtable!", "WRONGTYPE");
+    }
+    std::string resMessage = "";
+    int index = 1;
+    auto addItem = [&resMessage, &index](std::string_view item)
+    {
+        resMessage += std::to_string(index) + ") ";
+        resMessage.append(item.data(), item.size());
+        resMessage += "\n";
+        index++;
+    };
+    currentNode->value.hashItems().forEach([&](std::string_view field, std::string_view value)
+                                           {
+        if (withFields)
+            addItem(field);
+        if (withValues)
+            addItem(value); });
+    if (!resMessage.empty())
+    {
+        resMessage.pop_back();
     }
-    resMessage = "(integer) " + std::to_string(count);
     return resMessage;
 }
 
@@ -836,70 +1669,110 @@ std::string RedisHelper::hdel(const std::string &key, const std::vector<std::str
  */
 std::string RedisHelper::hkeys(const std::string &key)
 {
-    auto currentNode = redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int count = 0;
-    if (currentNode == nullptr)
+    return listHash(key, true, false);
+}
+
+/**
+ * 使用给定的键从Redis数据库中获取对应的哈希表的所有值。
+ *
+ * @param key 要查询的键，该键对应的值应为哈希表。
+ * @return 如果键不存在，返回"The key:[key] does not exist!"；如果键存在但对应的值不是哈希表，返回"The key:[key] already exists and the value is not a hashtable!"；如果键存在且对应的值为哈希表，则返回所有哈希表的值，每个值之间用换行符分隔。
+ */
+std::string RedisHelper::hvals(const std::string &key)
+{
+    return listHash(key, false, true);
+}
+
+/**
+ * 获取哈希表中所有的字段名和值，字段名和值交替排列。
+ *
+ * @param key 要查询的键，该键对应的值应为哈希表。
+ * @return 格式同hkeys，每个字段名后面紧跟着它的值。
+ */
+std::string RedisHelper::hgetall(const std::string &key)
+{
+    return listHash(key, true, true);
+}
+
+/**
+ * 获取哈希表中多个字段的值，结果按参数顺序输出。
+ *
+ * @param key 要查询的键。
+ * @param fields 要获取的字段。
+ * @return 每个字段的值，不存在的字段显示"(nil)"；键存在但值不是哈希表时返回错误信息。
+ */
+std::string RedisHelper::hmget(const std::string &key, TokenSpan fields)
+{
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    ReadLock lock(shard.mutex);
+    auto currentNode = shard.dataBase->searchItem(key);
+    if (currentNode != nullptr && !currentNode->value.isHash())
     {
-        resMessage = "The key:" + key + " " + "does not exist!";
-        return resMessage;
+        return errorReply("The key:" + key + " " + "already exists and the value is not a hashtable!", "WRONGTYPE");
     }
-    else
+    std::string resMessage = "";
+    for (size_t i = 0; i < fields.size(); i++)
     {
-        if (currentNode->value.type() != RedisValue::OBJECT)
+        std::string_view value;
+        resMessage += std::to_string(i + 1) + ") ";
+        if (currentNode != nullptr && currentNode->value.hashItems().find(fields[i], value))
         {
-            resMessage = "The key:" + key + " " + "already exists and the value is not a hashtable!";
-            return resMessage;
+            resMessage.append(value.data(), value.size());
         }
         else
         {
-            RedisValue::object &valueMap = currentNode->value.objectItems();
-            int index = 1;
-            for (auto hkey : valueMap)
-            {
-                resMessage += std::to_string(index) + ") " + hkey.first + "\n";
-                index++;
-            }
-            resMessage.erase(resMessage.size() - 1);
+            resMessage += "(nil)";
+        }
+        if (i + 1 != fields.size())
+        {
+            resMessage += "\n";
         }
     }
     return resMessage;
 }
 
 /**
- * 使用给定的键从Redis数据库中获取对应的哈希表的所有值。
+ * 把哈希表中字段的整数值加上增量。键或字段不存在时以增量值创建。
  *
- * @param key 要查询的键，该键对应的值应为哈希表。
- * @return 如果键不存在，返回"The key:[key] does not exist!"；如果键存在但对应的值不是哈希表，返回"The key:[key] already exists and the value is not a hashtable!"；如果键存在且对应的值为哈希表，则返回所有哈希表的值，每个值之间用换行符分隔。
+ * @param key 哈希表的键。
+ * @param field 要增加的字段。
+ * @param increment 增量，可以为负数。
+ * @return 成功时返回"(integer) "加上新的值；值不是整数、结果溢出或键的值不是哈希表时返回错误信息。
  */
-std::string RedisHelper::hvals(const std::string &key)
+std::string RedisHelper::hincrby(const std::string &key, const std::string &field, int64_t increment)
 {
-    auto currentNode = redisDataBase->searchItem(key);
+    ReadLock tableLock(dataBasesMutex);
+    Shard &shard = getShard(key);
+    WriteLock lock(shard.mutex);
     std::string resMessage = "";
-    int count = 0;
-    if (currentNode == nullptr)
-    {
-        resMessage = "The key:" + key + " " + "does not exist!";
-        return resMessage;
-    }
-    else
-    {
-        if (currentNode->value.type() != RedisValue::OBJECT)
+    bool modified = false;
+    shard.dataBase->upsert(key, RedisValue(CompactHash()), [&](RedisValue &currentValue, bool)
+                           {
+        if (!currentValue.isHash())
         {
-            resMessage = "The key:" + key + " " + "already exists and the value is not a hashtable!";
-            return resMessage;
+            resMessage = errorReply("The key:" + key + " " + "already exists and the value is not a hashtable!", "WRONGTYPE");
+            return;
         }
-        else
+        CompactHash &valueMap = currentValue.hashItems();
+        std::string_view oldValue;
+        int64_t value = 0;
+        if (valueMap.find(field, oldValue) && !RedisValue::parseInteger(oldValue, value))
         {
-            RedisValue::object &valueMap = currentNode->value.objectItems();
-            int index = 1;
-            for (auto hkey : valueMap)
-            {
-                resMessage += std::to_string(index) + ") " + hkey.second.stringValue() + "\n";
-                index++;
-            }
-            resMessage.erase(resMessage.size() - 1);
+            resMessage = errorReply("hash value is not an integer");
+            return;
         }
+        if (__builtin_add_overflow(value, increment, &value))
+        {
+            resMessage = errorReply("increment or decrement would overflow");
+            return;
+        }
+        valueMap.set(field, std::to_string(value));
+        modified = true;
+        resMessage = "(integer) " + std::to_string(value); });
+    if (modified)
+    {
+        logCommand();
     }
     return resMessage;
-}
\ No newline at end of file
+}
@@ -3,43 +3,227 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <shared_mutex>
+#include <atomic>
+#include <functional>
+#include <sys/types.h>
 #include "SkipList.h" 
 #include "RedisValue/RedisValue.h"
+#include "TokenSpan.h"
+#include "AppendOnlyFile.h"
 //#define DEFAULT_DB_FOLDER "data_files"
 #define DATABASE_FILE_NAME "db"
 #define DATABASE_FILE_NUMBER 15
+#define DEFAULT_SHARD_NUMBER 16 //默认分片数
+#define REWRITE_ITEMS_PER_COMMAND 64 //重写日志时一条命令最多包含的元素个数
 //增删改查操作
+/*
+    键空间按key的哈希分成若干个分片，每个分片有自己的跳表和读写锁，
+    不同分片上的读写互不影响；多key命令按分片分组，每个分片只加一次锁。
+    全部DATABASE_FILE_NUMBER个数据库常驻内存，select只修改当前数据库下标，
+    swapdb交换两个数据库的指针。命令执行期间持有数据库表的读锁，swapdb独占持有。
+    加锁顺序：数据库表 -> 按数据库下标、分片下标递增的分片锁。
+    当前数据库下标属于会话：执行命令的线程用SessionDataBase绑定会话的下标，没有绑定时使用全局下标
+    （启动时重放日志等场合）。
+    事务：TransactionLocks在执行事务前一次锁住涉及的分片（或独占数据库表），记在当前线程的
+    heldLocks中，事务中的命令再加这些锁时跳过，整个事务相对其他命令是原子的。
+    追加日志：执行命令的线程用LoggedCommand绑定命令，命令修改数据后在仍持有分片写锁时写入日志，
+    同一个key上的记录顺序和执行顺序一致；失败或没有修改数据的命令不写入。多key命令按分片
+    分别记录这个分片里实际修改的部分，swapdb在独占数据库表时记录。
+*/
 class RedisHelper{
 private:
+    typedef SkipList<std::string, RedisValue> DataBase;
+    struct HeldLock{
+        std::shared_mutex *mutex;
+        bool exclusive;
+    };
+    static thread_local std::vector<HeldLock> heldLocks; //当前线程在事务中已经持有的锁
+    static thread_local std::atomic<int> *sessionDataBaseIndex; //当前线程所执行会话的数据库下标
+    static bool isHeld(std::shared_mutex &mutex, bool exclusive); //当前线程是否已持有足够的锁
+
+    //用法和std::shared_lock、std::unique_lock相同，当前线程已在事务中持有这把锁时不再加锁
+    template<bool Exclusive>
+    class ScopedLock{
+    private:
+        std::shared_mutex *mutex = nullptr; //为空表示没有加锁
+    public:
+        ScopedLock() = default;
+        explicit ScopedLock(std::shared_mutex &target){
+            if(isHeld(target, Exclusive)){
+                return;
+            }
+            if(Exclusive){
+                target.lock();
+            }else{
+                target.lock_shared();
+            }
+            mutex = &target;
+        }
+        ScopedLock(ScopedLock &&other) noexcept : mutex(other.mutex) { other.mutex = nullptr; }
+        ScopedLock &operator=(ScopedLock &&other) noexcept{
+            if(this != &other){
+                unlock();
+                mutex = other.mutex;
+                other.mutex = nullptr;
+            }
+            return *this;
+        }
+        ScopedLock(const ScopedLock &) = delete;
+        ScopedLock &operator=(const ScopedLock &) = delete;
+        ~ScopedLock() { unlock(); }
+        void unlock(){
+            if(mutex == nullptr){
+                return;
+            }
+            if(Exclusive){
+                mutex->unlock();
+            }else{
+                mutex->unlock_shared();
+            }
+            mutex = nullptr;
+        }
+    };
+    typedef ScopedLock<false> ReadLock;
+    typedef ScopedLock<true> WriteLock;
+    struct Shard{
+        std::shared_ptr<DataBase> dataBase = std::make_shared<DataBase>(true); //分片数据，启用哈希索引加速单点查找
+        std::shared_mutex mutex; //分片读写锁
+    };
+    struct KeySpace{
+        std::vector<std::unique_ptr<Shard>> shards; //数据库分片
+    };
     // static const std::string DEFAULT_DB_FOLDER;
     // static const std::string DATABASE_FILE_NAME;
     // static const int DATABASE_FILE_NUMBER;
-    std::string dataBaseIndex="0"; //当前数据库索引
-    std::shared_ptr<SkipList<std::string, RedisValue>> redisDataBase = std::make_shared<SkipList<std::string, RedisValue>>(); //数据库
+    std::atomic<int> dataBaseIndex{0}; //没有绑定会话时使用的数据库索引
+    int shardNumber; //每个数据库的分片数
+    std::vector<std::unique_ptr<KeySpace>> dataBases; //全部数据库
+    std::shared_mutex dataBasesMutex; //数据库表的读写锁，swapdb交换指针时独占持有
+    std::function<void()> flushCallback; //所有数据库都写入快照后的回调，在仍持有分片锁时调用
+    std::vector<AppendOnlyFile::Position> snapshotPositions; //启动时加载的每个快照包含到追加日志的哪个位置
+    AppendOnlyFile *appendOnlyFile = nullptr; //修改数据的命令写入的追加日志，为空时不记录
 public:
-    RedisHelper();
+    explicit RedisHelper(int shardNumber = DEFAULT_SHARD_NUMBER);
     ~RedisHelper();
 private:
+    size_t getShardIndex(std::string_view key) const; //key所在的分片下标
+    //当前数据库，调用方需持有数据库表的读锁
+    KeySpace &currentKeySpace() { return *dataBases[currentIndex()]; }
+    std::atomic<int> &currentIndex() { return sessionDataBaseIndex != nullptr ? *sessionDataBaseIndex : dataBaseIndex; }
+    Shard &getShard(const std::string &key) { return *currentKeySpace().shards[getShardIndex(key)]; }
+    void resetKeySpace(KeySpace &keySpace); //清空数据库，调用方需持有所有分片的写锁
+    std::vector<ReadLock> lockAllShards(); //按顺序加所有数据库所有分片的读锁，调用方需持有数据库表的读锁
+    //把keys按分片分组，返回每个分片中key在原数组里的下标
+    std::vector<std::vector<size_t>> groupByShard(TokenSpan keys, size_t step = 1) const;
+    static void putValue(DataBase &dataBase, const std::string &key, const RedisValue &value); //写入键值，调用方需持有分片写锁
+    //当前命令修改了数据，把它写入追加日志，调用方需持有修改的key所在分片的写锁（或独占数据库表）
+    void logCommand();
+    void logCommand(TokenSpan tokens); //写入tokens代替当前命令，多key命令用它只记录一个分片里修改的部分
+    static std::string dumpString(const RedisValue &value); //回复中的值，数值编码和字符串一样加引号
+    std::string push(const std::string &key, TokenSpan values, bool front); //lpush和rpush的实现
+    std::string pop(const std::string &key, bool front); //lpop和rpop的实现，列表空了之后删除key
+    //把负数下标换算为正数并截到列表范围内，范围为空时返回false
+    static bool normalizeRange(int64_t &start, int64_t &end, size_t size);
+    //按hkeys、hvals、hgetall的格式列出哈希表的字段名和（或）值
+    std::string listHash(const std::string &key, bool withFields, bool withValues);
     
-    //从文件中加载数据  持久性保存数据
-    void loadData(std::string loadPath);  
-    std::string getFilePath();
+    //从文件中加载数据  持久性保存数据，返回快照包含到追加日志的哪个位置
+    AppendOnlyFile::Position loadData(KeySpace &keySpace, std::string loadPath);
+    void loadTextData(KeySpace &keySpace, const std::string &loadPath); //加载旧版本的文本格式文件
+    //写入文件，logPosition记在快照头部，调用方需持有所有分片的锁
+    bool writeData(KeySpace &keySpace, const std::string &filePath, const AppendOnlyFile::Position &logPosition);
+    //把每个数据库写入对应的文件名加suffix，调用方需持有所有分片的锁
+    bool writeAllData(const std::string &suffix, const AppendOnlyFile::Position &logPosition);
+public:
+    //把所有数据库写入文件，logPosition是此时追加日志的末尾，调用方需保证没有已写入日志但还没执行完的命令
+    void flush(const AppendOnlyFile::Position &logPosition = AppendOnlyFile::Position());
+    //index号数据库启动时加载的快照包含到追加日志的哪个位置，重放日志时跳过这之前的记录
+    const AppendOnlyFile::Position &getSnapshotPosition(int index) const { return snapshotPositions[index]; }
+    //设置快照写入成功后的回调，追加日志用它在快照覆盖了全部数据时清空日志
+    void setFlushCallback(std::function<void()> callback) { flushCallback = std::move(callback); }
+    int getDataBaseIndex() { return currentIndex(); } //当前数据库索引
+    //设置修改数据的命令写入的追加日志，之后用LoggedCommand绑定的命令才会被记录
+    void setAppendOnlyFile(AppendOnlyFile *file) { appendOnlyFile = file; }
+
+    //在作用域内把当前线程执行的命令绑定到会话的数据库下标，析构时恢复之前的绑定
+    class SessionDataBase{
+    private:
+        std::atomic<int> *previous;
+    public:
+        explicit SessionDataBase(std::atomic<int> &index) : previous(sessionDataBaseIndex) { sessionDataBaseIndex = &index; }
+        ~SessionDataBase() { sessionDataBaseIndex = previous; }
+        SessionDataBase(const SessionDataBase &) = delete;
+        SessionDataBase &operator=(const SessionDataBase &) = delete;
+    };
+
+    //在作用域内把当前线程执行的命令绑定为要写入追加日志的命令，析构时恢复之前的绑定。
+    //没有绑定时（如启动时重放日志）命令不写入日志。
+    class LoggedCommand{
+    private:
+        friend class RedisHelper;
+        TokenSpan tokens;
+        LoggedCommand *previous;
+        uint64_t record = 0; //最后写入的日志记录编号，0表示没有写入
+    public:
+        explicit LoggedCommand(TokenSpan tokens) : tokens(tokens), previous(loggedCommand) { loggedCommand = this; }
+        ~LoggedCommand() { loggedCommand = previous; }
+        LoggedCommand(const LoggedCommand &) = delete;
+        LoggedCommand &operator=(const LoggedCommand &) = delete;
+        //命令最后写入的日志记录编号，释放分片锁后交给AppendOnlyFile::waitWritten等待刷盘
+        uint64_t getRecord() const { return record; }
+    };
+private:
+    static thread_local LoggedCommand *loggedCommand; //当前线程正在执行、修改数据后要写入追加日志的命令
 public:
-    void flush(); //写入文件 
+
+    //事务执行期间持有的锁。给出key时共享持有数据库表，按(数据库, 分片)顺序独占持有key所在的分片；
+    //不给key时独占持有数据库表，其他命令都要等事务结束。析构时释放。
+    class TransactionLocks{
+    private:
+        std::shared_lock<std::shared_mutex> tableReadLock;
+        std::unique_lock<std::shared_mutex> tableWriteLock;
+        std::vector<std::unique_lock<std::shared_mutex>> shardLocks;
+        size_t heldBefore; //加锁前heldLocks的大小
+    public:
+        TransactionLocks(RedisHelper &helper, const std::vector<std::pair<int, std::string>> &keys);
+        explicit TransactionLocks(RedisHelper &helper);
+        ~TransactionLocks();
+        TransactionLocks(const TransactionLocks &) = delete;
+        TransactionLocks &operator=(const TransactionLocks &) = delete;
+    };
+    std::string getFilePath(int index); //数据库的快照文件路径
+    //持有所有分片的读锁fork子进程，子进程中执行childMain，返回子进程pid；cowFd见ChildProcess::start
+    pid_t forkChild(const std::function<int(RedisHelper &)> &childMain, int *cowFd = nullptr);
+    //把所有数据库写入快照文件名加suffix的文件，不加锁，只在forkChild的子进程中调用
+    bool saveSnapshot(const std::string &suffix, const AppendOnlyFile::Position &logPosition) { return writeAllData(suffix, logPosition); }
+    bool replaceSnapshot(const std::string &suffix); //用saveSnapshot写好的文件替换快照
+    void discardSnapshot(const std::string &suffix); //删除saveSnapshot写出的文件
+    //生成重建所有数据库的命令，以0号数据库结束，不加锁，只在forkChild的子进程中调用
+    void rewriteCommands(const std::function<void(const std::vector<std::string> &)> &emit);
     //选择数据库
     std::string select(int index);
 
+    // 交换两个数据库
+    std::string swapdb(int index1, int index2);
+
+    // 把当前数据库的key移动到另一个数据库
+    std::string move(const std::string &key, int index);
+
     // key操作命令
     std::string keys(const std::string pattern="*");
 
     // 获取键总数
-    std::string dbsize()const;
+    std::string dbsize();
+
+    // 清空当前数据库
+    std::string flushdb();
 
     // 查询键是否存在
-    std::string exists(const std::vector<std::string>&keys);
+    std::string exists(TokenSpan keys);
     
     // 删除键
-    std::string del(const std::vector<std::string>&keys);
+    std::string del(TokenSpan keys);
 
     // 更改键名称
     std::string rename(const std::string&oldName,const std::string&newName);
@@ -56,20 +240,20 @@ public:
     // 值递增/递减
     std::string incr(const std::string& key);
 
-    std::string incrby(const std::string& key,int increment);
+    std::string incrby(const std::string& key,int64_t increment);
 
     std::string incrbyfloat(const std::string&key,double increment);
 
     // 同样，递减使用decr、decrby命令。
     std::string decr(const std::string&key);
 
-    std::string decrby(const std::string&key,int increment);
+    std::string decrby(const std::string&key,int64_t increment);
 
     // 批量存放键值
-    std::string mset(std::vector<std::string>&items);
+    std::string mset(TokenSpan items);
 
     // 获取获取键值
-    std::string mget(std::vector<std::string>&keys);
+    std::string mget(TokenSpan keys);
 
     // 获取值长度
     std::string strlen(const std::string& key);
@@ -77,12 +261,16 @@ public:
     // 追加内容
     std::string append(const std::string&key,const std::string &value);
     
-    //列表操作
-    std::string lpush(const std::string&key,const std::string &value);
-    std::string rpush(const std::string&key,const std::string &value);
+    //列表操作，下标为负数时从末尾倒数，-1表示最后一个元素
+    std::string lpush(const std::string&key,TokenSpan values);
+    std::string rpush(const std::string&key,TokenSpan values);
     std::string lpop(const std::string&key);
     std::string rpop(const std::string&key);
-    std::string lrange(const std::string&key,const std::string &start,const std::string&end);
+    std::string lrange(const std::string&key,int64_t start,int64_t end);
+    std::string lindex(const std::string&key,int64_t index);
+    std::string lset(const std::string&key,int64_t index,const std::string&value);
+    std::string ltrim(const std::string&key,int64_t start,int64_t end);
+    std::string llen(const std::string&key);
 
     //哈希表操作
     // HSET key field value：向哈希表中添加一个字段及其值。
@@ -90,11 +278,17 @@ public:
     // HDEL key field：删除哈希表 key 中的一个或多个指定字段。
     // HKEYS key：获取哈希表中的所有字段名。
     // HVALS key：获取哈希表中的所有值。
-    std::string hset(const std::string&key,const std::vector<std::string>&filed);
+    // HMGET key field [field ...]：获取哈希表中多个字段的值。
+    // HGETALL key：获取哈希表中的所有字段名和值。
+    // HINCRBY key field increment：把哈希表中字段的整数值加上增量。
+    std::string hset(const std::string&key,TokenSpan filed);
     std::string hget(const std::string&key,const std::string&filed);
-    std::string hdel(const std::string&key,const std::vector<std::string>&filed);
+    std::string hdel(const std::string&key,TokenSpan filed);
     std::string hkeys(const std::string&key);
     std::string hvals(const std::string&key);
+    std::string hmget(const std::string&key,TokenSpan fields);
+    std::string hgetall(const std::string&key);
+    std::string hincrby(const std::string&key,const std::string&field,int64_t increment);
 };
 
 #endif
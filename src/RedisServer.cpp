@@ -1,11 +1,86 @@
 #include "RedisServer.h"
 
+thread_local RedisServer::Session *RedisServer::currentSession = nullptr;
+std::atomic<bool> RedisServer::shutdownRequested{false};
+
 RedisServer *RedisServer::getInstance()
 {
     static RedisServer redis;
     return &redis;
 }
 
+RedisServer::SessionScope::SessionScope(Session &session) : previous(currentSession), dataBase(session.dataBaseIndex)
+{
+    currentSession = &session;
+}
+
+RedisServer::SessionScope::~SessionScope()
+{
+    currentSession = previous;
+}
+
+static int64_t steadySeconds()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * 取得RPC客户端的会话，第一次使用时创建。
+ *
+ * @param id 客户端生成的会话编号。
+ * @return 返回会话，调用方持有期间不会被回收。
+ */
+std::shared_ptr<RedisServer::Session> RedisServer::getSession(uint64_t id)
+{
+    std::shared_ptr<Session> found;
+    {
+        std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+        auto itr = sessions.find(id);
+        if (itr != sessions.end())
+        {
+            found = itr->second;
+        }
+    }
+    if (found == nullptr)
+    {
+        std::unique_lock<std::shared_mutex> lock(sessionsMutex);
+        std::shared_ptr<Session> &slot = sessions[id];
+        if (slot == nullptr)
+        {
+            slot = std::make_shared<Session>();
+        }
+        found = slot;
+    }
+    found->lastActive = steadySeconds();
+    return found;
+}
+
+void RedisServer::releaseSession(uint64_t id)
+{
+    std::unique_lock<std::shared_mutex> lock(sessionsMutex);
+    sessions.erase(id);
+}
+
+/**
+ * 回收空闲超过SESSION_IDLE_TIMEOUT秒且没有请求正在使用的会话，客户端异常退出时会话不会一直保留。
+ */
+void RedisServer::expireSessions()
+{
+    int64_t now = steadySeconds();
+    std::unique_lock<std::shared_mutex> lock(sessionsMutex);
+    for (auto itr = sessions.begin(); itr != sessions.end();)
+    {
+        if (itr->second.use_count() == 1 && now - itr->second->lastActive > SESSION_IDLE_TIMEOUT)
+        {
+            itr = sessions.erase(itr);
+        }
+        else
+        {
+            ++itr;
+        }
+    }
+}
+
 /**
  * 从指定的logo文件路径中读取内容，并打印到控制台。在读取过程中，会将文件中的"PORT"和"PTHREAD_ID"替换为实际的端口号和线程ID。
  *
@@ -83,48 +158,84 @@ void RedisServer::start()
 }
 
 /**
- * 执行Redis服务器的事务操作。
+ * 找出事务中的命令访问的key。命令的key位置见分发表中的ParserEntry::keys。
  *
- * @param commandsQueue 存储待执行命令的队列。
- * @return 返回所有命令执行的结果，每个结果之间用换行符分隔。如果遇到"quit"或"exit"命令，则立即停止执行并返回"stop"。如果遇到"multi"命令，则打开事务，并提示"Open the transaction repeatedly!"。如果遇到"exec"命令而没有打开事务，则提示"No transaction is opened!"。对于其他命令，使用对应的解析器进行解析，并将解析结果添加到结果列表中。最后，将所有结果按顺序连接成一个字符串并返回。
+ * @param commandsQueue 事务中的命令。
+ * @param dataBaseIndex 事务开始执行时的数据库下标。
+ * @param keys 输出(数据库下标, key)。
+ * @return 有命令无法确定访问的key（如select、keys、flushdb）或命令不存在时返回false。
  */
-string RedisServer::executeTransaction(std::queue<std::string> &commandsQueue)
+bool RedisServer::collectKeys(const std::deque<std::vector<std::string>> &commandsQueue, int dataBaseIndex, std::vector<std::pair<int, std::string>> &keys) const
 {
+    for (const std::vector<std::string> &tokens : commandsQueue)
+    {
+        const ParserEntry *commandParser = flyweightFactory->getParser(tokens.front());
+        if (commandParser == nullptr || commandParser->keys.first == 0)
+        {
+            return false;
+        }
+        const KeySpec &spec = commandParser->keys;
+        int count = static_cast<int>(tokens.size());
+        int last = spec.last < 0 ? count + spec.last : std::min(spec.last, count - 1);
+        for (int i = spec.first; i <= last; i += spec.step)
+        {
+            keys.emplace_back(dataBaseIndex, tokens[i]);
+        }
+    }
+    return true;
+}
+
+/**
+ * 执行Redis服务器的事务操作。事务中的命令相对其他客户端的命令是原子的：
+ * 能确定访问哪些key时只锁住这些key所在的分片，其他分片上的命令照常执行；
+ * 否则独占持有persistenceMutex和数据库表，事务执行完之前其他命令都要等待。
+ *
+ * @param commandsQueue 存储待执行命令的队列，每条命令已分割为参数。
+ * @return 返回每条命令的执行结果。如果遇到"quit"或"exit"命令，则立即停止执行并只返回"stop"。如果遇到"multi"命令，则提示"Open the transaction repeatedly!"。如果遇到"exec"命令，则提示"No transaction is opened!"。对于其他命令，使用对应的解析器进行解析，并将解析结果添加到结果列表中。
+ */
+std::vector<std::string> RedisServer::executeTransaction(std::deque<std::vector<std::string>> &commandsQueue)
+{
+    RedisHelper *redisHelper = CommandParser::getRedisHelper().get();
+    std::vector<std::pair<int, std::string>> keys;
+    std::shared_lock<std::shared_mutex> sharedLock;
+    std::unique_lock<std::shared_mutex> exclusiveLock;
+    std::unique_ptr<RedisHelper::TransactionLocks> transactionLocks;
+    if (collectKeys(commandsQueue, redisHelper->getDataBaseIndex(), keys))
+    {
+        sharedLock = std::shared_lock<std::shared_mutex>(persistenceMutex);
+        transactionLocks.reset(new RedisHelper::TransactionLocks(*redisHelper, keys));
+    }
+    else
+    {
+        exclusiveLock = std::unique_lock<std::shared_mutex>(persistenceMutex);
+        transactionLocks.reset(new RedisHelper::TransactionLocks(*redisHelper));
+    }
     // 存储所有的执行结果
     std::vector<std::string> responseMessagesList;
+    TokenBuffer views;
     while (!commandsQueue.empty())
     {
-        std::string receivedData = std::move(commandsQueue.front());
-        commandsQueue.pop();
-        std::istringstream iss(receivedData);
-        std::string command;
-        std::vector<std::string> tokens;
-        std::string responseMessage;
-
-        while (iss >> command)
-        {
-            tokens.push_back(command);
-        }
-        command = tokens.front();
+        std::vector<std::string> tokens = std::move(commandsQueue.front());
+        commandsQueue.pop_front();
         if (!tokens.empty())
         {
-            command = tokens.front();
+            viewTokens(tokens, views);
+            const std::string &command = tokens.front();
             std::string responseMessage;
             if (command == "quit" || command == "exit")
             {
-                responseMessage = "stop";
-                return responseMessage;
+                return {"stop"};
             }
             else if (command == "multi")
             {
-                responseMessage = "Open the transaction repeatedly!";
+                responseMessage = errorReply("Open the transaction repeatedly!");
                 responseMessagesList.emplace_back(responseMessage);
                 continue;
             }
             else if (command == "exec")
             {
                 // 处理未打开事物就执行的操作
-                responseMessage = "No transaction is opened!";
+                responseMessage = errorReply("No transaction is opened!");
                 responseMessagesList.emplace_back(responseMessage);
                 continue;
             }
@@ -132,177 +243,663 @@ string RedisServer::executeTransaction(std::queue<std::string> &commandsQueue)
             {
                 // 处理常规指令
 
-                std::shared_ptr<CommandParser> commandParser = flyweightFactory->getParser(command); // 获取解析器
+                const ParserEntry *commandParser = flyweightFactory->getParser(command); // 获取解析器
 
                 try
                 {
-                    responseMessage = commandParser->parse(tokens);
+                    // 已经持有所需的锁，不能再由executeCommand加锁
+                    responseMessage = applyCommand(commandParser, views);
                 }
                 catch (const std::exception &e)
                 {
-                    responseMessage = "Error processing command '" + command + "': " + e.what();
+                    responseMessage = errorReply("Error processing command '" + std::string(command) + "': " + e.what());
                 }
                 responseMessagesList.emplace_back(responseMessage);
             }
         }
     }
-    string res = "";
-    for (int i = 0; i < responseMessagesList.size(); i++)
+    return responseMessagesList;
+}
+
+/**
+ * 处理客户端发送的数据，按空白分割后交给handleCommand执行。
+ * 参数是指向receivedData的视图，放在栈上的TokenBuffer中，参数不多时分割命令不分配内存。
+ *
+ * @param receivedData 客户端发送的字符串数据，指向RPC收到的消息，不拷贝。
+ * @return 返回处理结果的字符串消息。如果接收到的数据长度大于0，则返回对应的处理结果；否则返回"nil"表示没有数据可读；如果没有任何参数，则返回错误回复。
+ */
+string RedisServer::handleClient(std::string_view receivedData)
+{
+    // 如果接收到的数据长度为0，则返回"nil"
+    if (receivedData.empty())
     {
-        std::string responseMessage = std::to_string(i + 1) + ")" + responseMessagesList[i];
-        res += responseMessage;
-        if (i != responseMessagesList.size() - 1)
-        {
-            res += "\n";
-        }
+        return "nil";
     }
-
-    return res;
+    // 直接在收到的数据上按空白分割，不先拷贝整条命令
+    TokenBuffer tokens;
+    splitTokens(receivedData, tokens);
+    if (tokens.empty())
+    {
+        return errorReply("empty command");
+    }
+    std::string commandName;
+    lowerCommandName(tokens, commandName);
+    return handleCommand(tokens);
 }
 
 /**
- * 处理客户端发送的数据，根据数据内容执行相应的操作。
+ * 执行一条已分割为参数的命令，根据命令内容执行相应的操作。
  *
- * @param receivedData 客户端发送的字符串数据。
- * @return 返回处理结果的字符串消息。如果接收到的数据长度大于0，则返回对应的处理结果；否则返回"nil"表示没有数据可读；如果发生错误，则返回"error"。
+ * @param tokens 命令及其参数，不能为空，命令名需为小写（见lowerCommandName）。事务中的命令会拷贝后放入队列，其余命令直接使用参数指向的数据。
+ * @param transactionReplies 不为空时，exec的每条命令的结果分别写入其中，返回值为空字符串；为空时结果按"序号)结果"逐行拼接后返回。
+ * @return 返回处理结果的字符串消息。
  */
-string RedisServer::handleClient(string receivedData)
-{
-    // 获取接收到的数据的长度
-    size_t bytesRead = receivedData.length();
-    // 如果数据长度大于0，则处理数据
-    if (bytesRead > 0)
-    {
-        // 使用istringstream将接收到的字符串分割为多个命令
-        std::istringstream iss(receivedData);
-        std::string command;
-        std::vector<std::string> tokens;
-        while (iss >> command)
-        { // 以空格分割字符串
-            tokens.push_back(command);
+string RedisServer::handleCommand(TokenSpan tokens, std::vector<std::string> *transactionReplies)
+{
+    // 整个命令处理期间持有纪元，保证读到的跳表节点不会被回收
+    EpochGuard epochGuard;
+    // 获取第一个命令
+    std::string_view command = tokens.front();
+    std::string responseMessage;
+    Session &session = this->session();
+    // 如果命令是"quit"或"exit"，则返回"stop"并结束方法
+    if (command == "quit" || command == "exit")
+    {
+        responseMessage = "stop";
+        return responseMessage;
+    }
+    // 如果命令是"multi"，则开始一个新的事务
+    else if (command == "multi")
+    {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        // 如果已经开始了事务，则返回错误信息
+        if (session.startMulti)
+        {
+            responseMessage = errorReply("Open the transaction repeatedly!");
+            return responseMessage;
         }
-
-        // 如果命令列表不为空
-        if (!tokens.empty())
+        // 否则，开始新的事务
+        session.startMulti = true;
+        // 清空命令队列
+        std::deque<std::vector<std::string>> empty;
+        std::swap(empty, session.commandsQueue);
+        responseMessage = "OK";
+        return responseMessage;
+    }
+    // 如果命令是"exec"，则执行事务
+    else if (command == "exec")
+    {
+        std::unique_lock<std::mutex> lock(session.mutex);
+        // 如果没有开始事务，则返回错误信息
+        if (session.startMulti == false)
         {
-            // 获取第一个命令
-            command = tokens.front();
-            std::string responseMessage;
-            // 如果命令是"quit"或"exit"，则返回"stop"并结束方法
-            if (command == "quit" || command == "exit")
+            responseMessage = errorReply("No transaction is opened!");
+            return responseMessage;
+        }
+        // 否则，结束事务
+        session.startMulti = false;
+        // 如果没有回退，则取出队列后执行事务，执行期间不占用会话的锁
+        if (!session.fallback)
+        {
+            std::deque<std::vector<std::string>> queuedCommands;
+            std::swap(queuedCommands, session.commandsQueue);
+            lock.unlock();
+            std::vector<std::string> responseMessagesList = executeTransaction(queuedCommands);
+            if (transactionReplies != nullptr)
             {
-                responseMessage = "stop";
+                *transactionReplies = std::move(responseMessagesList);
                 return responseMessage;
             }
-            // 如果命令是"multi"，则开始一个新的事务
-            else if (command == "multi")
+            for (size_t i = 0; i < responseMessagesList.size(); i++)
+            {
+                responseMessage += std::to_string(i + 1) + ")" + responseMessagesList[i];
+                if (i != responseMessagesList.size() - 1)
+                {
+                    responseMessage += "\n";
+                }
+            }
+            return responseMessage;
+        }
+        else
+        {
+            // 如果有回退，则丢弃事务并返回错误信息
+            session.fallback = false;
+            responseMessage = errorReply("Transaction discarded because of previous errors.", "EXECABORT");
+            return responseMessage;
+        }
+    }
+    // 如果命令是"bgrewriteaof"，则在后台重写追加日志
+    else if (command == "bgrewriteaof")
+    {
+        std::unique_lock<std::shared_mutex> lock(persistenceMutex);
+        responseMessage = startRewrite();
+        return responseMessage;
+    }
+    // 如果命令是"bgsave"，则在后台保存快照
+    else if (command == "bgsave")
+    {
+        std::unique_lock<std::shared_mutex> lock(persistenceMutex);
+        responseMessage = startBackgroundSave();
+        return responseMessage;
+    }
+    // 如果命令是"ping"，则返回PONG，带参数时原样返回参数
+    else if (command == "ping")
+    {
+        responseMessage = tokens.size() > 1 ? std::string(tokens[1]) : "PONG";
+        return responseMessage;
+    }
+    // 如果命令是"lastsave"，则返回最近一次成功保存快照的时间
+    else if (command == "lastsave")
+    {
+        std::shared_lock<std::shared_mutex> lock(persistenceMutex);
+        responseMessage = "(integer) " + std::to_string(lastSaveTime);
+        return responseMessage;
+    }
+    // 如果命令是"info"，则返回持久化状态
+    else if (command == "info")
+    {
+        std::shared_lock<std::shared_mutex> lock(persistenceMutex);
+        responseMessage = info();
+        return responseMessage;
+    }
+    // 如果命令是"discard"，则丢弃事务
+    else if (command == "discard")
+    {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        session.startMulti = false;
+        session.fallback = false;
+        responseMessage = "OK";
+        return responseMessage;
+    }
+    // 如果命令是常规指令
+    else
+    {
+        // 如果已经开始事务，则将命令添加到事务队列中（先无锁检查，大多数命令不需要加事务锁）
+        if (session.startMulti)
+        {
+            std::lock_guard<std::mutex> lock(session.mutex);
+            if (session.startMulti)
             {
-                // 如果已经开始了事务，则返回错误信息
-                if (startMulti)
+                // 获取对应的命令解析器
+                const ParserEntry *commandParser = flyweightFactory->getParser(command);
+                // 如果命令解析器不存在，则设置回退标志并返回错误信息
+                if (commandParser == nullptr)
                 {
-                    responseMessage = "Open the transaction repeatedly!";
+                    session.fallback = true;
+                    responseMessage = errorReply("Command \'" + std::string(command) + "\' not recognized.");
                     return responseMessage;
                 }
-                // 否则，开始新的事务
-                startMulti = true;
-                // 清空命令队列
-                std::queue<std::string> empty;
-                std::swap(empty, commandsQueue);
-                responseMessage = "OK";
+                // 将命令添加到队列中并返回"QUEUED"信息
+                session.commandsQueue.emplace_back(tokens.begin(), tokens.end());
+                responseMessage = "QUEUED";
                 return responseMessage;
             }
-            // 如果命令是"exec"，则执行事务
-            else if (command == "exec")
+        }
+        // 如果没有开始事务，则处理常规指令
+        // 获取对应的命令解析器
+        const ParserEntry *commandParser = flyweightFactory->getParser(command);
+        // 如果命令解析器不存在，则返回错误信息
+        if (commandParser == nullptr)
+        {
+            responseMessage = errorReply("Command \'" + std::string(command) + "\' not recognized.");
+        }
+        else
+        {
+            try
+            {
+                // 尝试解析命令并获取响应消息
+                responseMessage = executeCommand(commandParser, tokens);
+            }
+            catch (const std::exception &e)
+            {
+                // 如果解析过程中出现异常，则返回错误信息
+                responseMessage = errorReply("Error processing command '" + std::string(command) + "': " + e.what());
+            }
+        }
+        // 返回响应消息
+        return responseMessage;
+    }
+}
+
+/**
+ * 按空白字符分割命令，结果和用istringstream逐个读取相同。
+ *
+ * @param data 要分割的命令。
+ * @param tokens 输出分割后的参数，指向data中的字节，不拷贝。
+ */
+void RedisServer::splitTokens(std::string_view data, TokenBuffer &tokens)
+{
+    size_t position = 0;
+    while (position < data.size())
+    {
+        while (position < data.size() && std::isspace(static_cast<unsigned char>(data[position])))
+        {
+            position++;
+        }
+        size_t start = position;
+        while (position < data.size() && !std::isspace(static_cast<unsigned char>(data[position])))
+        {
+            position++;
+        }
+        if (position > start)
+        {
+            tokens.push_back(data.substr(start, position - start));
+        }
+    }
+}
+
+/**
+ * 命令名不区分大小写：含大写字母时把小写的命令名存入storage，tokens[0]改为指向它。
+ * 之后事务、持久化等命令只需按小写比较，追加日志和事务队列中也只出现小写的命令名。
+ *
+ * @param tokens 命令及其参数，不能为空。
+ * @param storage 存放小写命令名，需要和tokens一样在命令执行期间有效。
+ */
+void RedisServer::lowerCommandName(TokenBuffer &tokens, std::string &storage)
+{
+    std::string_view name = tokens.front();
+    if (std::none_of(name.begin(), name.end(), [](char c)
+                     { return c >= 'A' && c <= 'Z'; }))
+    {
+        return;
+    }
+    storage.assign(name);
+    for (char &c : storage)
+    {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    tokens[0] = storage;
+}
+
+/**
+ * 执行一条命令。修改数据的命令执行期间共享持有persistenceMutex，
+ * 保证清空日志时不会有命令已修改数据但还没写入日志（或反过来）。
+ *
+ * @param commandParser 命令对应的解析器。
+ * @param tokens 命令及其参数。
+ * @return 返回命令的执行结果。
+ */
+string RedisServer::executeCommand(const ParserEntry *commandParser, TokenSpan tokens)
+{
+    if (appendOnlyFile && commandParser->write)
+    {
+        std::shared_lock<std::shared_mutex> lock(persistenceMutex);
+        return applyCommand(commandParser, tokens);
+    }
+    return commandParser->parse(tokens);
+}
+
+/**
+ * 执行一条命令。写命令修改数据后由RedisHelper在仍持有分片写锁时写入追加日志，
+ * 同一个key上的记录顺序和执行顺序一致，失败或没有修改数据的命令不写入；
+ * 释放分片锁后再等待记录刷盘，always策略下也不会在持锁期间等待fsync。
+ * 调用方需共享持有persistenceMutex。
+ *
+ * @param commandParser 命令对应的解析器。
+ * @param tokens 命令及其参数。
+ * @return 返回命令的执行结果。
+ */
+string RedisServer::applyCommand(const ParserEntry *commandParser, TokenSpan tokens)
+{
+    if (!appendOnlyFile || !commandParser->write)
+    {
+        return commandParser->parse(tokens);
+    }
+    RedisHelper::LoggedCommand loggedCommand(tokens);
+    std::string result = commandParser->parse(tokens);
+    appendOnlyFile->waitWritten(loggedCommand.getRecord());
+    return result;
+}
+
+/**
+ * 判断命令是否需要由handleCommand单独处理：事务、持久化等命令会修改服务器状态或独占持有persistenceMutex。
+ */
+bool RedisServer::isServerCommand(std::string_view command)
+{
+    return command == "quit" || command == "exit" || command == "multi" || command == "exec" ||
+           command == "discard" || command == "bgrewriteaof" || command == "bgsave" ||
+           command == "lastsave" || command == "info" || command == "ping";
+}
+
+/**
+ * 一次执行多条命令，结果按顺序返回。连续的普通命令在一次共享持有persistenceMutex期间依次执行，
+ * 复用同一个参数数组，不为每条命令重复加锁；遇到事务、持久化等命令或事务已开启时，
+ * 先释放锁，再交给handleCommand处理这一条。持锁期间后台保存和重写需要等待整批普通命令执行完。
+ *
+ * @param commands 要执行的命令。
+ * @return 返回每条命令的执行结果，和commands一一对应。
+ */
+std::vector<std::string> RedisServer::handleBatch(std::vector<std::string> commands)
+{
+    EpochGuard epochGuard;
+    Session &session = this->session();
+    std::vector<std::string> responses;
+    responses.reserve(commands.size());
+    TokenBuffer tokens;
+    std::string commandName;
+    size_t index = 0;
+    while (index < commands.size())
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(persistenceMutex);
+            for (; index < commands.size(); index++)
             {
-                // 如果没有开始事务，则返回错误信息
-                if (startMulti == false)
+                tokens.clear();
+                splitTokens(commands[index], tokens);
+                if (!tokens.empty())
                 {
-                    responseMessage = "No transaction is opened!";
-                    return responseMessage;
+                    lowerCommandName(tokens, commandName);
                 }
-                // 否则，结束事务
-                startMulti = false;
-                // 如果没有回退，则执行事务
-                if (!fallback)
+                if (tokens.empty() || session.startMulti || isServerCommand(tokens.front()))
                 {
-                    responseMessage = executeTransaction(commandsQueue);
-                    return responseMessage;
+                    break;
                 }
-                else
+                std::string_view command = tokens.front();
+                const ParserEntry *commandParser = flyweightFactory->getParser(command);
+                if (commandParser == nullptr)
                 {
-                    // 如果有回退，则丢弃事务并返回错误信息
-                    fallback = false;
-                    responseMessage = "(error) EXECABORT Transaction discarded because of previous errors.";
-                    return responseMessage;
+                    responses.emplace_back(errorReply("Command \'" + std::string(command) + "\' not recognized."));
+                    continue;
                 }
-            }
-            // 如果命令是"discard"，则丢弃事务
-            else if (command == "discard")
-            {
-                startMulti = false;
-                fallback = false;
-                responseMessage = "OK";
-                return responseMessage;
-            }
-            // 如果命令是常规指令
-            else
-            {
-                // 如果没有开始事务，则处理常规指令
-                if (!startMulti)
+                try
                 {
-                    // 获取对应的命令解析器
-                    std::shared_ptr<CommandParser> commandParser = flyweightFactory->getParser(command);
-                    // 如果命令解析器不存在，则返回错误信息
-                    if (commandParser == nullptr)
-                    {
-                        responseMessage = "Error: Command '" + command + "' not recognized.";
-                    }
-                    else
-                    {
-                        try
-                        {
-                            // 尝试解析命令并获取响应消息
-                            responseMessage = commandParser->parse(tokens);
-                        }
-                        catch (const std::exception &e)
-                        {
-                            // 如果解析过程中出现异常，则返回错误信息
-                            responseMessage = "Error processing command '" + command + "': " + e.what();
-                        }
-                    }
-                    // 返回响应消息
-                    return responseMessage;
+                    responses.emplace_back(applyCommand(commandParser, tokens));
                 }
-                // 如果已经开始事务，则将命令添加到事务队列中
-                else
+                catch (const std::exception &e)
                 {
-                    // 获取对应的命令解析器
-                    std::shared_ptr<CommandParser> commandParser = flyweightFactory->getParser(command);
-                    // 如果命令解析器不存在，则设置回退标志并返回错误信息
-                    if (commandParser == nullptr)
-                    {
-                        fallback = true;
-                        responseMessage = "Error: Command '" + command + "' not recognized.";
-                        return responseMessage;
-                    }
-                    else
-                    {
-                        // 将命令添加到队列中并返回"QUEUED"信息
-                        commandsQueue.emplace(receivedData);
-                        responseMessage = "QUEUED";
-                        return responseMessage;
-                    }
+                    responses.emplace_back(errorReply("Error processing command '" + std::string(command) + "': " + e.what()));
                 }
             }
         }
+        if (index < commands.size())
+        {
+            responses.emplace_back(tokens.empty() ? handleClient(commands[index]) : handleCommand(tokens));
+            index++;
+        }
     }
-    // 如果接收到的数据长度为0，则返回"nil"并继续循环
-    else
+    return responses;
+}
+
+/**
+ * 启动时重放追加日志，然后打开日志文件继续追加。
+ * 每个数据库的快照记着它包含到日志的哪个位置，重放时跳过快照已经包含的记录，
+ * 所以写快照和清空日志之间崩溃、或者后台保存只替换了部分快照时，命令不会被执行两次。
+ * 重放结束后切回0号数据库，把所有数据库写入快照，快照已包含日志中的命令，清空日志。
+ */
+void RedisServer::loadAppendOnlyFile()
+{
+    std::string filePath = getAppendOnlyFilePath();
+    std::shared_ptr<RedisHelper> redisHelper = CommandParser::getRedisHelper();
+    // 位置上的记录是否已经包含在index号数据库的快照中
+    auto covered = [&redisHelper](int index, const AppendOnlyFile::Position &position)
     {
-        return "nil";
+        if (index < 0 || index >= DATABASE_FILE_NUMBER)
+        {
+            return false;
+        }
+        const AppendOnlyFile::Position &snapshot = redisHelper->getSnapshotPosition(index);
+        return position.generation != 0 && snapshot.generation == position.generation && position.offset < snapshot.offset;
+    };
+    int skipped = 0;
+    int count = AppendOnlyFile::replay(filePath, [this, &covered, &skipped](TokenSpan tokens, const AppendOnlyFile::Position &position)
+                                       {
+        const ParserEntry *commandParser = flyweightFactory->getParser(tokens[0]);
+        if (commandParser == nullptr)
+        {
+            return;
+        }
+        // select记录只切换数据库，总是执行；swapdb和move还会修改参数中的数据库，这些数据库的快照都包含时才跳过
+        if (commandParser->name != "select")
+        {
+            bool skip = covered(position.dataBaseIndex, position);
+            if (commandParser->name == "swapdb" && tokens.size() == 3)
+            {
+                skip = skip && covered(std::atoi(std::string(tokens[1]).c_str()), position) &&
+                       covered(std::atoi(std::string(tokens[2]).c_str()), position);
+            }
+            else if (commandParser->name == "move" && tokens.size() == 3)
+            {
+                skip = skip && covered(std::atoi(std::string(tokens[2]).c_str()), position);
+            }
+            if (skip)
+            {
+                skipped++;
+                return;
+            }
+        }
+        try
+        {
+            commandParser->parse(tokens);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "Error replaying command '" << tokens[0] << "': " << e.what() << std::endl;
+        } });
+    appendOnlyFile.reset(new AppendOnlyFile(filePath));
+    redisHelper->setAppendOnlyFile(appendOnlyFile.get());
+    if (skipped > 0)
+    {
+        std::cout << "[" << pid << "] " << getDate() << " * Skipped " << skipped << " commands already in the snapshot" << std::endl;
+    }
+    // 快照覆盖了全部数据后清空日志，进行中的重写和后台保存也随之作废
+    redisHelper->setFlushCallback([this]()
+                                  {
+        appendOnlyFile->truncate();
+        cancelRewrite();
+        cancelBackgroundSave();
+        lastSaveTime = std::time(nullptr); });
+    // 没有代数记录的旧日志也写一次快照，清空后换成带代数记录的日志
+    AppendOnlyFile::Position logPosition = appendOnlyFile->position();
+    if (count > 0 || logPosition.generation == 0)
+    {
+        std::cout << "[" << pid << "] " << getDate() << " * Replayed " << count - skipped << " commands from append only file" << std::endl;
+        redisHelper->select(0);
+        redisHelper->flush(logPosition);
+    }
+}
+
+std::string RedisServer::getAppendOnlyFilePath()
+{
+    return std::string(DEFAULT_DB_FOLDER) + "/" + DEFAULT_AOF_FILE_NAME;
+}
+
+/**
+ * 开始后台重写追加日志。fork时没有执行中的写命令，子进程把所有数据库写成重建命令，
+ * 之后到达的命令由AppendOnlyFile缓冲，子进程结束后在serverCron中完成替换。
+ *
+ * @return 返回给客户端的状态信息。
+ */
+std::string RedisServer::startRewrite()
+{
+    if (rewritePid > 0)
+    {
+        return "Background append only file rewriting already in progress";
+    }
+    std::shared_ptr<RedisHelper> redisHelper = CommandParser::getRedisHelper();
+    std::string imagePath = getAppendOnlyFilePath() + ".rewrite";
+    uint64_t generation = appendOnlyFile->startRewrite(0); // 重建命令以0号数据库结束
+    rewritePid = redisHelper->forkChild([imagePath, generation](RedisHelper &helper)
+                                        {
+        bool success = AppendOnlyFile::writeImage(imagePath, generation, [&helper](const AppendOnlyFile::CommandSink &sink)
+                                                  { helper.rewriteCommands(sink); });
+        return success ? 0 : 1; });
+    if (rewritePid < 0)
+    {
+        appendOnlyFile->abortRewrite();
+        return errorReply("Background append only file rewriting failed to start");
+    }
+    std::cout << "[" << pid << "] " << getDate() << " * Background append only file rewriting started by pid " << rewritePid << std::endl;
+    return "Background append only file rewriting started";
+}
+
+void RedisServer::cancelRewrite()
+{
+    if (rewritePid <= 0)
+    {
+        return;
+    }
+    ChildProcess::terminate(rewritePid);
+    rewritePid = -1;
+    appendOnlyFile->abortRewrite();
+    std::remove((getAppendOnlyFilePath() + ".rewrite").c_str());
+}
+
+/**
+ * 开始后台保存快照。fork时没有执行中的写命令，记下此时追加日志的位置，
+ * 子进程从写时复制的内存中把所有数据库写入带BGSAVE_FILE_SUFFIX后缀的文件，位置记在快照头部，父进程继续处理命令。
+ *
+ * @return 返回给客户端的状态信息。
+ */
+std::string RedisServer::startBackgroundSave()
+{
+    if (savePid > 0)
+    {
+        return "Background save already in progress";
+    }
+    std::shared_ptr<RedisHelper> redisHelper = CommandParser::getRedisHelper();
+    int cowFd = -1;
+    AppendOnlyFile::Position logPosition = appendOnlyFile->position();
+    pid_t child = redisHelper->forkChild([logPosition](RedisHelper &helper)
+                                         { return helper.saveSnapshot(BGSAVE_FILE_SUFFIX, logPosition) ? 0 : 1; },
+                                         &cowFd);
+    if (child < 0)
+    {
+        return errorReply("Background save failed to start");
+    }
+    saveCowFd = cowFd;
+    saveStartTime = std::chrono::steady_clock::now();
+    savePid = child;
+    std::cout << "[" << pid << "] " << getDate() << " * Background saving started by pid " << child << std::endl;
+    return "Background saving started";
+}
+
+/**
+ * 后台保存的子进程结束后调用：成功时用子进程写好的文件替换快照，同时记录保存的状态、耗时和子进程报告的写时复制大小。
+ * 日志不在这里裁剪：快照头部记着fork时的日志位置，重放时跳过之前的记录，这里不需要在持有锁时复制日志。
+ * 替换到一半失败时，已替换的快照记着新的位置，未替换的保留旧的位置，和日志组合后结果仍然正确。
+ * 期间如果有其他操作写入过快照，后台保存已在回调中被取消，不会走到这里。
+ *
+ * @param exitCode 子进程的退出码。
+ */
+void RedisServer::finishBackgroundSave(int exitCode)
+{
+    savePid = -1;
+    long cowSize = ChildProcess::readCowSize(saveCowFd);
+    saveCowFd = -1;
+    auto duration = std::chrono::steady_clock::now() - saveStartTime;
+    lastBgsaveDuration = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    lastBgsaveCowSize = cowSize;
+    std::shared_ptr<RedisHelper> redisHelper = CommandParser::getRedisHelper();
+    lastBgsaveSuccess = exitCode == 0 && redisHelper->replaceSnapshot(BGSAVE_FILE_SUFFIX);
+    if (!lastBgsaveSuccess)
+    {
+        redisHelper->discardSnapshot(BGSAVE_FILE_SUFFIX);
+        std::cout << "[" << pid << "] " << getDate() << " # Background saving failed" << std::endl;
+        return;
+    }
+    lastSaveTime = std::time(nullptr);
+    std::cout << "[" << pid << "] " << getDate() << " * Background saving terminated with success in "
+              << lastBgsaveDuration << " ms";
+    if (cowSize >= 0)
+    {
+        std::cout << ", " << cowSize / 1024 << " MB (" << cowSize * 1024 / sysconf(_SC_PAGESIZE)
+                  << " pages) of memory used by copy-on-write";
+    }
+    std::cout << std::endl;
+}
+
+void RedisServer::cancelBackgroundSave()
+{
+    if (savePid <= 0)
+    {
+        return;
+    }
+    ChildProcess::terminate(savePid);
+    savePid = -1;
+    ChildProcess::readCowSize(saveCowFd);
+    saveCowFd = -1;
+    CommandParser::getRedisHelper()->discardSnapshot(BGSAVE_FILE_SUFFIX);
+}
+
+/**
+ * 返回持久化相关的状态，格式和Redis的INFO persistence一致。
+ *
+ * @return 返回每行一项的状态信息。
+ */
+std::string RedisServer::info()
+{
+    long pageSize = sysconf(_SC_PAGESIZE);
+    std::ostringstream oss;
+    oss << "# Persistence\n"
+        << "rdb_bgsave_in_progress:" << (savePid > 0 ? 1 : 0) << "\n"
+        << "rdb_last_save_time:" << lastSaveTime << "\n"
+        << "rdb_last_bgsave_status:" << (lastBgsaveSuccess ? "ok" : "err") << "\n"
+        << "rdb_last_bgsave_time_ms:" << lastBgsaveDuration << "\n"
+        << "rdb_last_cow_size:" << (lastBgsaveCowSize >= 0 ? lastBgsaveCowSize * 1024 : -1) << "\n"
+        << "rdb_last_cow_pages:" << (lastBgsaveCowSize >= 0 ? lastBgsaveCowSize * 1024 / pageSize : -1) << "\n"
+        << "aof_enabled:" << (appendOnlyFile->isOpen() ? 1 : 0) << "\n"
+        << "aof_rewrite_in_progress:" << (rewritePid > 0 ? 1 : 0) << "\n"
+        << "aof_current_size:" << appendOnlyFile->size();
+    return oss.str();
+}
+
+/**
+ * 定时任务：每SERVER_CRON_INTERVAL毫秒检查一次重写和后台保存的子进程是否结束，以及日志是否需要自动重写。
+ * 只有真正需要处理时才独占persistenceMutex，平时不影响命令的执行。
+ * 收到SIGINT后由这里调用shutdown关闭服务器。
+ */
+void RedisServer::serverCron()
+{
+    std::unique_lock<std::mutex> cronLock(cronMutex);
+    while (!stop)
+    {
+        cronCondition.wait_for(cronLock, std::chrono::milliseconds(SERVER_CRON_INTERVAL));
+        if (stop)
+        {
+            break;
+        }
+        if (shutdownRequested)
+        {
+            shutdown();
+        }
+        int exitCode = 0;
+        pid_t saveChild = savePid;
+        if (saveChild > 0 && ChildProcess::poll(saveChild, exitCode))
+        {
+            std::unique_lock<std::shared_mutex> lock(persistenceMutex);
+            if (savePid == saveChild) // 等锁期间后台保存可能已被取消
+            {
+                finishBackgroundSave(exitCode);
+            }
+        }
+        pid_t child = rewritePid;
+        if (child > 0 && ChildProcess::poll(child, exitCode))
+        {
+            std::unique_lock<std::shared_mutex> lock(persistenceMutex);
+            if (rewritePid != child)
+            {
+                continue; // 等锁期间重写已被取消
+            }
+            rewritePid = -1;
+            std::string imagePath = getAppendOnlyFilePath() + ".rewrite";
+            if (exitCode == 0 && appendOnlyFile->finishRewrite(imagePath))
+            {
+                std::cout << "[" << pid << "] " << getDate() << " * Background append only file rewriting finished" << std::endl;
+            }
+            else
+            {
+                appendOnlyFile->abortRewrite();
+                std::remove(imagePath.c_str());
+                std::cout << "[" << pid << "] " << getDate() << " # Background append only file rewriting failed" << std::endl;
+            }
+        }
+        else if (child <= 0 && appendOnlyFile->needsRewrite())
+        {
+            std::unique_lock<std::shared_mutex> lock(persistenceMutex);
+            startRewrite();
+        }
+        expireSessions();
     }
-    // 如果以上条件都不满足，则返回"error"
-    return "error";
 }
 
 // 替换字符串中的指定字符
@@ -346,17 +943,30 @@ std::string RedisServer::getDate()
  * 处理Redis服务器接收到的信号。
  *
  * @param sig 接收到的信号，通常为SIGINT（中断信号）。
- * 如果接收到的是SIGINT信号，那么会调用CommandParser::getRedisHelper()->flush()方法清空当前Redis服务器中的所有数据，然后退出程序。
+ * 信号可能打断持有锁的线程，处理函数里加锁或写文件会死锁，所以只设置shutdownRequested，
+ * 由定时任务在SERVER_CRON_INTERVAL毫秒内调用shutdown写入快照并退出。
  */
 void RedisServer::signalHandler(int sig)
 {
     if (sig == SIGINT)
     {
-        CommandParser::getRedisHelper()->flush();
-        exit(0);
+        shutdownRequested = true;
     }
 }
 
+/**
+ * 收到SIGINT后关闭服务器：独占persistenceMutex，等执行中的命令结束并阻止新的命令，
+ * 写入快照并清空追加日志（进行中的重写和后台保存随之取消），然后退出进程。
+ * 用_exit退出：静态对象的析构会在本线程中join定时任务线程自身，并且快照已经写好，不需要再写一次。
+ */
+void RedisServer::shutdown()
+{
+    std::unique_lock<std::shared_mutex> lock(persistenceMutex);
+    CommandParser::getRedisHelper()->flush(appendOnlyFile->position());
+    std::cout << "[" << pid << "] " << getDate() << " # DB saved on disk, exiting" << std::endl;
+    _exit(0);
+}
+
 /**
  * 初始化RedisServer对象。
  *
@@ -368,4 +978,28 @@ RedisServer::RedisServer(int port, const std::string &logoFilePath)
     flyweightFactory(new ParserFlyweightFactory())
 {
     pid = getpid();
+    lastSaveTime = std::time(nullptr);
+    loadAppendOnlyFile();
+    cronThread = std::thread(&RedisServer::serverCron, this);
+}
+
+/**
+ * 关闭时停止定时任务，写入快照并清空追加日志（进行中的重写随之取消）。
+ */
+RedisServer::~RedisServer()
+{
+    {
+        std::lock_guard<std::mutex> cronLock(cronMutex);
+        stop = true;
+    }
+    cronCondition.notify_one();
+    cronThread.join();
+    std::shared_ptr<RedisHelper> redisHelper = CommandParser::getRedisHelper();
+    {
+        std::unique_lock<std::shared_mutex> lock(persistenceMutex);
+        redisHelper->flush(appendOnlyFile->position());
+    }
+    redisHelper->setFlushCallback(nullptr);
+    redisHelper->setAppendOnlyFile(nullptr);
+    appendOnlyFile.reset();
 }
@@ -19,31 +19,102 @@
 #include <signal.h>
 #include<fcntl.h>
 #include <cstring> 
+#include <shared_mutex>
 #include "ParserFlyweightFactory.h"
+#include "AppendOnlyFile.h"
+#include "ChildProcess.h"
+#define SERVER_CRON_INTERVAL 100 // 定时任务的间隔（毫秒）
+#define BGSAVE_FILE_SUFFIX ".bgsave" // 后台保存时子进程写入的快照文件后缀
+#define SESSION_IDLE_TIMEOUT 3600 // 会话空闲超过这个时间（秒）后由定时任务回收
 #include <queue>
+#include <deque>
+#include <memory>
+#include <unordered_map>
 #include <string>
+#include <string_view>
 using namespace std;
 class RedisServer {
+public:
+    // 一个客户端的会话状态：当前数据库和事务。RPC客户端以会话编号区分，RESP按连接区分
+    struct Session {
+        std::atomic<int> dataBaseIndex{0}; // 当前数据库索引
+        std::mutex mutex; // 保护下面的事务状态，同一会话的请求可能由不同的工作线程同时处理
+        std::atomic<bool> startMulti{false};
+        bool fallback = false;
+        std::deque<std::vector<std::string>> commandsQueue; // 事务指令队列，每条命令已分割为参数
+        std::atomic<int64_t> lastActive{0}; // 最近一次使用的时间（秒），用于回收空闲会话
+    };
+    // 在作用域内让当前线程处理的命令使用指定会话的数据库和事务状态
+    class SessionScope {
+    private:
+        Session *previous;
+        RedisHelper::SessionDataBase dataBase;
+    public:
+        explicit SessionScope(Session &session);
+        ~SessionScope();
+        SessionScope(const SessionScope &) = delete;
+        SessionScope &operator=(const SessionScope &) = delete;
+    };
+
 private:
     std::unique_ptr<ParserFlyweightFactory> flyweightFactory; // 解析器工厂
     int port;
     std::atomic<bool> stop{false};
     pid_t pid;
     std::string logoFilePath;
-    bool startMulti = false;
-    bool fallback = false;
-    std::queue<std::string>commandsQueue;//事物指令队列
+    static thread_local Session *currentSession; // 当前线程正在处理的会话
+    static std::atomic<bool> shutdownRequested; // 收到SIGINT，信号处理函数只设置它，由定时任务完成关闭
+    Session defaultSession; // 没有指定会话时使用，和全局的数据库下标对应
+    std::unordered_map<uint64_t, std::shared_ptr<Session>> sessions; // RPC客户端的会话
+    std::shared_mutex sessionsMutex;
+    std::unique_ptr<AppendOnlyFile> appendOnlyFile; // 追加日志
+    std::shared_mutex persistenceMutex; // 写命令执行和记录日志时共享持有，select等会清空日志的操作独占持有
+    std::atomic<pid_t> rewritePid{-1}; // 正在重写日志的子进程，只在独占持有persistenceMutex时修改
+    std::atomic<pid_t> savePid{-1}; // 正在保存快照的子进程，只在独占持有persistenceMutex时修改
+    int saveCowFd = -1; // 读取保存快照的子进程写时复制大小的管道
+    std::chrono::steady_clock::time_point saveStartTime;
+    // 以下保存状态在独占持有persistenceMutex时修改，共享持有时读取
+    time_t lastSaveTime = 0; // 最近一次成功保存快照的时间
+    bool lastBgsaveSuccess = true; // 最近一次后台保存是否成功
+    long lastBgsaveDuration = -1; // 最近一次后台保存的耗时（毫秒）
+    long lastBgsaveCowSize = -1; // 最近一次后台保存期间写时复制的内存大小（KB）
+    std::thread cronThread; // 定时检查后台子进程和自动重写
+    std::mutex cronMutex;
+    std::condition_variable cronCondition;
 
 private:
     RedisServer(int port = 5555, const std::string& logoFilePath = MY_PROJECT_DIR_LOGO);
     static void signalHandler(int sig);
+    void shutdown(); // 写入快照后退出进程，在定时任务线程中调用
     void printLogo();
     void printStartMessage();
     void replaceText(std::string &text, const std::string &toReplaceText, const std::string &replaceText);
     std::string getDate();
-    string executeTransaction(std::queue<std::string>&commandsQueue);
+    Session &session() { return currentSession != nullptr ? *currentSession : defaultSession; }
+    std::vector<std::string> executeTransaction(std::deque<std::vector<std::string>>&commandsQueue);
+    bool collectKeys(const std::deque<std::vector<std::string>> &commandsQueue, int dataBaseIndex, std::vector<std::pair<int, std::string>> &keys) const; // 事务访问的key，无法确定时返回false
+    void expireSessions(); // 回收空闲的会话
+    static void splitTokens(std::string_view data, TokenBuffer &tokens); // 按空白分割命令，参数指向data
+    string executeCommand(const ParserEntry *commandParser, TokenSpan tokens); // 执行命令并写入追加日志
+    string applyCommand(const ParserEntry *commandParser, TokenSpan tokens); // 执行命令，写命令需调用方共享持有persistenceMutex
+    static bool isServerCommand(std::string_view command); // 需要handleCommand单独处理的命令
+    void loadAppendOnlyFile(); // 重放追加日志并打开日志文件
+    std::string getAppendOnlyFilePath();
+    std::string startRewrite(); // fork子进程重写追加日志，调用方需独占持有persistenceMutex
+    void cancelRewrite(); // 取消正在进行的重写，调用方需独占持有persistenceMutex
+    std::string startBackgroundSave(); // fork子进程保存快照，调用方需独占持有persistenceMutex
+    void finishBackgroundSave(int exitCode); // 子进程结束后替换快照，调用方需独占持有persistenceMutex
+    void cancelBackgroundSave(); // 取消正在进行的后台保存，调用方需独占持有persistenceMutex
+    std::string info(); // 持久化相关的状态
+    void serverCron(); // 定时任务
 public:
-string handleClient(string receivedData);
+    ~RedisServer();
+string handleClient(std::string_view receivedData);
+    string handleCommand(TokenSpan tokens, std::vector<std::string> *transactionReplies = nullptr); // 执行已分割为参数的命令
+    std::vector<std::string> handleBatch(std::vector<std::string> commands); // 一次执行多条命令
+    static void lowerCommandName(TokenBuffer &tokens, std::string &storage); // 把命令名转换为小写
+    std::shared_ptr<Session> getSession(uint64_t id); // 取得会话，不存在时创建
+    void releaseSession(uint64_t id); // 客户端退出时释放会话
    static RedisServer* getInstance();
     void start();
 };
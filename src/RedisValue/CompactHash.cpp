@@ -0,0 +1,329 @@
+#include "CompactHash.h"
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace {
+void appendVarint(std::string &data, size_t value) {
+    while (value >= 0x80) {
+        data += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    data += static_cast<char>(value);
+}
+
+size_t readVarint(std::string_view data, size_t &pos) {
+    size_t value = 0;
+    for (int shift = 0; pos < data.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+// 装填不超过3/4时还能再放一个字段
+bool hasRoom(size_t filled, size_t size) {
+    return (filled + 1) * 4 <= size * 3;
+}
+}
+
+/**
+ * 从紧凑数组的pos处读取一个字段。
+ *
+ * @param data 紧凑数组。
+ * @param pos 读取位置，读取后移动到下一个字段。
+ * @param field 输出字段名。
+ * @param value 输出值。
+ * @return 读到字段返回true，已到末尾返回false。
+ */
+bool CompactHash::readEntry(std::string_view data, size_t &pos, std::string_view &field, std::string_view &value) {
+    if (pos >= data.size()) {
+        return false;
+    }
+    size_t length = readVarint(data, pos);
+    field = data.substr(pos, length);
+    pos += length;
+    length = readVarint(data, pos);
+    value = data.substr(pos, length);
+    pos += length;
+    return true;
+}
+
+void CompactHash::appendEntry(std::string &data, std::string_view field, std::string_view value) {
+    appendVarint(data, field.size());
+    data.append(field.data(), field.size());
+    appendVarint(data, value.size());
+    data.append(value.data(), value.size());
+}
+
+/**
+ * 在紧凑数组中查找字段。
+ *
+ * @param field 字段名。
+ * @param start 输出字段编码的起始位置。
+ * @param end 输出字段编码的结束位置。
+ * @param value 输出字段的值。
+ * @return 找到返回true。
+ */
+bool CompactHash::findEntry(std::string_view field, size_t &start, size_t &end, std::string_view &value) const {
+    size_t pos = 0;
+    std::string_view currentField, currentValue;
+    while (true) {
+        start = pos;
+        if (!readEntry(packed, pos, currentField, currentValue)) {
+            return false;
+        }
+        if (currentField == field) {
+            end = pos;
+            value = currentValue;
+            return true;
+        }
+    }
+}
+
+size_t CompactHash::probe(const Table &table, std::string_view field) {
+    size_t size = table.slots.size();
+    if (size == 0) {
+        return size;
+    }
+    size_t mask = size - 1;
+    size_t index = std::hash<std::string_view>{}(field) & mask;
+    for (size_t i = 0; i < size; i++) {
+        const Slot &slot = table.slots[index];
+        if (slot.state == EMPTY) {
+            return size;
+        }
+        if (slot.state == FULL && slot.field == field) {
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+    return size;
+}
+
+void CompactHash::insertSlot(Table &table, std::string &&field, std::string &&value) {
+    size_t mask = table.slots.size() - 1;
+    size_t index = std::hash<std::string_view>{}(field) & mask;
+    while (table.slots[index].state == FULL) {
+        index = (index + 1) & mask;
+    }
+    Slot &slot = table.slots[index];
+    if (slot.state == EMPTY) {
+        table.filled++; // 复用墓碑不增加探测长度
+    }
+    slot.field = std::move(field);
+    slot.value = std::move(value);
+    slot.state = FULL;
+    table.used++;
+}
+
+size_t CompactHash::tableSizeFor(size_t count) {
+    size_t size = HASH_MIN_TABLE_SIZE;
+    while (size < count * 2) {
+        size *= 2;
+    }
+    return size;
+}
+
+CompactHash::Slot *CompactHash::findSlot(std::string_view field) {
+    return const_cast<Slot *>(static_cast<const CompactHash *>(this)->findSlot(field));
+}
+
+const CompactHash::Slot *CompactHash::findSlot(std::string_view field) const {
+    for (const Table &table : tables) {
+        size_t index = probe(table, field);
+        if (index != table.slots.size()) {
+            return &table.slots[index];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * 把紧凑数组中的字段全部移入哈希表，之后不再转换回紧凑数组。
+ */
+void CompactHash::convertToTable() {
+    Table table;
+    table.slots.resize(tableSizeFor(packedCount + 1));
+    forEach([&table](std::string_view field, std::string_view value) {
+        insertSlot(table, std::string(field), std::string(value));
+    });
+    std::string().swap(packed);
+    packedCount = 0;
+    tables[0] = std::move(table);
+    isTable = true;
+}
+
+/**
+ * 渐进式迁移：从旧表迁移HASH_REHASH_STEP个槽位到新表，旧表迁移完后用新表替换。
+ * 迁移走的槽位标记为墓碑，旧表中后面的字段仍能探测到。
+ */
+void CompactHash::rehashStep() {
+    if (tables[1].slots.empty()) {
+        return;
+    }
+    Table &from = tables[0];
+    for (int i = 0; i < HASH_REHASH_STEP && rehashIndex < from.slots.size(); i++, rehashIndex++) {
+        Slot &slot = from.slots[rehashIndex];
+        if (slot.state != FULL) {
+            continue;
+        }
+        if (!hasRoom(tables[1].filled, tables[1].slots.size())) {
+            rebuild(tableSizeFor(size() + 1)); // 迁移期间新字段太多，一次性完成迁移
+            return;
+        }
+        insertSlot(tables[1], std::move(slot.field), std::move(slot.value));
+        std::string().swap(slot.field);
+        std::string().swap(slot.value);
+        slot.state = DELETED;
+        from.used--;
+    }
+    if (rehashIndex == from.slots.size()) {
+        tables[0] = std::move(tables[1]);
+        tables[1] = Table();
+        rehashIndex = 0;
+    }
+}
+
+void CompactHash::rebuild(size_t size) {
+    Table table;
+    table.slots.resize(size);
+    for (Table &from : tables) {
+        for (Slot &slot : from.slots) {
+            if (slot.state == FULL) {
+                insertSlot(table, std::move(slot.field), std::move(slot.value));
+            }
+        }
+    }
+    tables[0] = std::move(table);
+    tables[1] = Table();
+    rehashIndex = 0;
+}
+
+/**
+ * 查找字段的值。
+ *
+ * @param field 字段名。
+ * @param value 找到时指向字段的值，下次修改哈希前有效。
+ * @return 字段存在返回true。
+ */
+bool CompactHash::find(std::string_view field, std::string_view &value) const {
+    if (!isTable) {
+        size_t start = 0, end = 0;
+        return findEntry(field, start, end, value);
+    }
+    const Slot *slot = findSlot(field);
+    if (slot == nullptr) {
+        return false;
+    }
+    value = slot->value;
+    return true;
+}
+
+/**
+ * 设置字段的值，字段不存在时新增。
+ *
+ * @param field 字段名。
+ * @param value 字段的值。
+ * @return 新增字段返回true，覆盖已有字段返回false。
+ */
+bool CompactHash::set(std::string_view field, std::string_view value) {
+    if (!isTable) {
+        if (field.size() > HASH_MAX_LISTPACK_VALUE || value.size() > HASH_MAX_LISTPACK_VALUE) {
+            convertToTable();
+        } else {
+            size_t start = 0, end = 0;
+            std::string_view oldValue;
+            if (findEntry(field, start, end, oldValue)) {
+                std::string entry;
+                appendEntry(entry, field, value);
+                packed.replace(start, end - start, entry);
+                return false;
+            }
+            if (packedCount < HASH_MAX_LISTPACK_ENTRIES) {
+                appendEntry(packed, field, value);
+                packedCount++;
+                return true;
+            }
+            convertToTable();
+        }
+    }
+    rehashStep();
+    Slot *slot = findSlot(field);
+    if (slot != nullptr) {
+        slot->value.assign(value.data(), value.size());
+        return false;
+    }
+    if (tables[1].slots.empty()) {
+        if (!hasRoom(tables[0].filled, tables[0].slots.size())) {
+            tables[1].slots.resize(tableSizeFor(size() + 1)); // 开始迁移，新字段写入新表
+            rehashIndex = 0;
+        }
+    } else if (!hasRoom(tables[1].filled, tables[1].slots.size())) {
+        rebuild(tableSizeFor(size() + 1));
+    }
+    insertSlot(tables[1].slots.empty() ? tables[0] : tables[1], std::string(field), std::string(value));
+    return true;
+}
+
+/**
+ * 删除字段。
+ *
+ * @param field 字段名。
+ * @return 字段存在并删除返回true，否则返回false。
+ */
+bool CompactHash::erase(std::string_view field) {
+    if (!isTable) {
+        size_t start = 0, end = 0;
+        std::string_view value;
+        if (!findEntry(field, start, end, value)) {
+            return false;
+        }
+        packed.erase(start, end - start);
+        packedCount--;
+        return true;
+    }
+    rehashStep();
+    for (Table &table : tables) {
+        size_t index = probe(table, field);
+        if (index != table.slots.size()) {
+            Slot &slot = table.slots[index];
+            std::string().swap(slot.field);
+            std::string().swap(slot.value);
+            slot.state = DELETED;
+            table.used--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CompactHash::operator==(const CompactHash &other) const {
+    if (size() != other.size()) {
+        return false;
+    }
+    bool equal = true;
+    forEach([&](std::string_view field, std::string_view value) {
+        std::string_view otherValue;
+        if (equal && (!other.find(field, otherValue) || otherValue != value)) {
+            equal = false;
+        }
+    });
+    return equal;
+}
+
+// 按排序后的字段和值比较，结果与存储方式和插入顺序无关
+bool CompactHash::operator<(const CompactHash &other) const {
+    auto sortedItems = [](const CompactHash &hash) {
+        std::vector<std::pair<std::string_view, std::string_view>> items;
+        hash.forEach([&items](std::string_view field, std::string_view value) {
+            items.emplace_back(field, value);
+        });
+        std::sort(items.begin(), items.end());
+        return items;
+    };
+    return sortedItems(*this) < sortedItems(other);
+}
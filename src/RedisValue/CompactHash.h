@@ -0,0 +1,90 @@
+#ifndef COMPACTHASH_H
+#define COMPACTHASH_H
+#include<cstdint>
+#include<string>
+#include<string_view>
+#include<vector>
+#define HASH_MAX_LISTPACK_ENTRIES 128 //紧凑数组最多容纳的字段数，超过后转换为哈希表
+#define HASH_MAX_LISTPACK_VALUE 64 //紧凑数组中字段名和值的最大长度，超过后转换为哈希表
+#define HASH_MIN_TABLE_SIZE 16 //哈希表的最小槽位数，2的幂
+#define HASH_REHASH_STEP 4 //渐进式迁移时每次写操作顺带迁移的槽位数
+
+/*
+    哈希类型的存储，字段名和值都直接保存为字符串，不再为每个值分配一个RedisValue。
+    字段少且都不长时，所有字段依次编码在一块连续内存中（紧凑数组，类似Redis的listpack）：
+    每个字段是 变长整数长度+字段名、变长整数长度+值，查找时顺序扫描，整个哈希只占一次内存分配。
+    字段数超过HASH_MAX_LISTPACK_ENTRIES或者出现超过HASH_MAX_LISTPACK_VALUE的字段名、值后，
+    转换为线性探测的开放寻址哈希表，删除的槽位留下墓碑，探测时跳过。
+    哈希表装填超过3/4时分配新表，之后每次写操作从旧表迁移HASH_REHASH_STEP个槽位（渐进式rehash），
+    迁移期间查找两张表，新字段写入新表，单次操作的耗时不随哈希大小增长。
+    查找是const操作，不做迁移，可以在分片读锁下并发执行。
+*/
+class CompactHash{
+private:
+    enum SlotState : uint8_t{
+        EMPTY,FULL,DELETED
+    };
+    struct Slot{
+        std::string field;
+        std::string value;
+        SlotState state = EMPTY;
+    };
+    struct Table{
+        std::vector<Slot> slots;
+        size_t used = 0; //存放字段的槽位数
+        size_t filled = 0; //存放字段和墓碑的槽位数，决定探测长度
+    };
+
+    std::string packed; //紧凑数组
+    size_t packedCount = 0; //紧凑数组中的字段数
+    bool isTable = false; //是否已转换为哈希表
+    Table tables[2]; //tables[1]不为空时正在从tables[0]迁移到tables[1]
+    size_t rehashIndex = 0; //tables[0]中下一个要迁移的槽位
+
+    static bool readEntry(std::string_view data, size_t &pos, std::string_view &field, std::string_view &value);
+    static void appendEntry(std::string &data, std::string_view field, std::string_view value);
+    bool findEntry(std::string_view field, size_t &start, size_t &end, std::string_view &value) const; //在紧凑数组中查找
+
+    static size_t probe(const Table &table, std::string_view field); //返回字段所在的槽位，不存在时返回table.slots.size()
+    static void insertSlot(Table &table, std::string &&field, std::string &&value); //调用方保证字段不存在且有空槽位
+    static size_t tableSizeFor(size_t count); //容纳count个字段的槽位数
+    Slot *findSlot(std::string_view field);
+    const Slot *findSlot(std::string_view field) const;
+    void convertToTable();
+    void rehashStep();
+    void rebuild(size_t size); //把所有字段一次性移入size个槽位的新表，结束迁移
+
+public:
+    size_t size() const { return isTable ? tables[0].used + tables[1].used : packedCount; }
+    bool empty() const { return size() == 0; }
+    bool isPacked() const { return !isTable; }
+
+    bool find(std::string_view field, std::string_view &value) const; //value指向内部存储，下次修改前有效
+    bool set(std::string_view field, std::string_view value); //新增字段返回true，覆盖已有字段返回false
+    bool erase(std::string_view field); //字段存在时删除并返回true
+
+    //依次对每个字段调用func(field, value)，紧凑数组按插入顺序，哈希表按槽位顺序
+    template<typename Function>
+    void forEach(Function func) const{
+        if(!isTable){
+            size_t pos = 0;
+            std::string_view field, value;
+            while(readEntry(packed, pos, field, value)){
+                func(field, value);
+            }
+            return;
+        }
+        for(const Table &table : tables){
+            for(const Slot &slot : table.slots){
+                if(slot.state == FULL){
+                    func(std::string_view(slot.field), std::string_view(slot.value));
+                }
+            }
+        }
+    }
+
+    bool operator==(const CompactHash &other) const;
+    bool operator<(const CompactHash &other) const;
+};
+
+#endif
@@ -1,8 +1,11 @@
 #ifndef DUMP_H
 #define DUMP_H
 #include<cmath>
+#include<cstdint>
 #include<string>
 #include"RedisValue.h"
+#include"QuickList.h"
+#include"CompactHash.h"
 
 // 表示null值
 struct NullStruct{
@@ -51,6 +54,13 @@ static void dump(int value, std::string &out) {
     out += buf;
 }
 
+// 用于将64位整数值转换为字符串并追加到输出字符串中
+static void dump(int64_t value, std::string &out) {
+    char buf[32];
+    snprintf(buf, sizeof buf, "%lld", static_cast<long long>(value));
+    out += buf;
+}
+
 // 用于将布尔值转换为字符串并追加到输出字符串中
 /**
  * 将布尔值转换为字符串形式，并添加到给定的输出字符串中。
@@ -115,4 +125,28 @@ static void dump(const RedisValue::object &values, std::string &out) {
     out += "}";
 }
 
+// 用于将列表按字符串数组的格式追加到输出字符串中
+static void dump(const QuickList &values, std::string &out) {
+    out += "[";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i != 0) out += ", ";
+        dump(values[i], out);
+    }
+    out += "]";
+}
+
+// 用于将哈希按JSON对象的格式追加到输出字符串中
+static void dump(const CompactHash &values, std::string &out) {
+    bool first = true;
+    out += "{";
+    values.forEach([&](std::string_view field, std::string_view value) {
+        if (!first) out += ", ";
+        dump(std::string(field), out);
+        out += ": ";
+        dump(std::string(value), out);
+        first = false;
+    });
+    out += "}";
+}
+
 #endif
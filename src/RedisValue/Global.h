@@ -13,12 +13,22 @@ struct Statics{
     // 定义一个静态的空字符串
     std::string emptyString;
 
+    // 非数值类型调用integerValue/doubleValue时返回的静态值
+    int64_t zeroInteger = 0;
+    double zeroDouble = 0;
+
     // 定义一个静态的空Json数组
     std::vector<RedisValue> emptyVector;
 
     // 定义一个静态的空Json对象映射
     std::map<std::string,RedisValue> emptyMap;
 
+    // 定义一个静态的空列表
+    QuickList emptyList;
+
+    // 定义一个静态的空哈希
+    CompactHash emptyHash;
+
     // 默认构造函数
     Statics(){}
 };
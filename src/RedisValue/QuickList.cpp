@@ -0,0 +1,252 @@
+#include "QuickList.h"
+#include <algorithm>
+#include <utility>
+
+QuickList::QuickList(QuickList &&other) noexcept
+    : ring(std::move(other.ring)), firstNode(other.firstNode), nodeCount(other.nodeCount),
+      head(other.head), count(other.count) {
+    other.clear();
+}
+
+QuickList &QuickList::operator=(QuickList &&other) noexcept {
+    if (this != &other) {
+        ring = std::move(other.ring);
+        firstNode = other.firstNode;
+        nodeCount = other.nodeCount;
+        head = other.head;
+        count = other.count;
+        other.clear();
+    }
+    return *this;
+}
+
+QuickList::QuickList(const QuickList &other) {
+    for (size_t i = 0; i < other.count; i++) {
+        pushBack(other[i]);
+    }
+}
+
+QuickList &QuickList::operator=(const QuickList &other) {
+    if (this != &other) {
+        clear();
+        for (size_t i = 0; i < other.count; i++) {
+            pushBack(other[i]);
+        }
+    }
+    return *this;
+}
+
+/**
+ * 按下标定位元素。中间的节点都是满的，第index个元素在所有节点连成的数组中的位置是head + index。
+ * 只有一个节点时节点可能小于QUICKLIST_NODE_SIZE，但元素都在这个节点内，计算方式相同。
+ *
+ * @param index 元素下标，调用方保证小于size()。
+ * @return 元素的引用。
+ */
+const std::string &QuickList::at(size_t index) const {
+    size_t offset = head + index;
+    return nodeAt(offset / QUICKLIST_NODE_SIZE)[offset % QUICKLIST_NODE_SIZE];
+}
+
+std::string &QuickList::at(size_t index) {
+    return const_cast<std::string &>(static_cast<const QuickList *>(this)->at(index));
+}
+
+/**
+ * 把环形数组调整为size个槽位，节点按顺序移到开头。
+ *
+ * @param size 新的槽位数，2的幂，不小于节点数。
+ */
+void QuickList::resizeRing(size_t size) {
+    std::vector<Node> resized(size);
+    for (size_t i = 0; i < nodeCount; i++) {
+        resized[i].swap(nodeAt(i));
+    }
+    ring.swap(resized);
+    firstNode = 0;
+}
+
+void QuickList::pushNodeFront(size_t capacity) {
+    if (nodeCount == ring.size()) {
+        resizeRing(ring.empty() ? 1 : ring.size() * 2);
+    }
+    firstNode = (firstNode + ring.size() - 1) & (ring.size() - 1);
+    ring[firstNode].resize(capacity);
+    nodeCount++;
+}
+
+void QuickList::pushNodeBack(size_t capacity) {
+    if (nodeCount == ring.size()) {
+        resizeRing(ring.empty() ? 1 : ring.size() * 2);
+    }
+    nodeCount++;
+    nodeAt(nodeCount - 1).resize(capacity);
+}
+
+// 释放第一个节点，节点数降到环形数组的1/4时缩小环形数组
+void QuickList::popNodeFront() {
+    Node().swap(nodeAt(0));
+    firstNode = (firstNode + 1) & (ring.size() - 1);
+    nodeCount--;
+    if (ring.size() > 1 && nodeCount * 4 <= ring.size()) {
+        resizeRing(ring.size() / 2);
+    }
+}
+
+void QuickList::popNodeBack() {
+    Node().swap(nodeAt(nodeCount - 1));
+    nodeCount--;
+    if (ring.size() > 1 && nodeCount * 4 <= ring.size()) {
+        resizeRing(ring.size() / 2);
+    }
+}
+
+/**
+ * 列表只有一个节点且节点已满时，把节点扩大为2倍（不超过QUICKLIST_NODE_SIZE）。
+ *
+ * @param front 为true时元素移到新节点的末尾，在前面留出空位；否则元素位置不变，在后面留出空位。
+ */
+void QuickList::growSingleNode(bool front) {
+    Node &node = nodeAt(0);
+    size_t capacity = std::min(node.size() * 2, static_cast<size_t>(QUICKLIST_NODE_SIZE));
+    Node grown(capacity);
+    size_t newHead = front ? capacity - count : head;
+    for (size_t i = 0; i < count; i++) {
+        grown[newHead + i] = std::move(node[head + i]);
+    }
+    node.swap(grown);
+    head = newHead;
+}
+
+/**
+ * 在列表头部插入元素，第一个节点没有空位时扩容唯一的小节点，或在前面新建一个节点。
+ *
+ * @param value 要插入的元素。
+ */
+void QuickList::pushFront(std::string value) {
+    if (nodeCount == 0) {
+        pushNodeBack(QUICKLIST_MIN_NODE_SIZE);
+        head = QUICKLIST_MIN_NODE_SIZE;
+    } else if (head == 0) {
+        if (nodeCount == 1 && nodeAt(0).size() < QUICKLIST_NODE_SIZE) {
+            growSingleNode(true);
+        } else {
+            pushNodeFront(QUICKLIST_NODE_SIZE);
+            head = QUICKLIST_NODE_SIZE;
+        }
+    }
+    head--;
+    count++;
+    nodeAt(0)[head] = std::move(value);
+}
+
+/**
+ * 在列表尾部插入元素，最后一个节点已满时扩容唯一的小节点，或在后面新建一个节点。
+ *
+ * @param value 要插入的元素。
+ */
+void QuickList::pushBack(std::string value) {
+    if (nodeCount == 0) {
+        pushNodeBack(QUICKLIST_MIN_NODE_SIZE);
+        head = 0;
+    } else {
+        size_t capacity = (nodeCount - 1) * QUICKLIST_NODE_SIZE + nodeAt(nodeCount - 1).size();
+        if (head + count == capacity) {
+            if (nodeCount == 1 && capacity < QUICKLIST_NODE_SIZE) {
+                growSingleNode(false);
+            } else {
+                pushNodeBack(QUICKLIST_NODE_SIZE);
+            }
+        }
+    }
+    count++;
+    at(count - 1) = std::move(value);
+}
+
+/**
+ * 移出并返回第一个元素，第一个节点空了之后释放该节点。
+ *
+ * @return 第一个元素。
+ */
+std::string QuickList::popFront() {
+    std::string value = std::move(at(0));
+    std::string().swap(at(0)); // 释放移出后可能残留的内存
+    head++;
+    count--;
+    if (count == 0) {
+        clear();
+    } else if (head == QUICKLIST_NODE_SIZE) {
+        popNodeFront();
+        head = 0;
+    }
+    return value;
+}
+
+/**
+ * 移出并返回最后一个元素，最后一个节点空了之后释放该节点。
+ *
+ * @return 最后一个元素。
+ */
+std::string QuickList::popBack() {
+    std::string value = std::move(at(count - 1));
+    std::string().swap(at(count - 1));
+    count--;
+    if (count == 0) {
+        clear();
+    } else if ((head + count) % QUICKLIST_NODE_SIZE == 0) {
+        popNodeBack();
+    }
+    return value;
+}
+
+/**
+ * 只保留下标在[start, stop]之间的元素，从两端删除其余元素。
+ *
+ * @param start 保留的第一个元素的下标。
+ * @param stop 保留的最后一个元素的下标，超过末尾时按末尾处理。
+ */
+void QuickList::trim(size_t start, size_t stop) {
+    if (start > stop || start >= count) {
+        clear();
+        return;
+    }
+    size_t removeBack = stop + 1 < count ? count - stop - 1 : 0;
+    for (size_t i = 0; i < removeBack; i++) {
+        popBack();
+    }
+    for (size_t i = 0; i < start; i++) {
+        popFront();
+    }
+}
+
+void QuickList::clear() {
+    std::vector<Node>().swap(ring);
+    firstNode = 0;
+    nodeCount = 0;
+    head = 0;
+    count = 0;
+}
+
+bool QuickList::operator==(const QuickList &other) const {
+    if (count != other.count) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (at(i) != other.at(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 按字典序比较
+bool QuickList::operator<(const QuickList &other) const {
+    size_t length = std::min(count, other.count);
+    for (size_t i = 0; i < length; i++) {
+        int result = at(i).compare(other.at(i));
+        if (result != 0) {
+            return result < 0;
+        }
+    }
+    return count < other.count;
+}
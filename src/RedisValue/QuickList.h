@@ -0,0 +1,59 @@
+#ifndef QUICKLIST_H
+#define QUICKLIST_H
+#include<string>
+#include<vector>
+#define QUICKLIST_NODE_SIZE 128 //每个节点连续存放的元素个数
+#define QUICKLIST_MIN_NODE_SIZE 4 //列表只有一个节点时，节点从这个大小开始按2倍扩容到QUICKLIST_NODE_SIZE
+
+/*
+    列表类型的存储：元素按固定大小的节点分块连续存放，节点放在环形数组中。
+    除了第一个和最后一个节点，中间的节点总是满的，第i个元素的位置可以直接算出，
+    所以两端的插入、删除是O(1)，按下标访问也是O(1)，lrange只需顺序读取连续的内存。
+    列表只有一个节点时，节点按需从QUICKLIST_MIN_NODE_SIZE扩容，元素很少的列表不分配完整的节点；
+    有两个以上的节点时每个节点都是QUICKLIST_NODE_SIZE大小。
+    元素直接保存为std::string，不再为每个元素分配一个RedisValue。
+*/
+class QuickList{
+private:
+    typedef std::vector<std::string> Node; //节点的size()就是容量，空位是空字符串
+
+    std::vector<Node> ring; //环形数组，大小是2的幂，第i个节点在ring[(firstNode + i) & (ring.size() - 1)]
+    size_t firstNode = 0;
+    size_t nodeCount = 0;
+    size_t head = 0; //第一个元素在第一个节点中的下标
+    size_t count = 0;
+
+    Node &nodeAt(size_t index) { return ring[(firstNode + index) & (ring.size() - 1)]; } //第index个节点
+    const Node &nodeAt(size_t index) const { return ring[(firstNode + index) & (ring.size() - 1)]; }
+    std::string &at(size_t index); //第index个元素，调用方保证不越界
+    const std::string &at(size_t index) const;
+    void resizeRing(size_t size);
+    void pushNodeFront(size_t capacity);
+    void pushNodeBack(size_t capacity);
+    void popNodeFront();
+    void popNodeBack();
+    void growSingleNode(bool front); //扩容唯一的节点，front为true时把元素移到末尾，在前面留出空位
+public:
+    QuickList() = default;
+    QuickList(QuickList &&other) noexcept;
+    QuickList &operator=(QuickList &&other) noexcept;
+    QuickList(const QuickList &other);
+    QuickList &operator=(const QuickList &other);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    std::string &operator[](size_t index) { return at(index); }
+    const std::string &operator[](size_t index) const { return at(index); }
+
+    void pushFront(std::string value);
+    void pushBack(std::string value);
+    std::string popFront(); //列表不能为空
+    std::string popBack(); //列表不能为空
+    void trim(size_t start, size_t stop); //只保留下标在[start, stop]之间的元素，start > stop时清空列表
+    void clear();
+
+    bool operator==(const QuickList &other) const;
+    bool operator<(const QuickList &other) const;
+};
+
+#endif
@@ -1,6 +1,7 @@
 
 #include"Global.h"
 #include "Parse.h"
+#include <charconv>
 
 
 /*************构造函数******************/
@@ -9,6 +10,10 @@ RedisValue::RedisValue() noexcept : redisValue(statics().null) {}
 
 RedisValue::RedisValue(std::nullptr_t) noexcept : redisValue(statics().null) {}
 
+RedisValue::RedisValue(int64_t value) : redisValue(std::make_shared<RedisInteger>(value)) {}
+
+RedisValue::RedisValue(double value) : redisValue(std::make_shared<RedisDouble>(value)) {}
+
 RedisValue::RedisValue(const std::string& value) : redisValue(std::make_shared<RedisString>(value)) {}
 
 RedisValue::RedisValue(std::string&& value) : redisValue(std::make_shared<RedisString>(std::move(value))) {}
@@ -23,6 +28,10 @@ RedisValue::RedisValue(const RedisValue::object& value) : redisValue(std::make_s
 
 RedisValue::RedisValue(RedisValue::object &&value) : redisValue(std::make_shared<RedisObject>(std::move(value))) {}
 
+RedisValue::RedisValue(QuickList &&values) : redisValue(std::make_shared<RedisQuickList>(std::move(values))) {}
+
+RedisValue::RedisValue(CompactHash &&values) : redisValue(std::make_shared<RedisCompactHash>(std::move(values))) {}
+
 /************* Member Functions ******************/
 
 RedisValue::Type RedisValue::type() const {
@@ -33,6 +42,37 @@ std::string & RedisValue::stringValue() {
     return redisValue->stringValue();
 }
 
+bool RedisValue::isInteger() const {
+    return redisValue->isInteger();
+}
+
+int64_t & RedisValue::integerValue() {
+    return redisValue->integerValue();
+}
+
+double & RedisValue::doubleValue() {
+    return redisValue->doubleValue();
+}
+
+/**
+ * 获取值作为Redis字符串时的内容，用于get、strlen、append和重写日志。
+ *
+ * @return 整数按十进制，浮点数按std::to_string（和incrbyfloat的回复一致），字符串原样返回，其他类型返回dump的结果。
+ */
+std::string RedisValue::toString() const {
+    switch (redisValue->type()) {
+        case STRING:
+            return redisValue->stringValue();
+        case NUMBER:
+            if (redisValue->isInteger()) {
+                return std::to_string(redisValue->integerValue());
+            }
+            return std::to_string(redisValue->doubleValue());
+        default:
+            return dump();
+    }
+}
+
 std::vector<RedisValue> & RedisValue::arrayItems() {
     return redisValue->arrayItems();
 }
@@ -41,6 +81,14 @@ std::map<std::string, RedisValue> & RedisValue::objectItems()  {
     return redisValue->objectItems();
 }
 
+QuickList & RedisValue::listItems() {
+    return redisValue->listItems();
+}
+
+CompactHash & RedisValue::hashItems() {
+    return redisValue->hashItems();
+}
+
 /**
  * 使用索引访问RedisValue对象中的元素。
  *
@@ -69,6 +117,14 @@ std::string& RedisValueType::stringValue() {
  *
  * @return 返回一个包含所有数组项的RedisValue类型的向量。如果该类型没有数组项，则返回一个空向量。
  */
+int64_t & RedisValueType::integerValue() {
+    return statics().zeroInteger;
+}
+
+double & RedisValueType::doubleValue() {
+    return statics().zeroDouble;
+}
+
 std::vector<RedisValue> & RedisValueType::arrayItems() {
     return statics().emptyVector;
 }
@@ -82,6 +138,24 @@ std::map<std::string, RedisValue> & RedisValueType::objectItems() {
     return statics().emptyMap;
 }
 
+/**
+ * 获取列表类型的元素。
+ *
+ * @return 返回列表的元素。如果该类型不是列表，则返回一个空列表。
+ */
+QuickList & RedisValueType::listItems() {
+    return statics().emptyList;
+}
+
+/**
+ * 获取哈希类型的字段。
+ *
+ * @return 返回哈希的字段。如果该类型不是哈希，则返回一个空哈希。
+ */
+CompactHash & RedisValueType::hashItems() {
+    return statics().emptyHash;
+}
+
 /**
  * 重载[]运算符，返回RedisValue类型的静态空值。
  *
@@ -160,6 +234,10 @@ void RedisValue::dump(std::string &out) const {
     redisValue->dump(out); // 调用JsonImpl类的dump函数将Json对象转化为JSON字符串并追加到out中
 }
 
+void RedisValue::quoteString(const std::string &value, std::string &out) {
+    ::dump(value, out);
+}
+
 // 将字符串转化为Json对象
 RedisValue RedisValue::parse(const std::string &in, std::string &err) {
     // 初始化一个Json解析器
@@ -192,6 +270,32 @@ RedisValue RedisValue::parse(const char* in, std::string& err){
         return nullptr;
     }
 }
+/**
+ * 把整个字符串解析为int64整数。
+ *
+ * @param in 要解析的字符串，可以带负号。
+ * @param value 解析成功时存放结果。
+ * @return 字符串恰好是一个不溢出的整数时返回true，否则返回false。
+ */
+bool RedisValue::parseInteger(std::string_view in, int64_t &value) {
+    const char *end = in.data() + in.size();
+    auto result = std::from_chars(in.data(), end, value);
+    return !in.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+/**
+ * 把整个字符串解析为有限的double。
+ *
+ * @param in 要解析的字符串。
+ * @param value 解析成功时存放结果。
+ * @return 字符串恰好是一个有限的浮点数时返回true，有多余字符、溢出或是inf/nan时返回false。
+ */
+bool RedisValue::parseDouble(std::string_view in, double &value) {
+    const char *end = in.data() + in.size();
+    auto result = std::from_chars(in.data(), end, value);
+    return !in.empty() && result.ec == std::errc() && result.ptr == end && std::isfinite(value);
+}
+
 // 解析输入字符串中的多个Json对象
 /**
  * 解析输入的字符串，将其转换为RedisValue对象的集合。
@@ -7,21 +7,27 @@
 #include<memory>
 #include<cmath>
 #include<limits>
+#include<cstdint>
+#include<string_view>
 
 class RedisValueType;
+class QuickList;
+class CompactHash;
 
 // RedisValue 类定义
 class RedisValue{
 public:
     // 定义 RedisValue 支持的数据类型
     enum Type{
-        NUL,NUMBER,BOOL,STRING,ARRAY,OBJECT
+        NUL,NUMBER,BOOL,STRING,ARRAY,OBJECT,LIST,HASH
     };
     typedef std::vector<RedisValue> array; // 定义数组类型
     typedef std::map<std::string,RedisValue> object; // 定义对象类型
     // 构造函数
     RedisValue() noexcept;
     RedisValue(std::nullptr_t) noexcept;
+    RedisValue(int64_t value); // 整数编码，incr等命令原地修改，不经过字符串
+    RedisValue(double value); // 浮点数编码，incrbyfloat使用
     RedisValue(const std::string& value);
     RedisValue(std::string&& value);
     RedisValue(const char* value);
@@ -29,6 +35,8 @@ public:
     RedisValue(array&& values);
     RedisValue(const object& values);
     RedisValue(object && values);
+    RedisValue(QuickList && values); // 列表类型，元素分块连续存放
+    RedisValue(CompactHash && values); // 哈希类型，字段少时存放在紧凑数组中
 
     // 从具有 toJson 成员函数的类实例构造 RedisValue
     template<class T,class = decltype(&T::toJson)>
@@ -52,15 +60,24 @@ public:
     Type type() const;
     bool isNull() const{ return type()==NUL;}
     bool isNumber() const { return type()==NUMBER;}
+    bool isInteger() const; // 是否是整数编码的NUMBER
     bool isBoolean() const { return type()==BOOL;}
     bool isString() const { return type()==STRING; }
     bool isArray() const { return type() == ARRAY; }
     bool isObject() const { return type() == OBJECT; }
+    bool isList() const { return type() == LIST; }
+    bool isHash() const { return type() == HASH; }
 
     // 获取值的函数
     std::string& stringValue() ;
+    int64_t &integerValue() ; // 不是整数编码时返回一个无意义的静态值
+    double &doubleValue() ; // 不是浮点数编码时返回一个无意义的静态值
+    // 值作为Redis字符串时的内容：整数按十进制，浮点数按std::to_string，字符串原样返回，其他类型返回dump的结果
+    std::string toString() const;
     array& arrayItems() ;
     object &objectItems() ;
+    QuickList &listItems() ;
+    CompactHash &hashItems() ;
 
     // 重载 [] 操作符，用于访问数组元素和对象成员
     RedisValue & operator[] (size_t i) ;
@@ -74,10 +91,17 @@ public:
         return out;
     }
 
+    // 按dump的规则给字符串加上引号并转义，追加到out中
+    static void quoteString(const std::string &value, std::string &out);
+
     // 解析 JSON 文本的静态函数
     static RedisValue parse(const std::string&in, std::string& err);
     static RedisValue parse(const char* in, std::string& err);
 
+    // 把整个参数解析为int64或有限的double，有多余字符、溢出时返回false
+    static bool parseInteger(std::string_view in, int64_t &value);
+    static bool parseDouble(std::string_view in, double &value);
+
     // 解析多个 JSON 值的静态函数
     static std::vector<RedisValue> parseMulti(
         const std::string&in,
@@ -6,6 +6,8 @@
 #include<cassert>
 #include"Parse.h"
 #include"RedisValue.h"
+#include"QuickList.h"
+#include"CompactHash.h"
 #include"Dump.h"
 
 /*
@@ -19,11 +21,19 @@ protected:
     virtual bool less(const RedisValueType*other) const = 0;
     virtual void dump(std::string& out) const = 0;
     virtual std::string &stringValue() ;
+    virtual int64_t &integerValue() ;
+    virtual double &doubleValue() ;
     virtual RedisValue::array &arrayItems() ;
     virtual RedisValue::object &objectItems() ;
+    virtual QuickList &listItems() ;
+    virtual CompactHash &hashItems() ;
     virtual RedisValue& operator[] (size_t i) ;
     virtual RedisValue& operator[](const std::string &key) ;
     virtual ~RedisValueType(){}
+public:
+    // 两种数值编码之间比较时通过基类指针调用
+    virtual bool isInteger() const { return false; }
+    virtual double numberValue() const { return 0; }
 
 };
 
@@ -59,6 +69,31 @@ public:
     explicit RedisString(std::string&& value) : Value(std::move(value)) {}
 };
 
+// 整数编码的字符串，dump为JSON数字
+class RedisInteger final : public Value<RedisValue::NUMBER, int64_t>{
+    bool isInteger() const override { return true; }
+    int64_t &integerValue() override { return value; }
+    double numberValue() const override { return static_cast<double>(value); }
+    bool equals(const RedisValueType *other) const override {
+        return other->isInteger() ? value == static_cast<const RedisInteger *>(other)->value : numberValue() == other->numberValue();
+    }
+    bool less(const RedisValueType *other) const override {
+        return other->isInteger() ? value < static_cast<const RedisInteger *>(other)->value : numberValue() < other->numberValue();
+    }
+public:
+    explicit RedisInteger(int64_t value) : Value(value) {}
+};
+
+// 浮点数编码的字符串
+class RedisDouble final : public Value<RedisValue::NUMBER, double>{
+    double &doubleValue() override { return value; }
+    double numberValue() const override { return value; }
+    bool equals(const RedisValueType *other) const override { return value == other->numberValue(); }
+    bool less(const RedisValueType *other) const override { return value < other->numberValue(); }
+public:
+    explicit RedisDouble(double value) : Value(value) {}
+};
+
 class RedisList final : public Value<RedisValue::ARRAY, RedisValue::array>{
     RedisValue::array & arrayItems()  override{ return value;}
     RedisValue & operator[](size_t i)  override;
@@ -75,6 +110,18 @@ public:
     explicit RedisObject(RedisValue::object &&value)      : Value(std::move(value)) {} 
 };
 
+class RedisQuickList final : public Value<RedisValue::LIST, QuickList>{
+    QuickList &listItems() override { return value; }
+public:
+    explicit RedisQuickList(QuickList &&value) : Value(std::move(value)) {}
+};
+
+class RedisCompactHash final : public Value<RedisValue::HASH, CompactHash>{
+    CompactHash &hashItems() override { return value; }
+public:
+    explicit RedisCompactHash(CompactHash &&value) : Value(std::move(value)) {}
+};
+
 class RedisValueNull final: public Value<RedisValue::NUL,NullStruct>{
 public:
     RedisValueNull() : Value({}) {}
@@ -0,0 +1,669 @@
+#include "RespServer.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "RedisValue.h"
+
+RespServer::RespServer(RedisServer *redisServer, int port) : redisServer(redisServer), port(port) {}
+
+RespServer::~RespServer()
+{
+    stop();
+}
+
+/**
+ * 监听端口，启动事件循环线程。
+ *
+ * @return 监听成功返回true，端口被占用等情况返回false。
+ */
+bool RespServer::start()
+{
+    // 对端关闭后继续写入时不让SIGPIPE结束进程，writev会返回EPIPE
+    signal(SIGPIPE, SIG_IGN);
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0)
+    {
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(listenFd, SOMAXCONN) < 0)
+    {
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    loopThread = std::thread(&RespServer::eventLoop, this);
+    return true;
+}
+
+/**
+ * 通知事件循环退出，关闭所有连接和监听套接字。
+ */
+void RespServer::stop()
+{
+    if (loopThread.joinable())
+    {
+        stopped = true;
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+        loopThread.join();
+    }
+    while (!connections.empty())
+    {
+        closeConnection(connections.begin()->first);
+    }
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+        listenFd = -1;
+    }
+    if (wakeFd >= 0)
+    {
+        close(wakeFd);
+        wakeFd = -1;
+    }
+    if (epollFd >= 0)
+    {
+        close(epollFd);
+        epollFd = -1;
+    }
+}
+
+void RespServer::eventLoop()
+{
+    epoll_event events[RESP_MAX_EVENTS];
+    while (!stopped)
+    {
+        int count = epoll_wait(epollFd, events, RESP_MAX_EVENTS, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd)
+            {
+                return;
+            }
+            if (fd == listenFd)
+            {
+                acceptConnections();
+                continue;
+            }
+            auto itr = connections.find(fd);
+            if (itr == connections.end())
+            {
+                continue;
+            }
+            Connection &connection = *itr->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                closeConnection(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT)
+            {
+                if (!flushReplies(connection))
+                {
+                    closeConnection(fd);
+                    continue;
+                }
+                // 积压的回复发完后继续处理已读入但暂停执行的命令
+                if (connection.pendingBytes == 0)
+                {
+                    processInput(connection);
+                    if (connections.find(fd) == connections.end())
+                    {
+                        continue;
+                    }
+                }
+            }
+            if (events[i].events & EPOLLIN)
+            {
+                handleRead(connection);
+            }
+        }
+    }
+}
+
+void RespServer::acceptConnections()
+{
+    while (true)
+    {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            // EAGAIN表示已经没有等待的连接；其他错误（如文件描述符耗尽）留到下次再试
+            return;
+        }
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        std::unique_ptr<Connection> connection(new Connection());
+        connection->fd = fd;
+        connection->id = ++nextConnectionId;
+        Connection &added = *connection;
+        connections[fd] = std::move(connection);
+        updateEvents(added);
+    }
+}
+
+/**
+ * 读取连接上到达的数据并处理。对端关闭或出错时关闭连接。
+ */
+void RespServer::handleRead(Connection &connection)
+{
+    std::string &input = connection.input;
+    // 已处理的数据超过一半时再整理缓冲区，避免每条命令都移动剩余数据
+    if (connection.parsed > 0 && connection.parsed * 2 >= input.size())
+    {
+        input.erase(0, connection.parsed);
+        connection.parsed = 0;
+    }
+    size_t oldSize = input.size();
+    input.resize(oldSize + RESP_READ_BUFFER_SIZE);
+    ssize_t bytesRead = read(connection.fd, &input[oldSize], RESP_READ_BUFFER_SIZE);
+    if (bytesRead <= 0)
+    {
+        input.resize(oldSize);
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+            return;
+        }
+        closeConnection(connection.fd);
+        return;
+    }
+    input.resize(oldSize + bytesRead);
+    processInput(connection);
+}
+
+/**
+ * 依次解析并执行缓冲区中所有完整的命令，然后把这一批回复一起发送。
+ * 待发送的回复太多时暂停执行，等回复发出后再继续，防止不读回复的客户端占满内存。
+ */
+void RespServer::processInput(Connection &connection)
+{
+    std::string error;
+    while (!connection.closing && connection.pendingBytes < RESP_MAX_PENDING_OUTPUT)
+    {
+        ParseResult result = parseCommand(connection, error);
+        if (result == PARSE_INCOMPLETE)
+        {
+            break;
+        }
+        if (result == PARSE_ERROR)
+        {
+            addReply(connection, "-ERR Protocol error: " + error + "\r\n");
+            connection.closing = true;
+            break;
+        }
+        if (!connection.tokens.empty())
+        {
+            executeCommand(connection);
+        }
+    }
+    if (connection.parsed == connection.input.size())
+    {
+        connection.input.clear();
+        connection.parsed = 0;
+    }
+    if (!flushReplies(connection) || (connection.closing && connection.pendingBytes == 0))
+    {
+        closeConnection(connection.fd);
+        return;
+    }
+    updateEvents(connection);
+}
+
+/**
+ * 从input的parsed位置解析一条命令，connection.tokens中的参数直接指向input，不拷贝。
+ * 命令不完整时丢弃已解析的参数，下次从命令开头重新解析；执行完之前input不会被修改，视图一直有效。
+ *
+ * @param error 协议错误时写入错误描述。
+ * @return 解析结果，只有PARSE_OK时parsed才会前进。
+ */
+RespServer::ParseResult RespServer::parseCommand(Connection &connection, std::string &error)
+{
+    const std::string &input = connection.input;
+    size_t position = connection.parsed;
+    connection.tokens.clear();
+    if (position >= input.size())
+    {
+        return PARSE_INCOMPLETE;
+    }
+    // 解析长度行中的整数，格式错误返回false
+    auto parseNumber = [&input](size_t start, size_t end, long long &value)
+    {
+        if (start >= end || end - start > 18)
+        {
+            return false;
+        }
+        value = 0;
+        bool negative = input[start] == '-';
+        for (size_t i = negative ? start + 1 : start; i < end; i++)
+        {
+            if (input[i] < '0' || input[i] > '9')
+            {
+                return false;
+            }
+            value = value * 10 + (input[i] - '0');
+        }
+        value = negative ? -value : value;
+        return end > (negative ? start + 1 : start);
+    };
+
+    if (input[position] != '*')
+    {
+        // 内联命令：一行按空白分割
+        size_t end = input.find('\n', position);
+        if (end == std::string::npos)
+        {
+            if (input.size() - position > RESP_MAX_INLINE_LENGTH)
+            {
+                error = "too big inline request";
+                return PARSE_ERROR;
+            }
+            return PARSE_INCOMPLETE;
+        }
+        size_t start = position;
+        while (start < end)
+        {
+            while (start < end && std::isspace(static_cast<unsigned char>(input[start])))
+            {
+                start++;
+            }
+            size_t tokenEnd = start;
+            while (tokenEnd < end && !std::isspace(static_cast<unsigned char>(input[tokenEnd])))
+            {
+                tokenEnd++;
+            }
+            if (tokenEnd > start)
+            {
+                connection.tokens.push_back(std::string_view(input).substr(start, tokenEnd - start));
+            }
+            start = tokenEnd;
+        }
+        connection.parsed = end + 1;
+        return PARSE_OK;
+    }
+
+    size_t end = input.find("\r\n", position);
+    if (end == std::string::npos)
+    {
+        if (input.size() - position > RESP_MAX_INLINE_LENGTH)
+        {
+            error = "too big mbulk count string";
+            return PARSE_ERROR;
+        }
+        return PARSE_INCOMPLETE;
+    }
+    long long count = 0;
+    if (!parseNumber(position + 1, end, count) || count > RESP_MAX_MULTIBULK_LENGTH)
+    {
+        error = "invalid multibulk length";
+        return PARSE_ERROR;
+    }
+    position = end + 2;
+    for (long long i = 0; i < count; i++)
+    {
+        if (position >= input.size())
+        {
+            return PARSE_INCOMPLETE;
+        }
+        if (input[position] != '$')
+        {
+            error = std::string("expected '$', got '") + input[position] + "'";
+            return PARSE_ERROR;
+        }
+        end = input.find("\r\n", position);
+        if (end == std::string::npos)
+        {
+            if (input.size() - position > RESP_MAX_INLINE_LENGTH)
+            {
+                error = "too big bulk count string";
+                return PARSE_ERROR;
+            }
+            return PARSE_INCOMPLETE;
+        }
+        long long length = 0;
+        if (!parseNumber(position + 1, end, length) || length < 0 || length > RESP_MAX_BULK_LENGTH)
+        {
+            error = "invalid bulk length";
+            return PARSE_ERROR;
+        }
+        position = end + 2;
+        if (input.size() - position < static_cast<size_t>(length) + 2)
+        {
+            return PARSE_INCOMPLETE;
+        }
+        connection.tokens.push_back(std::string_view(input).substr(position, static_cast<size_t>(length)));
+        position += length + 2;
+    }
+    connection.parsed = position;
+    return PARSE_OK;
+}
+
+/**
+ * 执行connection.tokens中的命令，回复放入发送队列。
+ * 命令名不区分大小写，转换为小写后交给RedisServer，其余参数原样传递。
+ */
+void RespServer::executeCommand(Connection &connection)
+{
+    TokenBuffer &tokens = connection.tokens;
+    RedisServer::lowerCommandName(tokens, connection.command);
+    std::string_view command = tokens.front();
+    if (command == "quit" || command == "exit")
+    {
+        addReply(connection, "+OK\r\n");
+        connection.closing = true;
+        return;
+    }
+    if (command == "hello")
+    {
+        hello(connection);
+        return;
+    }
+    RedisServer::SessionScope scope(connection.session);
+    std::string encoded;
+    if (command == "exec")
+    {
+        // 事务的每条结果单独转换，嵌套的数组才能保持结构
+        transactionReplies.clear();
+        std::string reply = redisServer->handleCommand(tokens, &transactionReplies);
+        if (!reply.empty())
+        {
+            encodeReply(reply, connection.protocol, encoded);
+        }
+        else
+        {
+            encoded = "*" + std::to_string(transactionReplies.size()) + "\r\n";
+            for (const std::string &item : transactionReplies)
+            {
+                encodeReply(item, connection.protocol, encoded);
+            }
+        }
+    }
+    else
+    {
+        encodeReply(redisServer->handleCommand(tokens), connection.protocol, encoded);
+    }
+    addReply(connection, std::move(encoded));
+}
+
+/**
+ * HELLO [protover]：协商协议版本，返回服务器信息。版本3之后空值按RESP3编码，服务器信息以映射返回。
+ */
+void RespServer::hello(Connection &connection)
+{
+    TokenBuffer &tokens = connection.tokens;
+    if (tokens.size() > 1)
+    {
+        if (tokens[1] != "2" && tokens[1] != "3")
+        {
+            addReply(connection, "-NOPROTO unsupported protocol version\r\n");
+            return;
+        }
+        connection.protocol = tokens[1][0] - '0';
+    }
+    const std::vector<std::pair<std::string, std::string>> fields = {
+        {"server", "redis"},
+        {"version", "7.0.0"},
+        {"proto", std::to_string(connection.protocol)},
+        {"id", std::to_string(connection.id)},
+        {"mode", "standalone"},
+        {"role", "master"}};
+    std::string encoded = (connection.protocol == 3 ? "%" : "*") + std::to_string(connection.protocol == 3 ? fields.size() + 1 : (fields.size() + 1) * 2) + "\r\n";
+    for (auto &field : fields)
+    {
+        encodeBulk(field.first, encoded);
+        if (field.first == "proto" || field.first == "id")
+        {
+            encoded += ":" + field.second + "\r\n";
+        }
+        else
+        {
+            encodeBulk(field.second, encoded);
+        }
+    }
+    encodeBulk("modules", encoded);
+    encoded += "*0\r\n";
+    addReply(connection, std::move(encoded));
+}
+
+void RespServer::addReply(Connection &connection, std::string reply)
+{
+    connection.pendingBytes += reply.size();
+    connection.replies.emplace_back(std::move(reply));
+}
+
+/**
+ * 用writev把队列中的回复尽量一次发出，每次最多IOV_MAX段。
+ * 套接字缓冲区满时保留剩余部分，等EPOLLOUT后继续。
+ *
+ * @return 连接出错返回false。
+ */
+bool RespServer::flushReplies(Connection &connection)
+{
+    std::vector<std::string> &replies = connection.replies;
+    iovec vectors[IOV_MAX];
+    while (connection.replyIndex < replies.size())
+    {
+        int count = 0;
+        for (size_t i = connection.replyIndex; i < replies.size() && count < IOV_MAX; i++)
+        {
+            size_t offset = i == connection.replyIndex ? connection.replyOffset : 0;
+            vectors[count].iov_base = const_cast<char *>(replies[i].data()) + offset;
+            vectors[count].iov_len = replies[i].size() - offset;
+            count++;
+        }
+        ssize_t written = writev(connection.fd, vectors, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection.pendingBytes -= written;
+        // 跳过已完整发送的回复
+        size_t remaining = written;
+        while (remaining > 0)
+        {
+            size_t left = replies[connection.replyIndex].size() - connection.replyOffset;
+            if (remaining < left)
+            {
+                connection.replyOffset += remaining;
+                break;
+            }
+            remaining -= left;
+            connection.replyIndex++;
+            connection.replyOffset = 0;
+        }
+    }
+    replies.clear();
+    connection.replyIndex = 0;
+    connection.replyOffset = 0;
+    return true;
+}
+
+/**
+ * 根据连接状态更新在epoll中注册的事件：有未发出的回复时关注可写，
+ * 积压的回复过多时暂不关注可读。
+ */
+void RespServer::updateEvents(Connection &connection)
+{
+    uint32_t events = 0;
+    if (connection.pendingBytes < RESP_MAX_PENDING_OUTPUT && !connection.closing)
+    {
+        events |= EPOLLIN;
+    }
+    if (connection.pendingBytes > 0)
+    {
+        events |= EPOLLOUT;
+    }
+    if (events == connection.events)
+    {
+        return;
+    }
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = connection.fd;
+    epoll_ctl(epollFd, connection.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+void RespServer::closeConnection(int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
+
+/**
+ * 把命令的文本结果转换为RESP：
+ * OK等状态为+，"(integer) n"为:，"(nil)"为空值，errorReply生成的错误回复为-，
+ * "1) "开头的多行结果为数组，带引号的值为批量字符串，其余文本为状态（含换行时为批量字符串）。
+ */
+void RespServer::encodeReply(const std::string &reply, int protocol, std::string &out)
+{
+    if (reply.compare(0, 10, "(integer) ") == 0)
+    {
+        out += ":" + reply.substr(10) + "\r\n";
+    }
+    else if (reply == "(nil)")
+    {
+        encodeNull(protocol, out);
+    }
+    else if (reply == "(empty list or set)" || reply == "this database is empty!")
+    {
+        out += "*0\r\n";
+    }
+    else if (reply.compare(0, sizeof(ERROR_REPLY_PREFIX) - 1, ERROR_REPLY_PREFIX) == 0)
+    {
+        // errorReply生成的错误回复，前缀后面是错误类型和错误信息
+        std::string message = reply.substr(sizeof(ERROR_REPLY_PREFIX) - 1);
+        std::replace(message.begin(), message.end(), '\r', ' ');
+        std::replace(message.begin(), message.end(), '\n', ' ');
+        out += "-" + message + "\r\n";
+    }
+    else if (reply.compare(0, 3, "1) ") == 0)
+    {
+        // 每行以"序号) "开头；不以下一个序号开头的行属于上一个元素（值中含有换行）
+        std::vector<std::string> items;
+        size_t start = 0;
+        while (start <= reply.size())
+        {
+            size_t end = reply.find('\n', start);
+            if (end == std::string::npos)
+            {
+                end = reply.size();
+            }
+            std::string line = reply.substr(start, end - start);
+            std::string prefix = std::to_string(items.size() + 1) + ") ";
+            if (line.compare(0, prefix.size(), prefix) == 0)
+            {
+                items.emplace_back(line.substr(prefix.size()));
+            }
+            else
+            {
+                items.back() += "\n" + line;
+            }
+            start = end + 1;
+        }
+        out += "*" + std::to_string(items.size()) + "\r\n";
+        for (const std::string &item : items)
+        {
+            encodeItem(item, protocol, out);
+        }
+    }
+    else if (reply.size() >= 2 && reply.front() == '"' && reply.back() == '"')
+    {
+        encodeItem(reply, protocol, out);
+    }
+    else if (reply.find_first_of("\r\n") != std::string::npos)
+    {
+        encodeBulk(reply, out);
+    }
+    else
+    {
+        out += "+" + reply + "\r\n";
+    }
+}
+
+/**
+ * 转换数组中的一个元素或单个值：带引号的按转义规则还原为字符串，其余原样作为批量字符串。
+ */
+void RespServer::encodeItem(const std::string &item, int protocol, std::string &out)
+{
+    if (item == "(nil)")
+    {
+        encodeNull(protocol, out);
+        return;
+    }
+    if (item.compare(0, 10, "(integer) ") == 0)
+    {
+        out += ":" + item.substr(10) + "\r\n";
+        return;
+    }
+    if (item.size() >= 2 && item.front() == '"' && item.back() == '"')
+    {
+        // 值由RedisValue::dump加上引号和转义，解析失败（如keys直接加引号）时去掉两端的引号
+        std::string error;
+        RedisValue value = RedisValue::parse(item, error);
+        if (error.empty() && value.type() == RedisValue::STRING)
+        {
+            encodeBulk(value.stringValue(), out);
+        }
+        else
+        {
+            encodeBulk(item.substr(1, item.size() - 2), out);
+        }
+        return;
+    }
+    encodeBulk(item, out);
+}
+
+void RespServer::encodeBulk(const std::string &value, std::string &out)
+{
+    out += "$" + std::to_string(value.size()) + "\r\n";
+    out += value;
+    out += "\r\n";
+}
+
+void RespServer::encodeNull(int protocol, std::string &out)
+{
+    out += protocol == 3 ? "_\r\n" : "$-1\r\n";
+}
@@ -0,0 +1,92 @@
+#ifndef RESP_SERVER_H
+#define RESP_SERVER_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "RedisServer.h"
+#define DEFAULT_RESP_PORT 6379 //RESP监听端口，和Redis相同，redis-cli、redis-benchmark可以直接连接
+#define RESP_READ_BUFFER_SIZE (16 * 1024) //每次read最多读取的字节数
+#define RESP_MAX_EVENTS 256 //每次epoll_wait最多返回的事件数
+#define RESP_MAX_INLINE_LENGTH (64 * 1024) //内联命令和长度行的最大长度
+#define RESP_MAX_BULK_LENGTH (512LL * 1024 * 1024) //单个参数的最大长度
+#define RESP_MAX_MULTIBULK_LENGTH (1024 * 1024) //单条命令的最大参数个数
+#define RESP_MAX_PENDING_OUTPUT (64 * 1024 * 1024) //待发送的回复超过这个大小时暂停处理该连接的命令
+
+/*
+    RESP监听器：在ZeroMQ的RPC之外，用标准的RESP协议（RESP2，HELLO 3后为RESP3）提供服务。
+    单个线程用epoll监听所有连接，套接字都是非阻塞的。
+    请求增量解析：一次读到的数据里有几条完整的命令就执行几条，不完整的部分留到下次读取，
+    支持*参数个数 $长度 内容的多条批量格式，也支持redis-cli手工输入的内联格式。
+    参数不拷贝，以指向读缓冲区的视图交给RedisServer::handleCommand执行，和RPC共用同一套解析器；
+    文本形式的结果再转换为RESP类型（+状态、-错误、:整数、$批量字符串、*数组），错误由errorReply加上统一的前缀标记。
+    同一连接上流水线发来的命令按顺序执行，回复先放入队列，处理完这一批后用writev一次发出。
+*/
+class RespServer
+{
+private:
+    struct Connection
+    {
+        int fd;
+        uint64_t id; //HELLO返回的连接编号
+        int protocol = 2; //HELLO协商的协议版本
+        std::string input; //已读取的数据
+        size_t parsed = 0; //input中已经解析并执行的位置
+        TokenBuffer tokens; //当前命令的参数，指向input中的字节
+        std::string command; //命令名含大写字母时存放小写的命令名，tokens[0]指向它
+        std::vector<std::string> replies; //等待发送的回复
+        size_t replyIndex = 0; //replies中已完整发送的回复数
+        size_t replyOffset = 0; //replies[replyIndex]已发送的字节数
+        size_t pendingBytes = 0; //还没发送的字节数
+        uint32_t events = 0; //当前在epoll中注册的事件
+        bool closing = false; //发送完回复后关闭连接
+        RedisServer::Session session; //连接的当前数据库和事务状态
+    };
+
+    enum ParseResult
+    {
+        PARSE_OK,         //解析出一条完整的命令
+        PARSE_INCOMPLETE, //数据不完整，等待更多数据
+        PARSE_ERROR       //协议错误，回复错误后关闭连接
+    };
+
+    RedisServer *redisServer;
+    int port;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1; //用于通知事件循环退出的eventfd
+    std::atomic<bool> stopped{false};
+    uint64_t nextConnectionId = 0;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<std::string> transactionReplies; //exec的各条结果
+    std::thread loopThread;
+
+private:
+    void eventLoop();
+    void acceptConnections();
+    void handleRead(Connection &connection);
+    void processInput(Connection &connection); //解析并执行缓冲区中所有完整的命令，然后发送回复
+    ParseResult parseCommand(Connection &connection, std::string &error);
+    void executeCommand(Connection &connection);
+    void hello(Connection &connection);
+    bool flushReplies(Connection &connection); //连接出错时返回false
+    void updateEvents(Connection &connection);
+    void closeConnection(int fd);
+    void addReply(Connection &connection, std::string reply);
+    static void encodeReply(const std::string &reply, int protocol, std::string &out); //把文本结果转换为RESP
+    static void encodeItem(const std::string &item, int protocol, std::string &out);
+    static void encodeBulk(const std::string &value, std::string &out);
+    static void encodeNull(int protocol, std::string &out);
+
+public:
+    RespServer(RedisServer *redisServer, int port = DEFAULT_RESP_PORT);
+    ~RespServer();
+    bool start(); //监听端口并启动事件循环线程，失败返回false
+    void stop();
+};
+
+#endif
@@ -7,68 +7,26 @@
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
 using namespace std;
 
-/*
-    采用vector<char> 因为是一个动态数组，可以存储任意数量的 char 元素，、
-    并且可以动态地增加或减少元素。这使得 std::vector<char> 非常适合用作字节流的缓冲区
-
-    然而，std::vector<char> 并没有提供一些字节流操作所需要的功能，
-    例如移动当前位置、查找特定的字节、检查是否已经到达末尾等。
-    因此，StreamBuffer 类继承自 std::vector<char>，并添加了这些功能。
-*/
-
-class StreamBuffer : public vector<char>
-{
-public:
-    StreamBuffer() : m_curpos(0) {}
-
-    StreamBuffer(const char *in, size_t len)
-    {
-        m_curpos = 0;
-        insert(begin(), in, in + len);
-    }
-
-    ~StreamBuffer() {};
-
-    void reset() { m_curpos = 0; }
-
-    const char *data() { return &(*this)[0]; } // 获取缓冲区的数据
-
-    const char *current()
-    {
-        return &(*this)[m_curpos];
-    } // 获取当前位置的数据
-
-    void offset(int offset) { m_curpos += offset; } // 移动当前位置
-
-    bool is_eof() { return m_curpos >= size(); } // 检查是否已经到达末尾
-
-    void input(const char *in, size_t len) // 输入字符数组
-    {
-        insert(end(), in, in + len);
-    }
-
-    int findc(char c) // 在缓冲区中查找特定的字节
-    {
-        iterator itr = find(begin() + m_curpos, end(), c);
-        if (itr != end())
-        {
-            return itr - (begin() + m_curpos);
-        }
-        return -1;
-    }
-
-private:
-    unsigned int m_curpos; // 当前字节流的位置
-};
-
 /*
     序列号和反序列号的类
     用于将数据序列化为字节流，或者将字节流反序列化为数据
 
     存储数据：写入数据长度和数据本身
     读取数据：读取数据长度，然后读取数据本身
+    字符串的长度以变长整数（varint，每字节7位，最高位表示后面还有字节）编码，小于128字节的字符串只占1字节，
+    长度不再受16位的限制。
+
+    写入时数据直接追加到内部的vector<char>中，clear只清空内容不释放容量，同一个对象可以反复使用，
+    不会为每个字段分配临时内存。
+    读取时可以用Serializer(data, len)构造一个只读视图，直接读取外部缓冲区（例如zmq消息），不拷贝数据；
+    视图不拥有数据，调用方需保证外部缓冲区在读取期间有效。
+    读取为std::string_view时直接指向缓冲区中的字节，不拷贝，有效期同样取决于缓冲区。
+    std::vector先写入元素个数（varint），再依次写入每个元素。
 */
 
 class Serializer
@@ -81,62 +39,80 @@ public:
         LittleEndian = 1
     };
 
-    Serializer() { m_byteorder = LittleEndian; }
+    Serializer() : m_byteorder(LittleEndian) {}
 
-    Serializer(StreamBuffer dev, int byteorder = LittleEndian)
-    {
-        m_byteorder = byteorder;
-        m_iodevice = dev;
-    }
+    /**
+     * @brief 构造只读视图，读取外部缓冲区中的数据，不拷贝。
+     * @param data 外部缓冲区。
+     * @param len 外部缓冲区的长度。
+     * @param byteorder 数据的字节序。
+     */
+    Serializer(const char *data, size_t len, int byteorder = LittleEndian)
+        : m_byteorder(byteorder), m_view(data), m_viewsize(len) {}
 
     void reset()
     {
-        m_iodevice.reset();
+        m_curpos = 0;
     }
 
-    int size()
+    int size() const
     {
-        return m_iodevice.size();
+        return m_view != nullptr ? m_viewsize : m_buffer.size();
     }
 
-    void skip_raw_date(int k)
+    // 当前位置之后还未读取的字节数
+    int remaining() const
     {
-        m_iodevice.offset(k);
+        return size() - m_curpos;
     }
 
-    const char *data()
+    void skip_raw_date(int k)
     {
-        return m_iodevice.data();
+        m_curpos += k;
     }
-    void byte_orser(char *in, int len)
+
+    const char *data() const
     {
-        if (m_byteorder == BigEndian)
-        {
-            reverse(in, in + len); // 大端的化直接反转
-        }
+        return m_view != nullptr ? m_view : m_buffer.data();
     }
+
     /**
      * @brief 将指定数据写入序列化器。
      * @param in 输入的字符数组。
      * @param len 输入字符数组的长度。
      */
-    void write_raw_data(char *in, int len)
+    void write_raw_data(const char *in, int len)
     {
-        m_iodevice.input(in, len);
-        m_iodevice.offset(len);
+        m_buffer.insert(m_buffer.end(), in, in + len);
+        m_curpos += len;
     }
 
-    const char *current()
+    const char *current() const
+    {
+        return data() + m_curpos;
+    }
+
+    /**
+     * @brief 和外部的vector交换写入的数据，用于把写好的数据转交出去而不拷贝。
+     *        交换后解除只读视图，读取位置归零。
+     * @param other 交换的vector。
+     */
+    void swap_buffer(std::vector<char> &other)
     {
-        return m_iodevice.current();
+        m_buffer.swap(other);
+        m_view = nullptr;
+        m_viewsize = 0;
+        reset();
     }
 
     /**
-     * @brief 清空序列化器中的数据。
+     * @brief 清空序列化器中的数据，保留已分配的容量，并解除只读视图。
      */
     void clear()
     {
-        m_iodevice.clear();
+        m_buffer.clear();
+        m_view = nullptr;
+        m_viewsize = 0;
         reset();
     }
     /**
@@ -147,13 +123,23 @@ public:
     template <typename T>
     void output_type(T &t);
 
+    template <typename T>
+    void output_type(std::vector<T> &t);
+
     /**
      * @brief 输入指定类型的数据。
      * @tparam T 要输入的数据类型。
      * @param t 要输入的数据。
      */
     template <typename T>
-    void input_type(T t);
+    void input_type(const T &t);
+
+    template <typename T>
+    void input_type(const std::vector<T> &t);
+
+    void input_type(const std::string &in);
+    void input_type(std::string_view in);
+    void input_type(const char *in);
     /**
      * @brief 重载运算符>>，用于从序列化器中读取数据。
      * @tparam T 要读取的数据类型。
@@ -174,92 +160,243 @@ public:
      * @return 当前序列化器对象的引用。
      */
     template <typename T>
-    Serializer &operator<<(T i)
+    Serializer &operator<<(const T &i)
+    {
+        input_type(i);
+        return *this;
+    }
+
+    Serializer &operator<<(const char *i)
     {
         input_type(i);
         return *this;
     }
 
 private:
-    int m_byteorder;         // 字节序
-    StreamBuffer m_iodevice; // 字节流缓冲区
+    // 按字节数选择同样大小的无符号整数，用于在寄存器中交换字节序
+    template <size_t N>
+    struct unsigned_of;
+
+    // 数据的字节序和本机不同时交换字节序
+    template <typename T>
+    T byte_orser(T value) const;
+
+    bool readable(size_t len) const { return m_curpos <= static_cast<size_t>(size()) && len <= size() - m_curpos; }
+
+    void write_varint(uint64_t value); // 写入变长整数
+    bool read_varint(uint64_t &value); // 读取变长整数，数据不完整或超过64位时返回false
+    bool read_bytes(std::string_view &out); // 读取长度和内容，返回指向缓冲区的视图
+
+private:
+    int m_byteorder;               // 字节序
+    std::vector<char> m_buffer;    // 写入的数据
+    const char *m_view = nullptr;  // 只读视图指向的外部数据，为空时读取m_buffer
+    size_t m_viewsize = 0;         // 只读视图的长度
+    size_t m_curpos = 0;           // 当前读取位置
+};
+
+template <>
+struct Serializer::unsigned_of<1>
+{
+    typedef uint8_t type;
+};
+template <>
+struct Serializer::unsigned_of<2>
+{
+    typedef uint16_t type;
+};
+template <>
+struct Serializer::unsigned_of<4>
+{
+    typedef uint32_t type;
+};
+template <>
+struct Serializer::unsigned_of<8>
+{
+    typedef uint64_t type;
 };
 
+template <typename T>
+inline T Serializer::byte_orser(T value) const
+{
+    static_assert(std::is_arithmetic<T>::value, "Serializer only supports arithmetic types and strings");
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    const int hostorder = BigEndian;
+#else
+    const int hostorder = LittleEndian;
+#endif
+    if constexpr (sizeof(T) == 1)
+    {
+        return value;
+    }
+    else
+    {
+        if (m_byteorder == hostorder)
+        {
+            return value;
+        }
+        // 借助同样大小的整数完成交换，编译后只是寄存器中的bswap指令
+        typename unsigned_of<sizeof(T)>::type bits;
+        memcpy(&bits, &value, sizeof(T));
+        if constexpr (sizeof(T) == 2)
+        {
+            bits = __builtin_bswap16(bits);
+        }
+        else if constexpr (sizeof(T) == 4)
+        {
+            bits = __builtin_bswap32(bits);
+        }
+        else
+        {
+            bits = __builtin_bswap64(bits);
+        }
+        memcpy(&value, &bits, sizeof(T));
+        return value;
+    }
+}
+
 template <typename T>
 inline void Serializer::output_type(T &t)
 {
-    int len = sizeof(T);
-    char *d = new char[len];
-    if (!m_iodevice.is_eof())
+    if (!readable(sizeof(T)))
+    {
+        m_curpos = size(); // 数据不完整，之后的读取都失败
+        return;
+    }
+    T value;
+    memcpy(&value, current(), sizeof(T));
+    m_curpos += sizeof(T);
+    t = byte_orser(value);
+}
+inline void Serializer::write_varint(uint64_t value)
+{
+    char bytes[10];
+    int len = 0;
+    while (value >= 0x80)
+    {
+        bytes[len++] = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    bytes[len++] = static_cast<char>(value);
+    m_buffer.insert(m_buffer.end(), bytes, bytes + len);
+}
+
+inline bool Serializer::read_varint(uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (!readable(1))
+        {
+            return false;
+        }
+        uint8_t byte = static_cast<uint8_t>(*current());
+        m_curpos++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool Serializer::read_bytes(std::string_view &out)
+{
+    uint64_t len = 0;
+    if (!read_varint(len) || !readable(len))
     {
-        memcpy(d, m_iodevice.current(), len);
-        m_iodevice.offset(len);
-        byte_orser(d, len);
-        t = *reinterpret_cast<T *>(&d[0]);
+        m_curpos = size(); // 数据不完整，之后的读取都失败
+        return false;
     }
-    delete[] d;
+    out = std::string_view(current(), len);
+    m_curpos += len;
+    return true;
 }
+
 template <>
 inline void Serializer::output_type(std::string &in)
 {
-    int marklen = sizeof(uint16_t); // 读取长度
-
-    char *d = new char[marklen];
-    memcpy(d, m_iodevice.current(), marklen);       // 将字节流的数据的两个字节拷贝到d中
-    int len = *reinterpret_cast<uint16_t *>(&d[0]); // 取出长度
-    byte_orser(d, marklen);
-    m_iodevice.offset(marklen); // 将字节流的位置向后移动两个字节
-    delete d;
-    if (len == 0)
+    std::string_view bytes;
+    if (read_bytes(bytes))
+    {
+        in.assign(bytes.data(), bytes.size()); // 输入到in中
+    }
+}
+
+/**
+ * @brief 读取字符串但不拷贝，结果指向缓冲区，缓冲区失效后不能再使用。
+ * @param in 指向字符串内容的视图。
+ */
+template <>
+inline void Serializer::output_type(std::string_view &in)
+{
+    read_bytes(in);
+}
+
+/**
+ * @brief 读取vector，元素个数超过剩余数据时视为数据不完整。
+ * @param in 输出的vector，原有内容被替换。
+ */
+template <typename T>
+inline void Serializer::output_type(std::vector<T> &in)
+{
+    uint64_t count = 0;
+    in.clear();
+    if (!read_varint(count) || count > static_cast<uint64_t>(remaining()))
+    {
+        m_curpos = size(); // 数据不完整，之后的读取都失败
         return;
+    }
+    in.resize(count);
+    for (T &item : in)
+    {
+        output_type(item);
+    }
+}
 
-    in.insert(in.begin(), m_iodevice.current(), m_iodevice.current() + len); // 输入到in中
-    m_iodevice.offset(len);
+template <typename T>
+inline void Serializer::input_type(const std::vector<T> &in)
+{
+    write_varint(in.size());
+    for (const T &item : in)
+    {
+        input_type(item);
+    }
 }
 
 template <typename T>
-inline void Serializer::input_type(T t)
+inline void Serializer::input_type(const T &t)
 {
-    // 求出放入缓存区数据的长度
-    int len = sizeof(T);
-    char *d = new char[len];
-    const char *p = reinterpret_cast<const char *>(&t);
-    memcpy(d, p, len);
-    byte_orser(d, len);
-    m_iodevice.input(d, len); // 将d中的数据输入到字节流中
-    delete[] d;
+    T value = byte_orser(t);
+    const char *p = reinterpret_cast<const char *>(&value);
+    m_buffer.insert(m_buffer.end(), p, p + sizeof(T)); // 直接追加到缓冲区
 }
 
 /**
  * @brief 输入字符串到序列化器中。
  * @param in 要输入的字符串。
  */
-template <>
-inline void Serializer::input_type(std::string in)
+inline void Serializer::input_type(const std::string &in)
 {
-    // 先将字符串的长度输入到字节流中
-    uint16_t len = in.size();
-    char *p = reinterpret_cast<char *>(&len);
-    byte_orser(p, sizeof(uint16_t));
-    m_iodevice.input(p, sizeof(uint16_t));
-    if (len == 0)
-        return;
+    input_type(std::string_view(in));
+}
 
+inline void Serializer::input_type(std::string_view in)
+{
+    // 先将字符串的长度输入到字节流中
+    write_varint(in.size());
     // 再将字符串的数据输入到字节流中
-    char *d = new char[len];
-    memcpy(d, in.c_str(), len); // 将字符串的数据拷贝到d中
-    m_iodevice.input(d, len);
-    delete[] d;
+    m_buffer.insert(m_buffer.end(), in.data(), in.data() + in.size());
 }
 
 /**
  * @brief Inputs a null-terminated string into the serializer.
  * @param in The null-terminated string to input.
  */
-template <>
 inline void Serializer::input_type(const char *in)
 {
-    input_type<std::string>(std::string(in)); // 调用input_type<std::string>函数
+    input_type(std::string_view(in));
 }
 
 #endif
\ No newline at end of file
@@ -6,263 +6,481 @@
 #include<random>
 #include<cstring>
 #include<string>
-#include<fstream>
-#include<mutex>
+#include<atomic>
+#include<thread>
+#include<cstdint>
+#include<new>
+#include<utility>
 #include"global.h"
+#include"EpochManager.h"
+#include"SkipListArena.h"
+#include"HashIndex.h"
 #include"RedisValue/RedisValue.h"
 #define MAX_SKIP_LIST_LEVEL 32
 #define  PROBABILITY_FACTOR 0.25
 #define  DELIMITER ":"
 #define SAVE_PATH "data_file"
+#define RECLAIM_THRESHOLD 64 //累计摘除这么多节点后尝试回收一次
 //定义跳表节点，包含key，value和指向当前层下一个节点的指针数组
 /*
-
+    各层的指针紧跟在节点对象之后，和节点分配在同一块内存中，数组长度等于节点的层高。
+    指针的最低位作为删除标记：某一层的forward被打上标记，表示该节点在这一层已被逻辑删除。
+    节点的key在插入后不再修改，value的并发修改需要调用方自行协调。
 */
 template<typename Key,typename Value>
 class SkipListNode{
 public:
+    typedef std::atomic<SkipListNode<Key,Value>*> Link;
     Key key;
     Value value;
-    std::vector<std::shared_ptr<SkipListNode<Key,Value>>>forward; // 指向下一个节点的指针数组
-    SkipListNode(Key key,Value value,int maxLevel=MAX_SKIP_LIST_LEVEL):
-    key(key),value(value),forward(maxLevel,nullptr){}
-    
+    int level; //节点层高
+    std::atomic<bool> fullyLinked{false}; //所有层都链接完成后节点才对外可见
+    SkipListNode<Key,Value>* retiredNext=nullptr; //待回收链表中的下一个节点
+    uint64_t retireEpoch=0; //节点被摘除时的纪元
+    SkipListNode(const Key& key,const Value& value,int maxLevel=MAX_SKIP_LIST_LEVEL):
+    key(key),value(value),level(maxLevel){
+        Link* tower=reinterpret_cast<Link*>(this+1);
+        for(int i=0;i<maxLevel;i++){
+            new(&tower[i]) Link(nullptr);
+        }
+    }
+    SkipListNode(const SkipListNode&)=delete;
+    SkipListNode& operator=(const SkipListNode&)=delete;
+    Link& forward(int i){ return reinterpret_cast<Link*>(this+1)[i]; } // 指向第i层下一个节点的指针
+    //层高为level的节点连同各层指针所需的字节数
+    static size_t allocationSize(int level){ return sizeof(SkipListNode)+level*sizeof(Link); }
 };
 
+/*
+    无锁并发跳表
+    插入和删除通过CAS修改各层指针，删除时先从高层到低层打删除标记，再物理摘除；
+    查找不加锁也不做任何CAS，遍历时直接跳过被标记的节点，是wait-free的；
+    被摘除的节点先放入待回收链表，由EpochManager确认没有线程再引用后才释放。
+    searchItem返回的节点指针只在调用方持有EpochGuard期间有效。
+    可选地在跳表前面维护一个哈希索引，searchItem直接查索引，有序遍历仍然走跳表。
+*/
 template<typename Key, typename Value>
 class SkipList{
 private:
-    int currentLevel; //当前跳表的最大层数
-    std::shared_ptr<SkipListNode<Key,Value>>head; //头节点
-    std::mt19937 generator{ std::random_device{}()}; //随机数生成器
-    std::uniform_real_distribution<double> distribution; //随机数分布
-    int elementNumber=0; 
-    std::ofstream writeFile; //写文件
-    std::ifstream readFile; //读文件
-    std::mutex mutex;
+    typedef SkipListNode<Key,Value> Node;
+    SkipListArena arena; //节点内存池，必须先于节点构造、后于节点析构
+    std::atomic<int> currentLevel; //当前跳表的最大层数，只作为查找的起点提示
+    Node* head; //头节点
+    std::atomic<int> elementNumber{0};
+    std::atomic<Node*> retiredHead{nullptr}; //待回收节点链表
+    std::atomic<int> retiredNumber{0}; //待回收节点个数
+    std::unique_ptr<HashIndex<Key,Node>> hashIndex; //单点查找的哈希索引，未启用时为空
 private:
     //随机生成新节点的层数
     int randomLevel();
-    bool parseString(const std::string&line,std::string&key,std::string&value);
-    bool isVaildString(const std::string&line);
+    //查找每一层中key的前驱和后继，顺带摘除路过的已删除节点
+    bool findNode(const Key& key,Node** preds,Node** succs);
+    void unlinkNode(Node* victim); //把已标记删除的节点从各层物理摘除，按节点本身而不是key定位
+    void retireNode(Node* node); //将摘除的节点放入待回收链表
+    void reclaimNodes(); //释放已经没有线程引用的节点
+    Node* createNode(const Key& key,const Value& value,int level); //从内存池中分配并构造节点
+    void destroyNode(Node* node); //析构节点并归还内存池
+    static bool isMarked(Node* node){ return reinterpret_cast<uintptr_t>(node)&1; }
+    static Node* getMarked(Node* node){ return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(node)|1); }
+    static Node* getUnmarked(Node* node){ return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(node)&~uintptr_t(1)); }
 public:
-    SkipList();
+    explicit SkipList(bool useHashIndex=false);
     ~SkipList();
-    bool addItem(const Key& key, const Value& value); //添加节点
+    SkipList(const SkipList&)=delete;
+    SkipList& operator=(const SkipList&)=delete;
+    bool addItem(const Key& key, const Value& value); //添加节点，key已存在时返回false
+    //查找key，不存在时以value插入新节点，返回节点和是否新建
+    std::pair<Node*,bool> findOrInsert(const Key& key,const Value& value);
+    //查找或插入后对节点的值调用update(Value&,bool created)，只遍历一次跳表
+    template<typename Function>
+    std::pair<Node*,bool> upsert(const Key& key,const Value& value,Function update);
     bool modifyItem(const Key& key, const Value& value); //修改节点
-    std::shared_ptr<SkipListNode<Key,Value>> searchItem(const Key& key); //查找节点
+    Node* searchItem(const Key& key); //查找节点
     bool deleteItem(const Key& key); //删除节点
+    template<typename Function>
+    void forEach(Function func); //按key的顺序遍历所有节点
     void printList(); //打印跳表
-    void dumpFile(std::string save_path); //保存跳表到文件
-    void loadFile(std::string load_path); //从文件加载跳表
     int size(); //返回跳表元素个数
 public:
-    int getCurrentLevel(){return currentLevel;} //返回当前跳表的最大层数
-        std::shared_ptr<SkipListNode<Key,Value>> getHead(){return head;} //返回头节点
+    int getCurrentLevel(){return currentLevel.load();} //返回当前跳表的最大层数
 };
 
 /*--------------函数定义---------------------*/
 
+/**
+ * 从最高层开始查找key在每一层的前驱和后继节点，遇到已被标记删除的节点时将其从该层摘除。
+ * 摘除失败说明前驱已被并发修改，从头重新查找。
+ *
+ * @param key 要查找的key。
+ * @param preds 输出每一层的前驱节点。
+ * @param succs 输出每一层的后继节点。
+ * @return 第0层的后继节点的key等于目标key时返回true。
+ */
+template<typename Key,typename Value>
+bool SkipList<Key,Value>::findNode(const Key& key,Node** preds,Node** succs){
+retry:
+    Node* pred=head;
+    Node* curr=nullptr;
+    for(int i=MAX_SKIP_LIST_LEVEL-1;i>=0;i--){
+        curr=getUnmarked(pred->forward(i).load());
+        while(curr!=nullptr){
+            Node* succ=curr->forward(i).load();
+            while(isMarked(succ)){ //curr在这一层已被删除，把它摘掉
+                Node* expected=curr;
+                if(!pred->forward(i).compare_exchange_strong(expected,getUnmarked(succ))){
+                    goto retry;
+                }
+                curr=getUnmarked(succ);
+                if(curr==nullptr){
+                    break;
+                }
+                succ=curr->forward(i).load();
+            }
+            if(curr!=nullptr&&curr->key<key){
+                pred=curr;
+                curr=getUnmarked(succ);
+            }else{
+                break;
+            }
+        }
+        preds[i]=pred;
+        succs[i]=curr;
+    }
+    return curr!=nullptr&&curr->key==key;
+}
+
+/**
+ * 把已经在所有层打上删除标记的节点从各层摘除，返回后任何一层都不再链接它，可以放入待回收链表。
+ * 不能只按key查找：删除标记打上后，同一个key的新节点可能已经插在它前面，而且新节点的高层指针
+ * 仍指向它，按key查找会停在新节点上，把它留在链表里。这里越过key相同的节点继续向后找，
+ * 直到key更大的节点为止，路过的已删除节点（包括victim）都被摘除。
+ *
+ * @param victim 要摘除的节点。
+ */
+template<typename Key,typename Value>
+void SkipList<Key,Value>::unlinkNode(Node* victim){
+    const Key& key=victim->key;
+retry:
+    Node* pred=head;
+    for(int i=MAX_SKIP_LIST_LEVEL-1;i>=0;i--){
+        Node* curr=getUnmarked(pred->forward(i).load());
+        while(curr!=nullptr){
+            Node* succ=curr->forward(i).load();
+            if(isMarked(succ)){ //curr在这一层已被删除，把它摘掉
+                Node* expected=curr;
+                if(!pred->forward(i).compare_exchange_strong(expected,getUnmarked(succ))){
+                    goto retry;
+                }
+                curr=getUnmarked(succ);
+                continue;
+            }
+            if(key<curr->key){
+                break;
+            }
+            pred=curr; //key相同的新节点排在victim前面，越过它继续找
+            curr=getUnmarked(succ);
+        }
+    }
+}
+
 template<typename Key,typename Value>
 bool SkipList<Key,Value>::addItem(const Key& key,const Value& value){
-    mutex.lock();
-    auto currentNode=this->head; //从头节点开始查找
-    std::vector<std::shared_ptr<SkipListNode<Key,Value>>>update(MAX_SKIP_LIST_LEVEL,head); //记录每层需要更新的节点
-    //找到小于目标键值的最大节点
-    for(int i=currentLevel-1;i>=0;i--){
-        while(currentNode->forward[i]&&currentNode->forward[i]->key<key){
-            currentNode=currentNode->forward[i];
+    return findOrInsert(key,value).second;
+}
+
+template<typename Key,typename Value>
+std::pair<SkipListNode<Key,Value>*,bool> SkipList<Key,Value>::findOrInsert(const Key& key,const Value& value){
+    return upsert(key,value,[](Value&,bool){});
+}
+
+/**
+ * 一次遍历完成查找和插入：key已存在时对已有节点调用update，不存在时以value创建节点，
+ * 在节点对外可见之前调用update。无锁跳表的前驱数组在返回后随时可能失效，因此不返回前驱数组。
+ * update对已有节点的修改和其他线程之间的并发需要调用方自行协调（RedisHelper中由分片写锁保证）。
+ * 返回的节点指针只在调用方持有EpochGuard期间有效。
+ *
+ * @param key 要查找或插入的key。
+ * @param value key不存在时新节点的初始值。
+ * @param update 回调函数update(Value& value,bool created)。
+ * @return 返回key对应的节点，以及节点是否为本次新建。
+ */
+template<typename Key,typename Value>
+template<typename Function>
+std::pair<SkipListNode<Key,Value>*,bool> SkipList<Key,Value>::upsert(const Key& key,const Value& value,Function update){
+    EpochGuard guard;
+    if(hashIndex){ //索引命中已有节点时不需要遍历跳表
+        Node* node=hashIndex->find(key);
+        if(node&&node->fullyLinked.load()&&!isMarked(node->forward(0).load())){
+            update(node->value,false);
+            return {node,false};
         }
-        update[i]=currentNode;
     }
-    
+    Node* preds[MAX_SKIP_LIST_LEVEL]; //记录每层需要更新的节点
+    Node* succs[MAX_SKIP_LIST_LEVEL];
     int newLevel=this->randomLevel(); //生成新节点的层数
-    currentLevel=std::max(newLevel,currentLevel); //更新当前跳表的最大层数
-    std::shared_ptr<SkipListNode<Key,Value>> newNode=std::make_shared<SkipListNode<Key,Value>>(key,value,newLevel); //只分配节点的层高
-    for(int i=0;i<newLevel;i++){
-        newNode->forward[i]=update[i]->forward[i];
-        update[i]->forward[i]=newNode;
+    int level=currentLevel.load();
+    while(level<newLevel&&!currentLevel.compare_exchange_weak(level,newLevel)){ //更新当前跳表的最大层数
+    }
+    Node* newNode=nullptr;
+    while(true){
+        if(findNode(key,preds,succs)){
+            Node* found=succs[0];
+            if(!isMarked(found->forward(0).load())){
+                //同一个key正在被其他线程插入，等它完成后再返回
+                while(!found->fullyLinked.load()){
+                    std::this_thread::yield();
+                }
+                if(newNode!=nullptr){
+                    destroyNode(newNode);
+                }
+                update(found->value,false);
+                return {found,false};
+            }
+            continue; //节点正在被删除，重新查找
+        }
+        if(newNode==nullptr){
+            newNode=createNode(key,value,newLevel); //只分配节点的层高
+        }
+        for(int i=0;i<newLevel;i++){
+            newNode->forward(i).store(succs[i],std::memory_order_relaxed);
+        }
+        //先链接第0层，成功后节点就占住了这个key
+        Node* expected=succs[0];
+        if(!preds[0]->forward(0).compare_exchange_strong(expected,newNode)){
+            continue;
+        }
+        for(int i=1;i<newLevel;i++){
+            while(true){
+                //后继在这一层已被标记删除时不指向它，重新查找把它摘掉；之后仍可能被标记，由unlinkNode兜底
+                if(succs[i]==nullptr||!isMarked(succs[i]->forward(i).load())){
+                    expected=succs[i];
+                    if(preds[i]->forward(i).compare_exchange_strong(expected,newNode)){
+                        break;
+                    }
+                }
+                //前驱发生变化，重新查找后再链接这一层
+                findNode(key,preds,succs);
+                newNode->forward(i).store(succs[i]);
+            }
+        }
+        //fullyLinked之前其他线程的查找、插入和删除都看不到或等待这个节点，此时修改值不会和它们冲突
+        update(newNode->value,true);
+        if(hashIndex){
+            hashIndex->insert(key,newNode); //先发布到索引，再对外可见
+        }
+        newNode->fullyLinked.store(true);
+        elementNumber++;
+        return {newNode,true};
     }
-    elementNumber++;
-    mutex.unlock();
-    return true;
 }
 
 template<typename Key,typename Value>
 bool SkipList<Key,Value>::modifyItem(const Key&key, const Value& value){
-
-    std::shared_ptr<SkipListNode<Key,Value>> targetNode=this->searchItem(key);
-    mutex.lock();
+    EpochGuard guard;
+    Node* targetNode=this->searchItem(key);
     if(targetNode==nullptr){
-        mutex.unlock();
         return false;
     }
     targetNode->value=value;
-    mutex.unlock();
     return true;
 
 }
 
 //查找节点
 template<typename Key,typename Value>
-std::shared_ptr<SkipListNode<Key,Value>> SkipList<Key,Value>::searchItem(const Key& key){
-    mutex.lock();
-    std::shared_ptr<SkipListNode<Key,Value>> currentNode=this->head;
-    if(!currentNode){
-        mutex.unlock();
+SkipListNode<Key,Value>* SkipList<Key,Value>::searchItem(const Key& key){
+    EpochGuard guard;
+    if(hashIndex){
+        Node* node=hashIndex->find(key);
+        if(node&&node->fullyLinked.load()&&!isMarked(node->forward(0).load())){
+            return node;
+        }
         return nullptr;
     }
-    for(int i=currentLevel-1;i>=0;i--){
-        while(currentNode->forward[i]!=nullptr&&currentNode->forward[i]->key<key){
-            currentNode=currentNode->forward[i];
+    Node* pred=this->head;
+    Node* curr=nullptr;
+    for(int i=std::max(currentLevel.load(),1)-1;i>=0;i--){
+        curr=getUnmarked(pred->forward(i).load());
+        while(curr!=nullptr){
+            Node* succ=curr->forward(i).load();
+            if(isMarked(succ)){ //跳过已删除的节点，不帮忙摘除
+                curr=getUnmarked(succ);
+                continue;
+            }
+            if(curr->key<key){
+                pred=curr;
+                curr=getUnmarked(succ);
+            }else{
+                break;
+            }
         }
     }
-    currentNode=currentNode->forward[0];
-    if(currentNode&&currentNode->key==key){
-        mutex.unlock();
-        return currentNode;
+    if(curr&&curr->key==key&&curr->fullyLinked.load()&&!isMarked(curr->forward(0).load())){
+        return curr;
     }
-    mutex.unlock();
     return nullptr;
 }
 
 template<typename Key,typename Value>
 bool SkipList<Key,Value>::deleteItem(const Key& key){
-    mutex.lock();
-    std::shared_ptr<SkipListNode<Key,Value>> currentNode=this->head;
-    std::vector<std::shared_ptr<SkipListNode<Key,Value>>>update(MAX_SKIP_LIST_LEVEL,head);
-    for(int i=currentLevel-1;i>=0;i--){
-        while(currentNode->forward[i]&&currentNode->forward[i]->key<key){
-            currentNode=currentNode->forward[i];
-        }
-        update[i]=currentNode;
-    }
-    currentNode=currentNode->forward[0];
-    if(!currentNode||currentNode->key!=key){
-        mutex.unlock();
+    EpochGuard guard;
+    Node* preds[MAX_SKIP_LIST_LEVEL];
+    Node* succs[MAX_SKIP_LIST_LEVEL];
+    if(!findNode(key,preds,succs)){
         return false;
     }
-    for(int i=0;i<currentLevel;i++){
-        if(update[i]->forward[i]!=currentNode){
-            break;
+    Node* victim=succs[0];
+    while(!victim->fullyLinked.load()){ //等待插入完成，避免和插入线程同时修改高层指针
+        std::this_thread::yield();
+    }
+    //从高层到第1层打删除标记
+    for(int i=victim->level-1;i>=1;i--){
+        Node* succ=victim->forward(i).load();
+        while(!isMarked(succ)){
+            victim->forward(i).compare_exchange_weak(succ,getMarked(succ));
         }
-        update[i]->forward[i]=currentNode->forward[i];
     }
-    currentNode.reset();
-    while(currentLevel>1&&head->forward[currentLevel-1]==nullptr){
-        currentLevel--;
+    //第0层标记成功的线程才是真正的删除者
+    Node* succ=victim->forward(0).load();
+    while(true){
+        if(isMarked(succ)){
+            return false;
+        }
+        if(victim->forward(0).compare_exchange_strong(succ,getMarked(succ))){
+            break;
+        }
     }
     elementNumber--;
-    mutex.unlock();
+    if(hashIndex){
+        hashIndex->erase(key,victim);
+    }
+    unlinkNode(victim); //物理摘除各层
+    retireNode(victim);
     return true;
 }
 
-//打印跳表
 template<typename Key,typename Value>
-void SkipList<Key,Value>::printList(){
-    mutex.lock();
-    for(int i=currentLevel;i>=0;i--){
-        auto node=this->head->forward[i];
-        std::cout<<"Level"<<i+1<<":";
-        while(node!=nullptr){
-            std::cout<<node->key<<DELIMITER<<node->value<<"; ";
-            node=node->forward[i];
-        }
-        std::cout<<std::endl;
-    }
-    mutex.unlock();
+SkipListNode<Key,Value>* SkipList<Key,Value>::createNode(const Key& key,const Value& value,int level){
+    void* block=arena.allocate(level);
+    return new(block) Node(key,value,level);
 }
 
 template<typename Key,typename Value>
-/**
- * 将SkipList中的数据导出到指定路径的文件中。
- *
- * @param save_path 要保存的文件路径。
- */
-void SkipList<Key,Value>::dumpFile( std::string save_path){
-    mutex.lock();
-    writeFile.open(save_path); //打开文件
-    auto node=this->head->forward[0];  //从第一层开始遍历
-    while(node!=nullptr){
-        writeFile<<node->key<<DELIMITER<<node->value.dump()<<"\n"; //写入文件 dump()函数将value转换为字符串 整数 1->"1" 字符串 "hello"->"hello" 二进制数据 0x01 0x02 0x03->"0x01 0x02 0x03"
-        node=node->forward[0];
-    }
-    writeFile.flush(); //刷新缓冲区 写入文件 直接写入文件 不用等到文件关闭 
-    // 众所周与,你所要输出的内容会先存入缓冲区,而flush()的作用正是强行将缓冲区的数据清空
-    writeFile.close(); //关闭文件
-    mutex.unlock();
+void SkipList<Key,Value>::destroyNode(Node* node){
+    int level=node->level;
+    node->~Node();
+    arena.deallocate(node,level);
 }
 
-
-
 template<typename Key,typename Value>
-void SkipList<Key,Value>::loadFile(std::string load_path){
-
-    readFile.open(load_path); //打开文件
-    if(!readFile.is_open()){ 
-        mutex.unlock();
-        return;
-    }
-    std::string line;
-    std::string key;
-    std::string value;
-    std::string err;
-    while(std::getline(readFile,line)){ //读取文件
-        if(parseString(line,key,value)){
-            addItem(key,RedisValue::parse(value,err)); //将字符串转换为RedisValue对象
-        }
+void SkipList<Key,Value>::retireNode(Node* node){
+    node->retireEpoch=EpochManager::getInstance().currentEpoch();
+    Node* top=retiredHead.load();
+    do{
+        node->retiredNext=top;
+    }while(!retiredHead.compare_exchange_weak(top,node));
+    if(++retiredNumber>=RECLAIM_THRESHOLD){
+        reclaimNodes();
     }
-    readFile.close();
-
 }
 
-
+/**
+ * 取出整个待回收链表，释放已经安全的节点，其余节点放回链表。
+ */
 template<typename Key,typename Value>
-bool SkipList<Key,Value>::isVaildString(const std::string&line){
-    if(line.empty()){
-        return false;
+void SkipList<Key,Value>::reclaimNodes(){
+    EpochManager& epochManager=EpochManager::getInstance();
+    epochManager.tryAdvance();
+    Node* node=retiredHead.exchange(nullptr);
+    Node* keepHead=nullptr;
+    Node* keepTail=nullptr;
+    int freed=0;
+    while(node!=nullptr){
+        Node* next=node->retiredNext;
+        if(epochManager.isSafe(node->retireEpoch)){
+            destroyNode(node);
+            freed++;
+        }else{
+            node->retiredNext=keepHead;
+            keepHead=node;
+            if(keepTail==nullptr){
+                keepTail=node;
+            }
+        }
+        node=next;
     }
-    if(line.find(DELIMITER)==std::string::npos){
-        return false;
+    if(keepHead!=nullptr){
+        Node* top=retiredHead.load();
+        do{
+            keepTail->retiredNext=top;
+        }while(!retiredHead.compare_exchange_weak(top,keepHead));
     }
-    return true;
+    retiredNumber-=freed;
 }
 
-//解析字符串
+/**
+ * 按key从小到大遍历跳表中所有可见的节点。
+ *
+ * @param func 对每个节点调用func(key,value)。
+ */
 template<typename Key,typename Value>
-bool SkipList<Key,Value>::parseString(const std::string&line,std::string&key,std::string&value){
-    if(!isVaildString(line)){
-        return false;
+template<typename Function>
+void SkipList<Key,Value>::forEach(Function func){
+    EpochGuard guard;
+    Node* node=getUnmarked(head->forward(0).load());
+    while(node!=nullptr){
+        Node* next=node->forward(0).load();
+        if(!isMarked(next)&&node->fullyLinked.load()){
+            func(node->key,node->value);
+        }
+        node=getUnmarked(next);
     }
-    int index=line.find(DELIMITER); //找到分隔符的位置 返回的是分隔符的位置
-    key=line.substr(0,index);
-    value=line.substr(index+1);
-    return true;
+}
 
-} 
+//打印跳表
+template<typename Key,typename Value>
+void SkipList<Key,Value>::printList(){
+    EpochGuard guard;
+    for(int i=currentLevel.load()-1;i>=0;i--){
+        Node* node=getUnmarked(this->head->forward(i).load());
+        std::cout<<"Level"<<i+1<<":";
+        while(node!=nullptr){
+            Node* next=node->forward(i).load();
+            if(!isMarked(next)){
+                std::cout<<node->key<<DELIMITER<<node->value<<"; ";
+            }
+            node=getUnmarked(next);
+        }
+        std::cout<<std::endl;
+    }
+}
 
 template<typename Key,typename Value>
 int SkipList<Key,Value>::size(){
-    mutex.lock();
-    int ret=this->elementNumber;
-    mutex.unlock();
-    return ret;
+    return this->elementNumber.load();
 }
 
 
 template<typename Key,typename Value>
-SkipList<Key,Value>::SkipList()
-    :currentLevel(0),distribution(0, 1)
+SkipList<Key,Value>::SkipList(bool useHashIndex)
+    :arena(Node::allocationSize(0),sizeof(typename Node::Link),MAX_SKIP_LIST_LEVEL),currentLevel(1)
 {
+    if(useHashIndex){
+        hashIndex.reset(new HashIndex<Key,Node>());
+    }
     Key key;
     Value value;
-    this->head=std::make_shared<SkipListNode<Key,Value>>(key,value); //初始化头节点,层数为最大层数
+    this->head=createNode(key,value,MAX_SKIP_LIST_LEVEL); //初始化头节点,层数为最大层数
+    this->head->fullyLinked.store(true);
 }
 
 //随机生成新节点的层数
 template<typename Key, typename Value>
 int SkipList<Key,Value>::randomLevel()
 {
+    //每个线程独立的随机数生成器，避免多个写线程争用
+    static thread_local std::mt19937 generator{ std::random_device{}()};
+    std::uniform_real_distribution<double> distribution(0, 1);
     int level=1;
     while(distribution(generator)< PROBABILITY_FACTOR
         && level<MAX_SKIP_LIST_LEVEL){
@@ -271,13 +489,21 @@ int SkipList<Key,Value>::randomLevel()
     return level;
 }
 
+//析构时不再有其他线程访问跳表，直接释放所有节点
 template<typename Key,typename Value>
 SkipList<Key,Value>::~SkipList(){
-    if(this->readFile){
-        readFile.close();
+    Node* node=getUnmarked(head->forward(0).load());
+    while(node!=nullptr){
+        Node* next=getUnmarked(node->forward(0).load());
+        destroyNode(node);
+        node=next;
     }
-    if(this->writeFile){
-        writeFile.close();
+    destroyNode(head);
+    node=retiredHead.load();
+    while(node!=nullptr){
+        Node* next=node->retiredNext;
+        destroyNode(node);
+        node=next;
     }
 }
-#endif
\ No newline at end of file
+#endif
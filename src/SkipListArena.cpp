@@ -0,0 +1,57 @@
+#include "SkipListArena.h"
+#include <new>
+
+SkipListArena::SkipListArena(size_t nodeSize,size_t towerSlotSize,int maxLevel)
+    :nodeSize(nodeSize),towerSlotSize(towerSlotSize),freeLists(maxLevel+1,nullptr)
+{
+}
+
+SkipListArena::~SkipListArena(){
+    for(char* slab:slabs){
+        ::operator delete(slab);
+    }
+}
+
+size_t SkipListArena::blockSize(int level) const{
+    size_t size=nodeSize+level*towerSlotSize;
+    return (size+ARENA_ALIGNMENT-1)/ARENA_ALIGNMENT*ARENA_ALIGNMENT;
+}
+
+/**
+ * 分配一个层高为level的节点块。优先复用同层高的空闲块，否则从当前内存块中切分。
+ *
+ * @param level 节点的层高。
+ * @return 返回未初始化的内存地址。
+ */
+void* SkipListArena::allocate(int level){
+    std::lock_guard<std::mutex> lock(mutex);
+    FreeBlock* block=freeLists[level];
+    if(block!=nullptr){
+        freeLists[level]=block->next;
+        return block;
+    }
+    size_t size=blockSize(level);
+    if(remaining<size){
+        size_t slabSize=size>ARENA_SLAB_SIZE?size:ARENA_SLAB_SIZE;
+        current=static_cast<char*>(::operator new(slabSize));
+        remaining=slabSize;
+        slabs.push_back(current);
+    }
+    void* result=current;
+    current+=size;
+    remaining-=size;
+    return result;
+}
+
+/**
+ * 归还节点块到对应层高的空闲链表，调用前节点需要已经析构。
+ *
+ * @param block 节点块地址。
+ * @param level 节点的层高。
+ */
+void SkipListArena::deallocate(void* block,int level){
+    std::lock_guard<std::mutex> lock(mutex);
+    FreeBlock* freeBlock=static_cast<FreeBlock*>(block);
+    freeBlock->next=freeLists[level];
+    freeLists[level]=freeBlock;
+}
@@ -0,0 +1,38 @@
+#ifndef SKIPLIST_ARENA_H
+#define SKIPLIST_ARENA_H
+#include<cstddef>
+#include<mutex>
+#include<vector>
+#define ARENA_SLAB_SIZE (64*1024) //每次向系统申请的内存块大小
+#define ARENA_ALIGNMENT 16
+
+/*
+    跳表节点的内存池
+    节点和它的各层指针分配在同一块连续内存中，块大小由节点层高决定；
+    按层高维护空闲链表，回收的节点块直接复用，内存池析构时统一归还系统。
+    只有插入和回收节点时才会访问内存池，查找路径不会经过这里。
+*/
+class SkipListArena{
+private:
+    struct FreeBlock{
+        FreeBlock* next;
+    };
+    size_t nodeSize; //节点本身的大小
+    size_t towerSlotSize; //每一层指针的大小
+    std::vector<FreeBlock*> freeLists; //按层高划分的空闲链表
+    std::vector<char*> slabs; //已申请的内存块
+    char* current=nullptr; //当前内存块中未分配部分的起始地址
+    size_t remaining=0; //当前内存块剩余字节数
+    std::mutex mutex;
+private:
+    size_t blockSize(int level) const; //层高为level的节点占用的字节数
+public:
+    SkipListArena(size_t nodeSize,size_t towerSlotSize,int maxLevel);
+    ~SkipListArena();
+    SkipListArena(const SkipListArena&)=delete;
+    SkipListArena& operator=(const SkipListArena&)=delete;
+    void* allocate(int level); //分配一个层高为level的节点块
+    void deallocate(void* block,int level); //归还节点块
+};
+
+#endif
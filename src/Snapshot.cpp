@@ -0,0 +1,628 @@
+#include "Snapshot.h"
+#include "RedisValue/CompactHash.h"
+#include "RedisValue/QuickList.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#define SNAPSHOT_MAX_DEPTH 64 //嵌套值的最大深度，防止损坏的文件导致递归过深
+
+namespace
+{
+// CRC32（IEEE 802.3多项式），按字节查表计算
+struct Crc32Table
+{
+    uint32_t table[256];
+    Crc32Table()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    }
+};
+
+uint32_t updateCrc(uint32_t crc, const char *data, size_t size)
+{
+    static const Crc32Table crcTable;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = crcTable.table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// 字符串是否是一个int64整数的规范写法，是则通过result返回
+bool parseCanonicalInt(const std::string &str, int64_t &result)
+{
+    if (str.empty() || str.size() > 20 || (str[0] != '-' && !isdigit(static_cast<unsigned char>(str[0]))))
+    {
+        return false;
+    }
+    errno = 0;
+    char *end = nullptr;
+    long long value = std::strtoll(str.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || std::to_string(value) != str)
+    {
+        return false;
+    }
+    result = value;
+    return true;
+}
+
+// 字符串是否恰好是std::to_string(double)的结果（incrbyfloat写入的格式），是则通过result返回
+bool parseCanonicalDouble(const std::string &str, double &result)
+{
+    if (str.empty() || str.size() > 64 || str.find('.') == std::string::npos)
+    {
+        return false;
+    }
+    char *end = nullptr;
+    double value = std::strtod(str.c_str(), &end);
+    if (*end != '\0' || std::to_string(value) != str)
+    {
+        return false;
+    }
+    result = value;
+    return true;
+}
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &filePath, const AppendOnlyFile::Position &logPosition)
+    : filePath(filePath), tempPath(filePath + ".tmp"), buffer(SNAPSHOT_BUFFER_SIZE)
+{
+    fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0)
+    {
+        writeRaw(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE);
+        writeByte(SNAPSHOT_VERSION);
+        writeVarint(logPosition.generation);
+        writeVarint(logPosition.offset);
+    }
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    // 没有调用finish或写入失败时，删除不完整的临时文件
+    if (fd >= 0)
+    {
+        close(fd);
+        std::remove(tempPath.c_str());
+    }
+}
+
+void SnapshotWriter::flushBuffer()
+{
+    if (used == 0)
+    {
+        return;
+    }
+    crc = updateCrc(crc, buffer.data(), used);
+    writeFile(buffer.data(), used);
+    used = 0;
+}
+
+void SnapshotWriter::writeFile(const char *data, size_t size)
+{
+    while (!failed && size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno != EINTR)
+        {
+            failed = true;
+        }
+        else if (written > 0)
+        {
+            data += written;
+            size -= written;
+        }
+    }
+}
+
+void SnapshotWriter::writeRaw(const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        if (used == buffer.size())
+        {
+            flushBuffer();
+        }
+        size_t length = std::min(size, buffer.size() - used);
+        std::memcpy(buffer.data() + used, data, length);
+        used += length;
+        data += length;
+        size -= length;
+    }
+}
+
+void SnapshotWriter::writeByte(uint8_t byte)
+{
+    if (used == buffer.size())
+    {
+        flushBuffer();
+    }
+    buffer[used++] = static_cast<char>(byte);
+}
+
+void SnapshotWriter::writeVarint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        writeByte(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    writeByte(static_cast<uint8_t>(value));
+}
+
+void SnapshotWriter::writeString(std::string_view str)
+{
+    writeVarint(str.size());
+    writeRaw(str.data(), str.size());
+}
+
+void SnapshotWriter::writeTag(uint8_t type, const std::string *key)
+{
+    writeByte(type);
+    if (key != nullptr)
+    {
+        writeString(*key);
+    }
+}
+
+void SnapshotWriter::writeInteger(int64_t value, const std::string *key)
+{
+    writeTag(SNAPSHOT_INT, key);
+    writeVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)); // zigzag编码
+}
+
+void SnapshotWriter::writeDouble(double value, const std::string *key)
+{
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeTag(SNAPSHOT_DOUBLE, key);
+    for (int i = 0; i < 8; i++)
+    {
+        writeByte(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+}
+
+/**
+ * 写入字符串。能无损地表示为整数或浮点数时使用数值编码，读取时还原为同样的字符串。
+ *
+ * @param str 要写入的字符串。
+ * @param key 不为空时写在类型标记和值的内容之间。
+ */
+void SnapshotWriter::writeStringValue(const std::string &str, const std::string *key)
+{
+    int64_t intValue = 0;
+    double doubleValue = 0;
+    if (parseCanonicalInt(str, intValue))
+    {
+        writeInteger(intValue, key);
+    }
+    else if (parseCanonicalDouble(str, doubleValue))
+    {
+        writeDouble(doubleValue, key);
+    }
+    else
+    {
+        writeTag(SNAPSHOT_STRING, key);
+        writeString(str);
+    }
+}
+
+/**
+ * 写入值的类型标记和内容。整数、浮点数编码的值，以及能无损地表示为整数或浮点数的字符串使用数值编码。
+ *
+ * @param value 要写入的值。
+ * @param key 不为空时写在类型标记和值的内容之间，用于顶层键值对。
+ */
+void SnapshotWriter::writeValue(const RedisValue &value, const std::string *key)
+{
+    RedisValue item = value; // RedisValue的取值接口不是const的，拷贝只增加引用计数
+    switch (item.type())
+    {
+    case RedisValue::STRING:
+        writeStringValue(item.stringValue(), key);
+        break;
+    case RedisValue::NUMBER:
+        if (item.isInteger())
+        {
+            writeInteger(item.integerValue(), key);
+        }
+        else
+        {
+            writeDouble(item.doubleValue(), key);
+        }
+        break;
+    case RedisValue::LIST:
+    {
+        QuickList &items = item.listItems();
+        writeTag(SNAPSHOT_LIST, key);
+        writeVarint(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            writeStringValue(items[i], nullptr);
+        }
+        break;
+    }
+    case RedisValue::ARRAY:
+    {
+        RedisValue::array &items = item.arrayItems();
+        writeTag(SNAPSHOT_LIST, key);
+        writeVarint(items.size());
+        for (auto &element : items)
+        {
+            writeValue(element, nullptr);
+        }
+        break;
+    }
+    case RedisValue::HASH:
+    {
+        CompactHash &items = item.hashItems();
+        writeTag(SNAPSHOT_HASH, key);
+        writeVarint(items.size());
+        items.forEach([this](std::string_view field, std::string_view fieldValue)
+                      {
+            writeString(field);
+            writeStringValue(std::string(fieldValue), nullptr); });
+        break;
+    }
+    case RedisValue::OBJECT:
+    {
+        RedisValue::object &items = item.objectItems();
+        writeTag(SNAPSHOT_HASH, key);
+        writeVarint(items.size());
+        for (auto &field : items)
+        {
+            writeString(field.first);
+            writeValue(field.second, nullptr);
+        }
+        break;
+    }
+    case RedisValue::NUL:
+        writeTag(SNAPSHOT_NUL, key);
+        break;
+    default: // 其他类型目前不会出现在数据库中，按文本保存
+        writeTag(SNAPSHOT_STRING, key);
+        writeString(item.dump());
+        break;
+    }
+}
+
+/**
+ * 写入一个键值对：值的类型标记在前，随后是key和值的内容。
+ *
+ * @param key 键。
+ * @param value 值。
+ */
+void SnapshotWriter::writeEntry(const std::string &key, const RedisValue &value)
+{
+    // 类型标记写在key之前，读取时用同一个字节区分键值对和结束标记
+    writeValue(value, &key);
+}
+
+/**
+ * 写入结束标记和CRC32校验和，临时文件刷盘后替换目标文件，再刷盘所在的目录。
+ * 先刷盘再rename，断电后目标文件要么是旧快照，要么是完整的新快照。
+ *
+ * @return 全部写入并替换成功返回true，否则返回false，目标文件保持不变。
+ */
+bool SnapshotWriter::finish()
+{
+    if (fd < 0)
+    {
+        return false;
+    }
+    writeByte(SNAPSHOT_EOF);
+    flushBuffer();
+    char trailer[4];
+    for (int i = 0; i < 4; i++)
+    {
+        trailer[i] = static_cast<char>(crc >> (8 * i));
+    }
+    writeFile(trailer, sizeof(trailer));
+    if (failed || fsync(fd) != 0)
+    {
+        return false; // 析构时删除临时文件
+    }
+    close(fd);
+    fd = -1;
+    if (std::rename(tempPath.c_str(), filePath.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    AppendOnlyFile::syncDirectory(filePath);
+    return true;
+}
+
+SnapshotReader::SnapshotReader(const std::string &filePath)
+    : file(filePath, std::ios::binary), buffer(SNAPSHOT_BUFFER_SIZE)
+{
+    if (!file.is_open())
+    {
+        return;
+    }
+    file.seekg(0, std::ios::end);
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+    unread = fileSize > 0 ? static_cast<uint64_t>(fileSize) : 0;
+    char magic[SNAPSHOT_MAGIC_SIZE];
+    if (!readRaw(magic, SNAPSHOT_MAGIC_SIZE) || std::memcmp(magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) != 0)
+    {
+        return;
+    }
+    snapshot = true;
+    uint8_t version = 0;
+    if (!readByte(version) || version > SNAPSHOT_VERSION)
+    {
+        failed = true;
+        return;
+    }
+    // 版本1的快照没有日志位置，按不对应任何日志处理，重放整个日志
+    if (version >= 2 && (!readVarint(logPosition.generation) || !readVarint(logPosition.offset)))
+    {
+        failed = true;
+    }
+}
+
+bool SnapshotReader::fillBuffer()
+{
+    file.read(buffer.data(), buffer.size());
+    available = file.gcount();
+    position = 0;
+    unread -= std::min<uint64_t>(unread, available);
+    return available > 0;
+}
+
+bool SnapshotReader::readRaw(char *data, size_t size, bool checksum)
+{
+    while (size > 0)
+    {
+        if (position == available && !fillBuffer())
+        {
+            failed = true;
+            return false;
+        }
+        size_t length = std::min(size, available - position);
+        std::memcpy(data, buffer.data() + position, length);
+        if (checksum)
+        {
+            crc = updateCrc(crc, data, length);
+        }
+        position += length;
+        data += length;
+        size -= length;
+    }
+    return true;
+}
+
+bool SnapshotReader::readByte(uint8_t &byte)
+{
+    char ch;
+    if (!readRaw(&ch, 1))
+    {
+        return false;
+    }
+    byte = static_cast<uint8_t>(ch);
+    return true;
+}
+
+bool SnapshotReader::readVarint(uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        uint8_t byte = 0;
+        if (!readByte(byte))
+        {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    failed = true;
+    return false;
+}
+
+bool SnapshotReader::readString(std::string &str)
+{
+    uint64_t size = 0;
+    if (!readVarint(size))
+    {
+        return false;
+    }
+    if (size > remaining())
+    {
+        // 长度已损坏，文件中没有这么多数据
+        failed = true;
+        return false;
+    }
+    str.resize(size);
+    return size == 0 || readRaw(&str[0], size);
+}
+
+/**
+ * 按类型标记读取值的内容。
+ *
+ * @param type 类型标记。
+ * @param value 输出读取到的值。
+ * @param depth 当前嵌套深度。
+ * @return 读取成功返回true，文件损坏返回false。
+ */
+bool SnapshotReader::readValue(uint8_t type, RedisValue &value, int depth)
+{
+    if (depth > SNAPSHOT_MAX_DEPTH)
+    {
+        failed = true;
+        return false;
+    }
+    switch (type)
+    {
+    case SNAPSHOT_STRING:
+    {
+        std::string str;
+        if (!readString(str))
+        {
+            return false;
+        }
+        value = RedisValue(std::move(str));
+        return true;
+    }
+    case SNAPSHOT_INT:
+    {
+        uint64_t encoded = 0;
+        if (!readVarint(encoded))
+        {
+            return false;
+        }
+        int64_t intValue = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+        // 顶层的值恢复为整数编码；列表和哈希表的元素按字符串读取，和写入时一致
+        value = depth == 0 ? RedisValue(intValue) : RedisValue(std::to_string(intValue));
+        return true;
+    }
+    case SNAPSHOT_DOUBLE:
+    {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            uint8_t byte = 0;
+            if (!readByte(byte))
+            {
+                return false;
+            }
+            bits |= static_cast<uint64_t>(byte) << (8 * i);
+        }
+        double doubleValue = 0;
+        std::memcpy(&doubleValue, &bits, sizeof(doubleValue));
+        value = depth == 0 ? RedisValue(doubleValue) : RedisValue(std::to_string(doubleValue));
+        return true;
+    }
+    case SNAPSHOT_LIST:
+    {
+        uint64_t count = 0;
+        if (!readVarint(count))
+        {
+            return false;
+        }
+        // 顶层的列表读取为列表类型，嵌套的数组保持原样
+        QuickList valueList;
+        RedisValue::array items;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            uint8_t elementType = 0;
+            RedisValue element;
+            if (!readByte(elementType) || !readValue(elementType, element, depth + 1))
+            {
+                return false;
+            }
+            if (depth == 0)
+            {
+                valueList.pushBack(element.isString() ? std::move(element.stringValue()) : element.toString());
+            }
+            else
+            {
+                items.push_back(std::move(element));
+            }
+        }
+        value = depth == 0 ? RedisValue(std::move(valueList)) : RedisValue(std::move(items));
+        return true;
+    }
+    case SNAPSHOT_HASH:
+    {
+        uint64_t count = 0;
+        if (!readVarint(count))
+        {
+            return false;
+        }
+        // 顶层的哈希表读取为哈希类型，嵌套的对象保持原样
+        CompactHash valueMap;
+        RedisValue::object items;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            std::string field;
+            uint8_t fieldType = 0;
+            RedisValue fieldValue;
+            if (!readString(field) || !readByte(fieldType) || !readValue(fieldType, fieldValue, depth + 1))
+            {
+                return false;
+            }
+            if (depth == 0)
+            {
+                valueMap.set(field, fieldValue.isString() ? fieldValue.stringValue() : fieldValue.toString());
+            }
+            else
+            {
+                items.emplace_hint(items.end(), std::move(field), std::move(fieldValue));
+            }
+        }
+        value = depth == 0 ? RedisValue(std::move(valueMap)) : RedisValue(std::move(items));
+        return true;
+    }
+    case SNAPSHOT_NUL:
+        value = RedisValue();
+        return true;
+    default:
+        failed = true;
+        return false;
+    }
+}
+
+/**
+ * 读取下一个键值对。读到结束标记时校验CRC32。
+ *
+ * @param key 输出键。
+ * @param value 输出值。
+ * @return 读到键值对返回true；到达结尾或文件损坏返回false，两者通过isValid区分。
+ */
+bool SnapshotReader::readEntry(std::string &key, RedisValue &value)
+{
+    if (!snapshot || failed || finished)
+    {
+        return false;
+    }
+    uint8_t type = 0;
+    if (!readByte(type))
+    {
+        return false;
+    }
+    if (type == SNAPSHOT_EOF)
+    {
+        uint32_t expected = crc;
+        char trailer[4];
+        if (!readRaw(trailer, sizeof(trailer), false))
+        {
+            return false;
+        }
+        uint32_t actual = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            actual |= static_cast<uint32_t>(static_cast<uint8_t>(trailer[i])) << (8 * i);
+        }
+        if (actual != expected)
+        {
+            failed = true;
+        }
+        finished = true;
+        return false;
+    }
+    // 类型标记之后是key，然后才是值的内容
+    if (!readString(key) || !readValue(type, value, 0))
+    {
+        return false;
+    }
+    return true;
+}
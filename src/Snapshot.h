@@ -0,0 +1,117 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AppendOnlyFile.h"
+#include "RedisValue/RedisValue.h"
+#define SNAPSHOT_MAGIC "TRDB"
+#define SNAPSHOT_MAGIC_SIZE 4
+#define SNAPSHOT_VERSION 2 //版本2在头部记录追加日志的位置，版本1的文件仍然可以读取
+#define SNAPSHOT_BUFFER_SIZE (64 * 1024) //读写缓冲区大小
+
+/*
+    二进制快照文件格式（多字节整数均为小端序）：
+        头部      "TRDB" + 1字节版本号 + 日志代数(变长整数) + 日志偏移(变长整数)
+        键值对    1字节类型标记 + key(变长整数长度 + 字节) + 值
+        结束标记  1字节 SNAPSHOT_EOF
+        尾部      4字节CRC32，覆盖结束标记之前（含结束标记）的所有字节
+    值按类型标记编码：
+        STRING  变长整数长度 + 字节
+        INT     zigzag变长整数，字符串恰好是一个整数的规范写法时使用
+        DOUBLE  8字节IEEE754，字符串恰好是std::to_string(double)的结果时使用
+        LIST    变长整数元素个数 + 每个元素（类型标记 + 值）
+        HASH    变长整数字段个数 + 每个字段（字段名 + 类型标记 + 值）
+        NUL     无内容
+    头部的日志位置表示快照包含了追加日志中这个位置之前的所有命令，代数为0表示不对应任何日志。
+*/
+enum SnapshotType : uint8_t
+{
+    SNAPSHOT_STRING = 0,
+    SNAPSHOT_INT = 1,
+    SNAPSHOT_DOUBLE = 2,
+    SNAPSHOT_LIST = 3,
+    SNAPSHOT_HASH = 4,
+    SNAPSHOT_NUL = 5,
+    SNAPSHOT_EOF = 0xFF
+};
+
+/*
+    快照写入器：先写入临时文件，finish时临时文件刷盘后再原子地替换目标文件并刷盘目录，
+    写入过程中异常退出或断电不会破坏已有的快照。
+*/
+class SnapshotWriter
+{
+private:
+    std::string filePath;
+    std::string tempPath;
+    int fd = -1;
+    std::vector<char> buffer;
+    size_t used = 0; //缓冲区中已写入的字节数
+    uint32_t crc = 0;
+    bool failed = false;
+
+private:
+    void writeRaw(const char *data, size_t size);
+    void writeByte(uint8_t byte);
+    void writeVarint(uint64_t value);
+    void writeString(std::string_view str);
+    void writeTag(uint8_t type, const std::string *key); //写入类型标记，key不为空时紧跟着写入key
+    void writeValue(const RedisValue &value, const std::string *key); //写入类型标记和值
+    void writeStringValue(const std::string &str, const std::string *key); //写入字符串，能无损表示为数值时使用数值编码
+    void writeInteger(int64_t value, const std::string *key); //写入整数编码的值
+    void writeDouble(double value, const std::string *key); //写入浮点数编码的值
+    void flushBuffer();
+    void writeFile(const char *data, size_t size); //直接写入文件，不经过缓冲区和校验和
+
+public:
+    //logPosition是快照对应的追加日志位置，写入头部
+    explicit SnapshotWriter(const std::string &filePath, const AppendOnlyFile::Position &logPosition = AppendOnlyFile::Position());
+    ~SnapshotWriter();
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+    bool isOpen() const { return fd >= 0; }
+    void writeEntry(const std::string &key, const RedisValue &value); //写入一个键值对
+    bool finish(); //写入结束标记和校验和，并替换目标文件
+};
+
+/*
+    快照读取器：按块读取文件，边读边计算校验和。
+    readEntry返回false后，通过isValid判断是正常读到结尾还是文件损坏。
+*/
+class SnapshotReader
+{
+private:
+    std::ifstream file;
+    std::vector<char> buffer;
+    size_t position = 0; //缓冲区中下一个要读取的字节
+    size_t available = 0; //缓冲区中的有效字节数
+    uint64_t unread = 0; //文件中还没有读入缓冲区的字节数
+    uint32_t crc = 0;
+    bool snapshot = false; //文件头是否是快照格式
+    bool failed = false;
+    bool finished = false; //是否读到结束标记并通过校验
+    AppendOnlyFile::Position logPosition; //头部记录的追加日志位置
+
+private:
+    bool fillBuffer();
+    uint64_t remaining() const { return unread + (available - position); } //文件中还没有读取的字节数
+    bool readRaw(char *data, size_t size, bool checksum = true);
+    bool readByte(uint8_t &byte);
+    bool readVarint(uint64_t &value);
+    bool readString(std::string &str); //长度超过文件剩余的字节数时视为损坏，不按损坏的长度分配内存
+    bool readValue(uint8_t type, RedisValue &value, int depth); //按类型标记读取值
+
+public:
+    explicit SnapshotReader(const std::string &filePath);
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader &operator=(const SnapshotReader &) = delete;
+    bool isSnapshot() const { return snapshot; } //文件是否以快照魔数开头
+    const AppendOnlyFile::Position &getLogPosition() const { return logPosition; } //快照包含到追加日志的哪个位置
+    bool readEntry(std::string &key, RedisValue &value); //读取下一个键值对
+    bool isValid() const { return finished && !failed; }
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef TOKEN_SPAN_H
+#define TOKEN_SPAN_H
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#define INLINE_TOKEN_NUMBER 16 //TokenBuffer不在堆上分配内存时最多容纳的参数个数
+
+/*
+    命令参数的零拷贝表示。
+    分割命令时每个参数只记一个指向请求缓冲区的std::string_view，放进TokenBuffer；
+    解析器通过TokenSpan（连续string_view的只读视图，相当于C++20的std::span<const std::string_view>）按下标读取参数，
+    去掉命令本身只需subspan(1)，不移动也不拷贝参数。
+    视图不拥有数据，调用方需保证请求缓冲区在命令执行期间有效；需要保存命令时（如事务队列）拷贝成std::string。
+*/
+
+//前N个元素存放在对象内部，超过后才在堆上分配；clear只清空内容不释放容量，可以反复使用
+template<typename T, size_t N>
+class SmallVector{
+    static_assert(std::is_trivially_copyable<T>::value, "SmallVector only holds trivially copyable types");
+private:
+    T inlineItems[N];
+    std::unique_ptr<T[]> heapItems; //超过N个元素后使用的存储
+    T *items = inlineItems;
+    size_t count = 0;
+    size_t capacity = N;
+
+    void grow(){
+        std::unique_ptr<T[]> newItems(new T[capacity * 2]);
+        std::memcpy(newItems.get(), items, count * sizeof(T));
+        heapItems = std::move(newItems);
+        items = heapItems.get();
+        capacity *= 2;
+    }
+public:
+    SmallVector() = default;
+    SmallVector(const SmallVector &) = delete; //items可能指向自身，不能按成员拷贝
+    SmallVector &operator=(const SmallVector &) = delete;
+
+    void push_back(const T &item){
+        if(count == capacity){
+            grow();
+        }
+        items[count++] = item;
+    }
+    void clear() { count = 0; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T *data() { return items; }
+    const T *data() const { return items; }
+    T &operator[](size_t index) { return items[index]; }
+    const T &operator[](size_t index) const { return items[index]; }
+    T &front() { return items[0]; }
+    const T &front() const { return items[0]; }
+    T *begin() { return items; }
+    T *end() { return items + count; }
+    const T *begin() const { return items; }
+    const T *end() const { return items + count; }
+};
+
+typedef SmallVector<std::string_view, INLINE_TOKEN_NUMBER> TokenBuffer;
+
+class TokenSpan{
+private:
+    const std::string_view *items = nullptr;
+    size_t count = 0;
+public:
+    TokenSpan() = default;
+    TokenSpan(const std::string_view *items, size_t count) : items(items), count(count) {}
+    TokenSpan(const TokenBuffer &tokens) : items(tokens.data()), count(tokens.size()) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const std::string_view &operator[](size_t index) const { return items[index]; }
+    const std::string_view &front() const { return items[0]; }
+    const std::string_view &back() const { return items[count - 1]; }
+    const std::string_view *begin() const { return items; }
+    const std::string_view *end() const { return items + count; }
+    //去掉前offset个参数，offset不能超过size()
+    TokenSpan subspan(size_t offset) const { return TokenSpan(items + offset, count - offset); }
+};
+
+//让views指向tokens中的每个参数，tokens在views使用期间不能修改
+inline void viewTokens(const std::vector<std::string> &tokens, TokenBuffer &views){
+    views.clear();
+    for(const std::string &token : tokens){
+        views.push_back(token);
+    }
+}
+
+#endif
@@ -4,9 +4,26 @@
 #include <string>
 #include <sstream>
 #include <functional>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <zmq.hpp>		  //这个是zeroMQ的头文件
 #include "Serializer.hpp" //这个是序列化和反序列化的头文件
 
+#define RPC_WORKER_ENDPOINT "inproc://buttonrpc-workers" // 工作线程连接的进程内地址
+#define RPC_ASYNC_ENDPOINT "inproc://buttonrpc-async-"	 // 异步客户端调用线程和IO线程之间的进程内地址前缀
+#define RPC_REPLY_POOL_SIZE 64							 // 回复缓冲区池最多保留的缓冲区个数
+#define RPC_REPLY_POOL_MAX_CAPACITY (1 << 20)			 // 容量超过这个大小的缓冲区用完后直接释放，不放回池中
+#define RPC_ZERO_COPY_MIN_SIZE 1024						 // 回复达到这个大小才把缓冲区交给ZeroMQ，更小的回复直接拷贝进消息
+
 // 模板的别名，需要一个外敷类
 //  type_xx<int>::type a = 10;
 template <typename T>
@@ -22,6 +39,91 @@ struct type_xx<void>
 	typedef int8_t type;
 };
 
+// 从函数指针、成员函数指针或可调用对象中取出返回值类型和参数类型
+// 参数去掉引用和const后放进tuple，反序列化时直接写入tuple中的元素
+template <typename T>
+struct function_traits : function_traits<decltype(&T::operator())>
+{
+};
+
+template <typename R, typename... Args>
+struct function_traits<R (*)(Args...)>
+{
+	typedef R return_type;
+	typedef std::tuple<typename std::decay<Args>::type...> args_tuple;
+};
+
+template <typename R, typename C, typename... Args>
+struct function_traits<R (C::*)(Args...)> : function_traits<R (*)(Args...)>
+{
+};
+
+template <typename R, typename C, typename... Args>
+struct function_traits<R (C::*)(Args...) const> : function_traits<R (*)(Args...)>
+{
+};
+
+// 回复缓冲区池：回复序列化到池中的缓冲区后，缓冲区的所有权随消息交给ZeroMQ，不再拷贝到消息中；
+// ZeroMQ发送完消息后（可能在它自己的IO线程中）调用release把缓冲区放回池中，下一个回复复用已分配的容量。
+class reply_buffer_pool
+{
+public:
+	struct buffer
+	{
+		std::vector<char> data;
+		reply_buffer_pool *pool;
+	};
+
+	~reply_buffer_pool();
+	buffer *acquire();							 // 取出一个空的缓冲区，池为空时新建
+	static void release(void *data, void *hint); // ZeroMQ的释放回调，hint是buffer
+
+private:
+	std::mutex m_mutex;
+	std::vector<buffer *> m_free;
+};
+
+reply_buffer_pool::~reply_buffer_pool()
+{
+	for (buffer *item : m_free)
+	{
+		delete item;
+	}
+}
+
+reply_buffer_pool::buffer *reply_buffer_pool::acquire()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_free.empty())
+		{
+			buffer *item = m_free.back();
+			m_free.pop_back();
+			return item;
+		}
+	}
+	buffer *item = new buffer();
+	item->pool = this;
+	return item;
+}
+
+void reply_buffer_pool::release(void *, void *hint)
+{
+	buffer *item = static_cast<buffer *>(hint);
+	reply_buffer_pool *pool = item->pool;
+	item->data.clear();
+	if (item->data.capacity() <= RPC_REPLY_POOL_MAX_CAPACITY)
+	{
+		std::lock_guard<std::mutex> lock(pool->m_mutex);
+		if (pool->m_free.size() < RPC_REPLY_POOL_SIZE)
+		{
+			pool->m_free.push_back(item);
+			return;
+		}
+	}
+	delete item;
+}
+
 class buttonrpc
 {
 
@@ -59,6 +161,7 @@ public:
 		type val() { return val_; } // 返回值
 
 		void set_val(const type &val) { val_ = val; }
+		void set_val(type &&val) { val_ = std::move(val); }
 		void set_code(code_type code) { code_ = code; }
 		void set_msg(msg_type msg) { msg_ = msg; }
 
@@ -71,7 +174,7 @@ public:
 			}
 			return in;
 		}
-		friend Serializer &operator<<(Serializer &out, value_t<T> d)
+		friend Serializer &operator<<(Serializer &out, const value_t<T> &d)
 		{
 			out << d.code_ << d.msg_ << d.val_; // 重载运算符<<
 			return out;
@@ -88,12 +191,18 @@ public:
 
 	// network
 	void as_client(std::string ip, int port); // 客户端
-	void as_server(int port);				  // 服务器
+	void as_async_client(std::string ip, int port); // 异步客户端，可以同时有多个请求在途
+	void as_server(int port, int worker_number = 1); // 服务器，worker_number大于1时使用工作线程池
 	void send(zmq::message_t &data);		  // 发送数据
 	void recv(zmq::message_t &data);		  // 接收数据
 	void set_timeout(uint32_t ms);			  // 设置超时时间
 	void run();
 
+private:
+	void serve(zmq::socket_t &socket); // 在一个REP套接字上循环处理请求
+	void worker_loop();				   // 工作线程：连接到进程内的DEALER，处理分发过来的请求
+	void async_loop();				   // 异步客户端的IO线程：转发请求，按请求ID分发回复
+
 public:
 	// server
 	template <typename F>
@@ -102,156 +211,135 @@ public:
 	template <typename F, typename S>
 	void bind(std::string name, F func, S *s); // 类成员函数
 
-	// client
-	template <typename R>
-	value_t<R> call(std::string name); // 无参
-
-	template <typename R, typename P1>
-	value_t<R> call(std::string name, P1); // 一个参数
-
-	template <typename R, typename P1, typename P2>
-	value_t<R> call(std::string name, P1, P2); // 两个参数
-
-	template <typename R, typename P1, typename P2, typename P3>
-	value_t<R> call(std::string name, P1, P2, P3); // 三个参数
-
-	template <typename R, typename P1, typename P2, typename P3, typename P4>
-	value_t<R> call(std::string name, P1, P2, P3, P4); // 四个参数
-
-	template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5>
-	value_t<R> call(std::string name, P1, P2, P3, P4, P5); // 五个参数
-
-private:
-	Serializer *call_(std::string name, const char *data, int len);
-
-	template <typename R>
-	value_t<R> net_call(Serializer &ds);
+	// client，参数个数不限，依次序列化
+	template <typename R, typename... Params>
+	value_t<R> call(std::string name, const Params &...ps);
 
-	template <typename F>
-	void callproxy(F fun, Serializer *pr, const char *data, int len);
-
-	template <typename F, typename S>
-	void callproxy(F fun, S *s, Serializer *pr, const char *data, int len); // 类成员函数
-
-	// PROXY FUNCTION POINT
-	template <typename R>
-	void callproxy_(R (*func)(), Serializer *pr, const char *data, int len)
-	{
-		callproxy_(std::function<R()>(func), pr, data, len); // 无参函数
-	}
-
-	template <typename R, typename P1>
-	void callproxy_(R (*func)(P1), Serializer *pr, const char *data, int len)
-	{
-		callproxy_(std::function<R(P1)>(func), pr, data, len); // 一个参数
-	}
-
-	template <typename R, typename P1, typename P2>
-	void callproxy_(R (*func)(P1, P2), Serializer *pr, const char *data, int len)
+	// 方法ID：函数名的32位FNV-1a哈希，客户端和服务端各自计算，不需要协商
+	static constexpr uint32_t method_id(std::string_view name)
 	{
-		callproxy_(std::function<R(P1, P2)>(func), pr, data, len);
-	}
-
-	template <typename R, typename P1, typename P2, typename P3>
-	void callproxy_(R (*func)(P1, P2, P3), Serializer *pr, const char *data, int len)
-	{
-		callproxy_(std::function<R(P1, P2, P3)>(func), pr, data, len);
-	}
-
-	template <typename R, typename P1, typename P2, typename P3, typename P4>
-	void callproxy_(R (*func)(P1, P2, P3, P4), Serializer *pr, const char *data, int len)
-	{
-		callproxy_(std::function<R(P1, P2, P3, P4)>(func), pr, data, len);
+		uint32_t hash = 2166136261u;
+		for (char c : name)
+		{
+			hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+		}
+		return hash;
 	}
 
-	template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5>
-	void callproxy_(R (*func)(P1, P2, P3, P4, P5), Serializer *pr, const char *data, int len)
-	{
-		callproxy_(std::function<R(P1, P2, P3, P4, P5)>(func), pr, data, len);
-	}
+	// 当前线程正在处理的请求所属的会话编号，在绑定的函数中调用，用来区分不同客户端的状态
+	static uint64_t session_id() { return current_session(); }
 
-	// PROXY CLASS MEMBER，function不能包装类成员变量或函数，需要配合Bind,传入函数地址和类对象地址
-	template <typename R, typename C, typename S>
-	void callproxy_(R (C::*func)(), S *s, Serializer *pr, const char *data, int len)
-	{
-		callproxy_(std::function<R()>(std::bind(func, s)), pr, data, len);
-	}
+	// async client，立即返回future，不等待回复
+	template <typename R, typename... Params>
+	std::future<value_t<R>> async_call(std::string name, const Params &...ps);
 
-	template <typename R, typename C, typename S, typename P1>
-	void callproxy_(R (C::*func)(P1), S *s, Serializer *pr, const char *data, int len)
-	{
-		callproxy_(std::function<R(P1)>(std::bind(func, s, std::placeholders::_1)), pr, data, len);
-	}
+private:
+	typedef std::function<void(Serializer *, const char *, int)> handler_t;
 
-	template <typename R, typename C, typename S, typename P1, typename P2>
-	void callproxy_(R (C::*func)(P1, P2), S *s, Serializer *pr, const char *data, int len)
+	static uint64_t &current_session()
 	{
-		callproxy_(std::function<R(P1, P2)>(std::bind(func, s, std::placeholders::_1, std::placeholders::_2)), pr, data, len);
+		static thread_local uint64_t session = 0;
+		return session;
 	}
 
-	template <typename R, typename C, typename S, typename P1, typename P2, typename P3>
-	void callproxy_(R (C::*func)(P1, P2, P3), S *s, Serializer *pr, const char *data, int len)
+	// 开放寻址表的一个槽位，index为-1表示空槽
+	struct method_slot
 	{
-		callproxy_(std::function<R(P1, P2, P3)>(std::bind(func, s,
-														  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)),
-				   pr, data, len);
-	}
+		uint32_t id = 0;
+		int index = -1;
+	};
 
-	template <typename R, typename C, typename S, typename P1, typename P2, typename P3, typename P4>
-	void callproxy_(R (C::*func)(P1, P2, P3, P4), S *s, Serializer *pr, const char *data, int len)
-	{
-		callproxy_(std::function<R(P1, P2, P3, P4)>(std::bind(func, s,
-															  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4)),
-				   pr, data, len);
-	}
+	void add_handler(const std::string &name, handler_t handler); // 注册处理函数并重建分发表
+	void rebuild_method_table();
+	int find_handler(uint32_t id, std::string_view name) const; // 先按ID查分发表，找不到再按名字查
 
-	template <typename R, typename C, typename S, typename P1, typename P2, typename P3, typename P4, typename P5>
-	void callproxy_(R (C::*func)(P1, P2, P3, P4, P5), S *s, Serializer *pr, const char *data, int len)
-	{
-		callproxy_(std::function<R(P1, P2, P3, P4, P5)>(std::bind(func, s,
-																  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5)),
-				   pr, data, len);
-	}
+	void call_(uint32_t id, std::string_view name, const char *data, int len, Serializer &ds);
 
-	// PORXY FUNCTIONAL
 	template <typename R>
-	void callproxy_(std::function<R()>, Serializer *pr, const char *data, int len);
-
-	template <typename R, typename P1>
-	void callproxy_(std::function<R(P1)>, Serializer *pr, const char *data, int len);
-
-	template <typename R, typename P1, typename P2>
-	void callproxy_(std::function<R(P1, P2)>, Serializer *pr, const char *data, int len);
+	value_t<R> net_call(Serializer &ds);
 
-	template <typename R, typename P1, typename P2, typename P3>
-	void callproxy_(std::function<R(P1, P2, P3)>, Serializer *pr, const char *data, int len);
+	template <typename R>
+	std::future<value_t<R>> async_net_call(Serializer &ds);
 
-	template <typename R, typename P1, typename P2, typename P3, typename P4>
-	void callproxy_(std::function<R(P1, P2, P3, P4)>, Serializer *pr, const char *data, int len);
+	// 在原始数据上依次反序列化出参数，直接调用目标函数，返回值写入pr
+	template <typename F>
+	static void callproxy_(F &func, Serializer *pr, const char *data, int len);
 
-	template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5>
-	void callproxy_(std::function<R(P1, P2, P3, P4, P5)>, Serializer *pr, const char *data, int len);
+	template <typename F, typename S>
+	static void callproxy_(F &func, S *s, Serializer *pr, const char *data, int len); // 类成员函数
 
 private:
-	std::map<std::string, std::function<void(Serializer *, const char *, int)>> m_handlers; // 函数映射表
-
-	zmq::context_t m_context; // 上下文
-	zmq::socket_t *m_socket;  // 套接字
+	std::vector<std::pair<std::string, handler_t>> m_handlers; // 已绑定的函数名和处理函数
+	std::map<std::string, int, std::less<>> m_handler_names;	   // 函数名到m_handlers下标，按名字查找时使用
+	std::vector<method_slot> m_method_table;					   // 按方法ID线性探测的分发表，大小是2的幂
+
+	reply_buffer_pool m_reply_pool; // 回复缓冲区池，在上下文之前构造，上下文关闭（所有消息释放）后才析构
+	zmq::context_t m_context;		// 上下文
+	zmq::socket_t *m_socket = nullptr;  // 套接字，线程池模式下是面向客户端的ROUTER
+	zmq::socket_t *m_backend = nullptr; // 线程池模式下分发请求给工作线程的DEALER
+	int m_worker_number = 1;			// 工作线程数
+	std::vector<std::thread> m_workers;
+
+	// 异步客户端：DEALER套接字只在IO线程中使用，调用线程通过进程内的PAIR把请求交给IO线程
+	bool m_async = false;
+	zmq::socket_t *m_pipe = nullptr;	// 调用线程一端，由m_pipe_mutex保护
+	zmq::socket_t *m_pipe_io = nullptr; // IO线程一端
+	std::mutex m_pipe_mutex;
+	std::thread m_io_thread;
+	std::atomic<uint32_t> m_next_id{0}; // 请求ID，回复按ID找到对应的处理函数
+	std::mutex m_pending_mutex;
+	std::unordered_map<uint32_t, std::function<void(const char *, int)>> m_pending; // 在途请求
 
 	rpc_err_code m_error_code; // 错误码
 	int m_role;				   // 角色
+	uint64_t m_session_id;	   // 客户端的会话编号，随每个请求发送
 };
 
 buttonrpc::buttonrpc() : m_context(1)
 {
 	m_error_code = RPC_ERR_SUCCESS;
+	// 随机生成会话编号，不同进程、不同客户端对象之间不会重复
+	std::random_device device;
+	m_session_id = (static_cast<uint64_t>(device()) << 32) | device();
 }
 
 buttonrpc::~buttonrpc()
 {
-	m_socket->close(); // 关闭套接字
-	delete m_socket;
-	m_context.close(); // 关闭上下文
+	if (m_io_thread.joinable())
+	{
+		// 空消息通知IO线程退出，之后套接字回到当前线程关闭
+		zmq::message_t stop;
+		{
+			std::lock_guard<std::mutex> lock(m_pipe_mutex);
+			m_pipe->send(stop);
+		}
+		m_io_thread.join();
+	}
+	if (m_pipe != nullptr)
+	{
+		m_pipe->close();
+		delete m_pipe;
+	}
+	if (m_pipe_io != nullptr)
+	{
+		m_pipe_io->close();
+		delete m_pipe_io;
+	}
+	if (m_socket != nullptr)
+	{
+		m_socket->close(); // 关闭套接字
+		delete m_socket;
+	}
+	if (m_backend != nullptr)
+	{
+		m_backend->close();
+		delete m_backend;
+	}
+	m_context.close(); // 关闭上下文，工作线程阻塞中的recv随之返回ETERM并退出
+	for (auto &worker : m_workers)
+	{
+		worker.join();
+	}
 }
 
 // network
@@ -264,10 +352,101 @@ void buttonrpc::as_client(std::string ip, int port)
 	m_socket->connect(os.str()); // 连接到指定的地址
 }
 
-void buttonrpc::as_server(int port)
+/**
+ * 作为异步客户端连接服务器。使用DEALER套接字，不必等上一个请求的回复就可以发送下一个请求，
+ * 每个请求带一个ID帧放在空分隔帧之前，服务端的REP套接字把它当作信封原样带回，回复因此可以乱序到达。
+ * DEALER套接字由后台IO线程独占，async_call可以在任意线程调用。
+ */
+void buttonrpc::as_async_client(std::string ip, int port)
+{
+	m_role = RPC_CLIENT;
+	m_async = true;
+	m_socket = new zmq::socket_t(m_context, ZMQ_DEALER);
+	int linger = 0; // 关闭时丢弃未发出的请求，服务器不在线时析构不会阻塞
+	m_socket->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+	ostringstream os;
+	os << "tcp://" << ip << ":" << port;
+	m_socket->connect(os.str());
+
+	ostringstream endpoint; // 每个实例使用自己的进程内地址
+	endpoint << RPC_ASYNC_ENDPOINT << static_cast<const void *>(this);
+	m_pipe_io = new zmq::socket_t(m_context, ZMQ_PAIR);
+	m_pipe_io->bind(endpoint.str());
+	m_pipe = new zmq::socket_t(m_context, ZMQ_PAIR);
+	m_pipe->connect(endpoint.str());
+	m_io_thread = std::thread(&buttonrpc::async_loop, this);
+}
+
+void buttonrpc::async_loop()
+{
+	zmq::pollitem_t items[] = {
+		{static_cast<void *>(*m_pipe_io), 0, ZMQ_POLLIN, 0},
+		{static_cast<void *>(*m_socket), 0, ZMQ_POLLIN, 0}};
+	zmq::message_t id, delimiter, data;
+	try
+	{
+		while (1)
+		{
+			zmq::poll(items, 2, -1);
+			if (items[0].revents & ZMQ_POLLIN)
+			{
+				// 请求依次是ID帧、空分隔帧和数据帧，原样转发给服务器
+				m_pipe_io->recv(&id);
+				if (!id.more())
+				{
+					return; // 析构发来的退出通知
+				}
+				m_pipe_io->recv(&delimiter);
+				m_pipe_io->recv(&data);
+				m_socket->send(id, ZMQ_SNDMORE);
+				m_socket->send(delimiter, ZMQ_SNDMORE);
+				m_socket->send(data);
+			}
+			if (items[1].revents & ZMQ_POLLIN)
+			{
+				// 回复依次是ID帧、空分隔帧和数据帧
+				m_socket->recv(&id);
+				m_socket->recv(&delimiter);
+				m_socket->recv(&data);
+				uint32_t requestId = 0;
+				if (id.size() != sizeof(requestId))
+				{
+					continue;
+				}
+				memcpy(&requestId, id.data(), sizeof(requestId));
+				std::function<void(const char *, int)> handler;
+				{
+					std::lock_guard<std::mutex> lock(m_pending_mutex);
+					auto itr = m_pending.find(requestId);
+					if (itr == m_pending.end())
+					{
+						continue;
+					}
+					handler = std::move(itr->second);
+					m_pending.erase(itr);
+				}
+				handler(static_cast<const char *>(data.data()), data.size());
+			}
+		}
+	}
+	catch (const zmq::error_t &)
+	{
+		// 上下文关闭，退出线程
+	}
+}
+
+/**
+ * 作为服务器监听端口。worker_number为1时用一个REP套接字在调用run的线程中逐个处理请求；
+ * 大于1时前端用ROUTER接收所有客户端的请求，通过进程内的DEALER轮流分发给worker_number个工作线程，
+ * 每个工作线程用自己的REP套接字处理请求，回复沿原路返回给对应的客户端。
+ * 绑定的函数会被多个工作线程同时调用，需要是线程安全的。
+ */
+void buttonrpc::as_server(int port, int worker_number)
 {
-	m_role = RPC_SERVER;							  // 设置角色为服务器
-	m_socket = new zmq::socket_t(m_context, ZMQ_REP); // 创建一个套接字 参数为上下文和套接字类型	 //ZMQ_REP 用于请求-应答模式
+	m_role = RPC_SERVER; // 设置角色为服务器
+	m_worker_number = worker_number > 1 ? worker_number : 1;
+	// ZMQ_REP 用于请求-应答模式；ZMQ_ROUTER 记录每个请求来自哪个客户端，可以同时处理多个客户端
+	m_socket = new zmq::socket_t(m_context, m_worker_number > 1 ? ZMQ_ROUTER : ZMQ_REP);
 	ostringstream os;
 	os << "tcp://*:" << port;
 	m_socket->bind(os.str()); // 绑定到指定的地址
@@ -297,63 +476,185 @@ void buttonrpc::run()
 	{ // 如果不是服务器
 		return;
 	}
+	if (m_worker_number == 1)
+	{
+		serve(*m_socket);
+		return;
+	}
+	// 先绑定进程内地址，工作线程才能连接
+	m_backend = new zmq::socket_t(m_context, ZMQ_DEALER);
+	m_backend->bind(RPC_WORKER_ENDPOINT);
+	for (int i = 0; i < m_worker_number; i++)
+	{
+		m_workers.emplace_back(&buttonrpc::worker_loop, this);
+	}
+	// 在前端和后端之间双向转发消息，直到上下文关闭
+	try
+	{
+		zmq::proxy(static_cast<void *>(*m_socket), static_cast<void *>(*m_backend), nullptr);
+	}
+	catch (const zmq::error_t &)
+	{
+	}
+}
+
+void buttonrpc::worker_loop()
+{
+	zmq::socket_t socket(m_context, ZMQ_REP);
+	socket.connect(RPC_WORKER_ENDPOINT);
+	try
+	{
+		serve(socket);
+	}
+	catch (const zmq::error_t &)
+	{
+		// 上下文关闭，退出线程
+	}
+	socket.close();
+}
+
+void buttonrpc::serve(zmq::socket_t &socket)
+{
+	// 消息在循环间复用，函数名直接引用消息中的字节；大的返回值写入池中的缓冲区后直接交给ZeroMQ发送，
+	// 稳定后每个请求既不分配内存，也不拷贝大的回复
+	zmq::message_t data;
+	uint32_t id = 0;
+	std::string_view funname;
+	Serializer reply;
 	while (1)
 	{
-		zmq::message_t data;								  // 创建一个消息
-		recv(data);											  // 接收数据 没消息就阻塞
-		StreamBuffer iodev((char *)data.data(), data.size()); // 创建一个流缓冲区
-		Serializer ds(iodev);								  // 创建一个序列化器
+		data.rebuild();
+		socket.recv(&data);											  // 接收数据 没消息就阻塞
+		Serializer ds(static_cast<const char *>(data.data()), data.size()); // 直接读取消息，不拷贝
 
-		std::string funname;
-		ds >> funname;															  // 读取函数名
-		Serializer *r = call_(funname, ds.current(), ds.size() - funname.size()); // 调用函数
+		ds >> id >> funname >> current_session(); // 读取方法ID、函数名和会话编号
+		reply.clear();
+		call_(id, funname, ds.current(), ds.remaining(), reply); // 调用函数
 
-		zmq::message_t retmsg(r->size());			 // 创建一个消息
-		memcpy(retmsg.data(), r->data(), r->size()); // 拷贝数据
-		send(retmsg);								 // 发送数据
-		delete r;
+		if (reply.size() < RPC_ZERO_COPY_MIN_SIZE)
+		{
+			// 小的回复（OK、(integer) 1等）拷贝进消息，走ZeroMQ的内联小消息，不分配引用计数也不经过池的锁
+			zmq::message_t retmsg(reply.data(), reply.size());
+			socket.send(retmsg);
+			continue;
+		}
+		// 回复和池中的空缓冲区交换，缓冲区的所有权随消息交给ZeroMQ，发送完后放回池中
+		reply_buffer_pool::buffer *buffer = m_reply_pool.acquire();
+		reply.swap_buffer(buffer->data);
+		zmq::message_t retmsg(buffer->data.data(), buffer->data.size(), &reply_buffer_pool::release, buffer); // 创建一个消息
+		socket.send(retmsg);																				 // 发送数据
 	}
 }
 
-// 处理函数相关
-Serializer *buttonrpc::call_(std::string name, const char *data, int len)
+// 处理函数相关，返回值写入ds
+void buttonrpc::call_(uint32_t id, std::string_view name, const char *data, int len, Serializer &ds)
 {
-	Serializer *ds = new Serializer(); // 创建一个序列化器
-	if (m_handlers.find(name) == m_handlers.end())
-	{																   // 如果没有找到函数
-		(*ds) << value_t<int>::code_type(RPC_ERR_FUNCTIION_NOT_BIND);  // 设置错误码
-		(*ds) << value_t<int>::msg_type("function not bind: " + name); // 设置错误信息
-		return ds;
+	int index = find_handler(id, name);
+	if (index < 0)
+	{																			  // 如果没有找到函数
+		ds << value_t<int>::code_type(RPC_ERR_FUNCTIION_NOT_BIND);				  // 设置错误码
+		ds << value_t<int>::msg_type("function not bind: " + std::string(name)); // 设置错误信息
+		return;
 	}
 
-	auto fun = m_handlers[name]; // 获取函数
-	fun(ds, data, len);			 // 调用函数
-	ds->reset();				 // 重置序列号容器
-	return ds;
+	m_handlers[index].second(&ds, data, len); // 调用函数
+	ds.reset();								  // 重置序列号容器
 }
 
-template <typename F>
-void buttonrpc::bind(std::string name, F func) // 普通函数
+/**
+ * 注册处理函数，同名的函数会被替换。绑定只在run之前进行，之后分发表只读，工作线程可以同时查找。
+ */
+void buttonrpc::add_handler(const std::string &name, handler_t handler)
 {
-	m_handlers[name] = std::bind(&buttonrpc::callproxy<F>, this, func, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	auto itr = m_handler_names.find(name);
+	if (itr != m_handler_names.end())
+	{
+		m_handlers[itr->second].second = std::move(handler);
+		return;
+	}
+	m_handler_names.emplace(name, static_cast<int>(m_handlers.size()));
+	m_handlers.emplace_back(name, std::move(handler));
+	rebuild_method_table();
 }
 
-template <typename F, typename S>
-inline void buttonrpc::bind(std::string name, F func, S *s) // 类函数
+/**
+ * 按方法ID重建分发表。表的大小至少是函数个数的两倍，线性探测很快就能遇到空槽。
+ * 两个函数名的ID相同时只有先绑定的进入分发表，后一个只能按名字找到。
+ */
+void buttonrpc::rebuild_method_table()
 {
-	m_handlers[name] = std::bind(&buttonrpc::callproxy<F, S>, this, func, s, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	size_t capacity = 8;
+	while (capacity < m_handlers.size() * 2)
+	{
+		capacity <<= 1;
+	}
+	m_method_table.assign(capacity, method_slot());
+	for (int i = 0; i < static_cast<int>(m_handlers.size()); i++)
+	{
+		uint32_t id = method_id(m_handlers[i].first);
+		size_t pos = id & (capacity - 1);
+		bool collision = false;
+		while (m_method_table[pos].index >= 0)
+		{
+			if (m_method_table[pos].id == id)
+			{
+				collision = true;
+				break;
+			}
+			pos = (pos + 1) & (capacity - 1);
+		}
+		if (!collision)
+		{
+			m_method_table[pos].id = id;
+			m_method_table[pos].index = i;
+		}
+	}
 }
 
+/**
+ * 查找处理函数。按ID命中后还要比较函数名，防止不同的名字哈希到同一个ID；
+ * 没有命中时退回按名字查找，按名字查找时用string_view比较，不分配内存。
+ * @return 处理函数在m_handlers中的下标，找不到返回-1
+ */
+int buttonrpc::find_handler(uint32_t id, std::string_view name) const
+{
+	if (!m_method_table.empty())
+	{
+		size_t mask = m_method_table.size() - 1;
+		for (size_t pos = id & mask; m_method_table[pos].index >= 0; pos = (pos + 1) & mask)
+		{
+			const method_slot &slot = m_method_table[pos];
+			if (slot.id == id)
+			{
+				if (m_handlers[slot.index].first == name)
+				{
+					return slot.index;
+				}
+				break;
+			}
+		}
+	}
+	auto itr = m_handler_names.find(name);
+	return itr == m_handler_names.end() ? -1 : itr->second;
+}
+
+/**
+ * 绑定普通函数或可调用对象。映射表中保存的lambda直接持有func，
+ * 调用时只有映射表这一层std::function，不再经过std::bind和第二次包装。
+ * 函数按名字的哈希注册到分发表，请求到达时按ID直接找到处理函数。
+ */
 template <typename F>
-void buttonrpc::callproxy(F fun, Serializer *pr, const char *data, int len) // 代理普通函数
+void buttonrpc::bind(std::string name, F func) // 普通函数
 {
-	callproxy_(fun, pr, data, len);
+	add_handler(name, [func](Serializer *pr, const char *data, int len) mutable
+				{ callproxy_(func, pr, data, len); });
 }
 
 template <typename F, typename S>
-inline void buttonrpc::callproxy(F fun, S *s, Serializer *pr, const char *data, int len) // 代理类函数
+inline void buttonrpc::bind(std::string name, F func, S *s) // 类函数
 {
-	callproxy_(fun, s, pr, data, len);
+	add_handler(name, [func, s](Serializer *pr, const char *data, int len) mutable
+				{ callproxy_(func, s, pr, data, len); });
 }
 
 #pragma region 区分返回值
@@ -371,104 +672,64 @@ typename std::enable_if<!std::is_same<R, void>::value, typename type_xx<R>::type
 }
 #pragma endregion
 
-template <typename R>
-void buttonrpc::callproxy_(std::function<R()> func, Serializer *pr, const char *data, int len)
+/**
+ * 参数按顺序反序列化到tuple中，再移动给目标函数，返回值写入pr。
+ * @param func 目标函数
+ * @param pr 写入返回值的序列化器
+ * @param data 参数的序列化数据
+ * @param len 数据长度
+ */
+template <typename F>
+inline void buttonrpc::callproxy_(F &func, Serializer *pr, const char *data, int len)
 {
+	typedef typename function_traits<F>::return_type R;
+	typename function_traits<F>::args_tuple args;
+	Serializer ds(data, len);
+	std::apply([&ds](auto &...arg)
+			   { (void)(ds >> ... >> arg); },
+			   args);
 	/*
 	typename关键字用于指定一个依赖类型,依赖类型是指在模板参数中定义的类型，其具体类型直到模板实例化时才能确定。
 	ype_xx<R>::type是一个依赖类型，因为它依赖于模板参数R。在这种情况下，你需要使用typename关键字来告诉编译器type_xx<R>::type是一个类型。
 	如果不使用typename，编译器可能会将type_xx<R>::type解析为一个静态成员
 	*/
-	typename type_xx<R>::type r = call_helper<R>(std::bind(func));
-
+	typename type_xx<R>::type r = call_helper<R>([&]
+												 { return std::apply([&func](auto &...arg)
+																	 { return func(std::move(arg)...); },
+																	 args); });
 	value_t<R> val;
 	val.set_code(RPC_ERR_SUCCESS);
-	val.set_val(r);
+	val.set_val(std::move(r));
 	(*pr) << val;
 }
 
-template <typename R, typename P1>
-void buttonrpc::callproxy_(std::function<R(P1)> func, Serializer *pr, const char *data, int len)
-{
-	Serializer ds(StreamBuffer(data, len));
-	P1 p1;
-	ds >> p1;
-	typename type_xx<R>::type r = call_helper<R>(std::bind(func, p1));
-
-	value_t<R> val;
-	val.set_code(RPC_ERR_SUCCESS);
-	val.set_val(r);
-	(*pr) << val;
-}
-
-template <typename R, typename P1, typename P2>
-void buttonrpc::callproxy_(std::function<R(P1, P2)> func, Serializer *pr, const char *data, int len)
-{
-	Serializer ds(StreamBuffer(data, len));
-	P1 p1;
-	P2 p2;
-	ds >> p1 >> p2;
-	typename type_xx<R>::type r = call_helper<R>(std::bind(func, p1, p2));
-
-	value_t<R> val;
-	val.set_code(RPC_ERR_SUCCESS);
-	val.set_val(r);
-	(*pr) << val;
-}
-
-template <typename R, typename P1, typename P2, typename P3>
-void buttonrpc::callproxy_(std::function<R(P1, P2, P3)> func, Serializer *pr, const char *data, int len)
-{
-	Serializer ds(StreamBuffer(data, len));
-	P1 p1;
-	P2 p2;
-	P3 p3;
-	ds >> p1 >> p2 >> p3;
-	typename type_xx<R>::type r = call_helper<R>(std::bind(func, p1, p2, p3));
-	value_t<R> val;
-	val.set_code(RPC_ERR_SUCCESS);
-	val.set_val(r);
-	(*pr) << val;
-}
-
-template <typename R, typename P1, typename P2, typename P3, typename P4>
-void buttonrpc::callproxy_(std::function<R(P1, P2, P3, P4)> func, Serializer *pr, const char *data, int len)
+template <typename F, typename S>
+inline void buttonrpc::callproxy_(F &func, S *s, Serializer *pr, const char *data, int len)
 {
-	Serializer ds(StreamBuffer(data, len));
-	P1 p1;
-	P2 p2;
-	P3 p3;
-	P4 p4;
-	ds >> p1 >> p2 >> p3 >> p4;
-	typename type_xx<R>::type r = call_helper<R>(std::bind(func, p1, p2, p3, p4));
+	typedef typename function_traits<F>::return_type R;
+	typename function_traits<F>::args_tuple args;
+	Serializer ds(data, len);
+	std::apply([&ds](auto &...arg)
+			   { (void)(ds >> ... >> arg); },
+			   args);
+	typename type_xx<R>::type r = call_helper<R>([&]
+												 { return std::apply([&func, s](auto &...arg)
+																	 { return (s->*func)(std::move(arg)...); },
+																	 args); });
 	value_t<R> val;
 	val.set_code(RPC_ERR_SUCCESS);
-	val.set_val(r);
-	(*pr) << val;
-}
-
-template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5>
-void buttonrpc::callproxy_(std::function<R(P1, P2, P3, P4, P5)> func, Serializer *pr, const char *data, int len)
-{
-	Serializer ds(StreamBuffer(data, len));
-	P1 p1;
-	P2 p2;
-	P3 p3;
-	P4 p4;
-	P5 p5;
-	ds >> p1 >> p2 >> p3 >> p4 >> p5;
-	typename type_xx<R>::type r = call_helper<R>(std::bind(func, p1, p2, p3, p4, p5));
-	value_t<R> val;
-	val.set_code(RPC_ERR_SUCCESS);
-	val.set_val(r);
+	val.set_val(std::move(r));
 	(*pr) << val;
 }
 
 template <typename R>
 inline buttonrpc::value_t<R> buttonrpc::net_call(Serializer &ds)
 {
-	zmq::message_t request(ds.size() + 1);
-	memcpy(request.data(), ds.data(), ds.size());
+	if (m_async)
+	{
+		return async_net_call<R>(ds).get(); // 异步客户端上的同步调用
+	}
+	zmq::message_t request(ds.data(), ds.size());
 	if (m_error_code != RPC_ERR_RECV_TIMEOUT)
 	{
 		send(request);
@@ -485,58 +746,57 @@ inline buttonrpc::value_t<R> buttonrpc::net_call(Serializer &ds)
 		return val;
 	}
 	m_error_code = RPC_ERR_SUCCESS;
-	ds.clear();
-	ds.write_raw_data((char *)reply.data(), reply.size());
-	ds.reset();
-
-	ds >> val;
+	Serializer in(static_cast<const char *>(reply.data()), reply.size()); // 直接读取回复，不拷贝
+	in >> val;
 	return val;
 }
 
+/**
+ * 发送请求后立即返回，回复由IO线程按请求ID写入对应的future。
+ * @param ds 函数名和参数序列化后的数据
+ * @return 回复到达后就绪的future
+ */
 template <typename R>
-inline buttonrpc::value_t<R> buttonrpc::call(std::string name)
-{
-	Serializer ds;
-	ds << name;
-	return net_call<R>(ds);
-}
-
-template <typename R, typename P1>
-inline buttonrpc::value_t<R> buttonrpc::call(std::string name, P1 p1)
-{
-	Serializer ds;
-	ds << name << p1;
-	return net_call<R>(ds);
-}
-
-template <typename R, typename P1, typename P2>
-inline buttonrpc::value_t<R> buttonrpc::call(std::string name, P1 p1, P2 p2)
-{
-	Serializer ds;
-	ds << name << p1 << p2;
-	return net_call<R>(ds);
-}
-
-template <typename R, typename P1, typename P2, typename P3>
-inline buttonrpc::value_t<R> buttonrpc::call(std::string name, P1 p1, P2 p2, P3 p3)
+inline std::future<buttonrpc::value_t<R>> buttonrpc::async_net_call(Serializer &ds)
 {
-	Serializer ds;
-	ds << name << p1 << p2 << p3;
-	return net_call<R>(ds);
+	// std::function要求可拷贝，promise放在shared_ptr中
+	auto result = std::make_shared<std::promise<value_t<R>>>();
+	std::future<value_t<R>> future = result->get_future();
+	uint32_t requestId = m_next_id++;
+	{
+		std::lock_guard<std::mutex> lock(m_pending_mutex);
+		m_pending[requestId] = [result](const char *data, int len)
+		{
+			value_t<R> val;
+			Serializer in(data, len);
+			in >> val;
+			result->set_value(std::move(val));
+		};
+	}
+	zmq::message_t id(&requestId, sizeof(requestId));
+	zmq::message_t delimiter;
+	zmq::message_t request(ds.data(), ds.size());
+	std::lock_guard<std::mutex> lock(m_pipe_mutex);
+	m_pipe->send(id, ZMQ_SNDMORE);
+	m_pipe->send(delimiter, ZMQ_SNDMORE);
+	m_pipe->send(request);
+	return future;
 }
 
-template <typename R, typename P1, typename P2, typename P3, typename P4>
-inline buttonrpc::value_t<R> buttonrpc::call(std::string name, P1 p1, P2 p2, P3 p3, P4 p4)
+template <typename R, typename... Params>
+inline buttonrpc::value_t<R> buttonrpc::call(std::string name, const Params &...ps)
 {
 	Serializer ds;
-	ds << name << p1 << p2 << p3 << p4;
+	ds << method_id(name) << name << m_session_id; // 服务端按ID分发，名字用于校验和回退查找，会话编号区分客户端
+	(void)(ds << ... << ps);
 	return net_call<R>(ds);
 }
 
-template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5>
-inline buttonrpc::value_t<R> buttonrpc::call(std::string name, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5)
+template <typename R, typename... Params>
+inline std::future<buttonrpc::value_t<R>> buttonrpc::async_call(std::string name, const Params &...ps)
 {
 	Serializer ds;
-	ds << name << p1 << p2 << p3 << p4 << p5;
-	return net_call<R>(ds);
+	ds << method_id(name) << name << m_session_id; // 服务端按ID分发，名字用于校验和回退查找，会话编号区分客户端
+	(void)(ds << ... << ps);
+	return async_net_call<R>(ds);
 }
@@ -1,11 +1,76 @@
 #include <iostream>
 #include <string>
+#include <deque>
+#include <chrono>
+#include <future>
 #include "buttonrpc.hpp"
 using namespace std;
-int main() {
+
+/**
+ * 批量模式：用异步客户端发送count条set命令，同时最多有pipeline个请求在途，
+ * 不必每条命令等一次网络往返，最后打印每秒完成的命令数。
+ * batch大于1时每个请求通过redis_batch携带batch条命令。
+ * @param hostName 服务器地址
+ * @param port 服务器端口
+ * @param count 命令总数
+ * @param pipeline 在途请求的最大数量
+ * @param batch 每个请求携带的命令数
+ */
+void runBulk(const string& hostName, int port, int count, int pipeline, int batch) {
+    typedef buttonrpc::value_t<vector<string>> batch_value;
+    buttonrpc client;
+    client.as_async_client(hostName, port);
+    deque<future<buttonrpc::value_t<string>>> inflight;
+    deque<future<batch_value>> inflightBatches;
+    int failed = 0;
+    auto start = chrono::steady_clock::now();
+    vector<string> commands;
+    for (int i = 0; i < count; i++) {
+        string command = "set key:" + to_string(i) + " value:" + to_string(i);
+        if (batch <= 1) {
+            if ((int)inflight.size() >= pipeline) {
+                if (!inflight.front().get().valid()) failed++;
+                inflight.pop_front();
+            }
+            inflight.push_back(client.async_call<string>("redis_command", command));
+            continue;
+        }
+        commands.push_back(std::move(command));
+        if ((int)commands.size() < batch && i != count - 1) continue;
+        if ((int)inflightBatches.size() >= pipeline) {
+            if (!inflightBatches.front().get().valid()) failed++;
+            inflightBatches.pop_front();
+        }
+        inflightBatches.push_back(client.async_call<vector<string>>("redis_batch", commands));
+        commands.clear();
+    }
+    while (!inflight.empty()) {
+        if (!inflight.front().get().valid()) failed++;
+        inflight.pop_front();
+    }
+    while (!inflightBatches.empty()) {
+        if (!inflightBatches.front().get().valid()) failed++;
+        inflightBatches.pop_front();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << count << " commands in " << seconds << " s, "
+         << (seconds > 0 ? count / seconds : 0) << " ops/sec, pipeline " << pipeline
+         << ", batch " << batch << ", failed requests " << failed << endl;
+}
+
+int main(int argc, char* argv[]) {
     string hostName = "127.0.0.1";
     int port = 5555;
 
+    // ./client bulk [命令数] [在途请求数] [每个请求的命令数]
+    if (argc > 1 && string(argv[1]) == "bulk") {
+        int count = argc > 2 ? stoi(argv[2]) : 100000;
+        int pipeline = argc > 3 ? stoi(argv[3]) : 64;
+        int batch = argc > 4 ? stoi(argv[4]) : 1;
+        runBulk(hostName, port, count, max(1, pipeline), max(1, batch));
+        return 0;
+    }
+
     buttonrpc client;
     client.as_client(hostName, port);
     client.set_timeout(2000);
@@ -16,7 +81,7 @@ int main() {
         std::cout << hostName << ":" << port << "> ";
         std::getline(std::cin, message);
         string res = client.call<string>("redis_command", message).val();
-        //添加结束字符 
+        //添加结束字符
         if(res.find("stop") != std::string::npos){
             break;
         }
@@ -3,7 +3,9 @@
 #define GLOBAL
 #include<iostream>
 #include<unordered_map>
+#include<unordered_set>
 #include<sstream>
+#include<string_view>
 enum SET_MODEL{ //set命令的模式
     NONE,NX,XX
 };
@@ -33,47 +35,91 @@ enum Command{ //命令枚举
     LPOP,
     RPOP,
     LRANGE,
+    LINDEX,
+    LSET,
+    LTRIM,
+    LLEN,
     HSET,
     HGET,
     HDEL,
     HKEYS,
     HVALS,
+    HMGET,
+    HGETALL,
+    HINCRBY,
+    FLUSHDB,
+    SWAPDB,
+    MOVE,
     INVALID_COMMAND
 };
 
-static std::unordered_map<std::string,enum Command>commandMaps={ //命令映射
-    {"set",SET},
-    {"setnx",SETNX},
-    {"setex",SETEX},
-    {"get",GET},
-    {"select",SELECT},
-    {"dbsize",DBSIZE},
-    {"exists",EXISTS},
-    {"del",DEL},
-    {"rename",RENAME},
-    {"incr",INCR},
-    {"incrby",INCRBY},
-    {"incrbyfloat",INCRBYFLOAT},
-    {"decr",DECR},
-    {"decrby",DECRBY},
-    {"mset",MSET},
-    {"mget",MGET},
-    {"strlen",STRLEN},
-    {"append",APPEND},
-    {"keys",KEYS},
-    {"lpush",LPUSH},
-    {"rpush",RPUSH},
-    {"lpop",LPOP},
-    {"rpop",RPOP},
-    {"lrange",LRANGE},
-    {"hset",HSET},
-    {"hget",HGET},
-    {"hdel",HDEL},
-    {"hkeys",HKEYS},
-    {"hvals",HVALS}
+struct KeySpec{ //命令中key的位置：从first到last（负数表示从末尾倒数），每隔step个参数一个key；first为0表示无法确定
+    int first;
+    int last;
+    int step;
 };
 
+static constexpr KeySpec NO_KEYS={0,0,0}; //不访问key或无法确定访问哪些key（如select、keys、flushdb），事务执行时独占整个键空间
+static constexpr KeySpec FIRST_KEY={1,1,1}; //第一个参数是key
+static constexpr KeySpec ALL_KEYS={1,-1,1}; //所有参数都是key
 
+struct CommandInfo{ //命令名（小写）、命令枚举、是否修改数据（修改数据的命令需要写入追加日志）、key的位置（事务据此只锁住涉及的分片）
+    std::string_view name;
+    enum Command command;
+    bool write;
+    KeySpec keys;
+};
+
+static constexpr CommandInfo commandInfos[]={ //命令映射，编译期据此生成分发表
+    {"set",SET,true,FIRST_KEY},
+    {"setnx",SETNX,true,FIRST_KEY},
+    {"setex",SETEX,true,FIRST_KEY},
+    {"get",GET,false,FIRST_KEY},
+    {"select",SELECT,false,NO_KEYS},
+    {"dbsize",DBSIZE,false,NO_KEYS},
+    {"exists",EXISTS,false,ALL_KEYS},
+    {"del",DEL,true,ALL_KEYS},
+    {"rename",RENAME,true,{1,2,1}},
+    {"incr",INCR,true,FIRST_KEY},
+    {"incrby",INCRBY,true,FIRST_KEY},
+    {"incrbyfloat",INCRBYFLOAT,true,FIRST_KEY},
+    {"decr",DECR,true,FIRST_KEY},
+    {"decrby",DECRBY,true,FIRST_KEY},
+    {"mset",MSET,true,{1,-1,2}},
+    {"mget",MGET,false,ALL_KEYS},
+    {"strlen",STRLEN,false,FIRST_KEY},
+    {"append",APPEND,true,FIRST_KEY},
+    {"keys",KEYS,false,NO_KEYS},
+    {"lpush",LPUSH,true,FIRST_KEY},
+    {"rpush",RPUSH,true,FIRST_KEY},
+    {"lpop",LPOP,true,FIRST_KEY},
+    {"rpop",RPOP,true,FIRST_KEY},
+    {"lrange",LRANGE,false,FIRST_KEY},
+    {"lindex",LINDEX,false,FIRST_KEY},
+    {"lset",LSET,true,FIRST_KEY},
+    {"ltrim",LTRIM,true,FIRST_KEY},
+    {"llen",LLEN,false,FIRST_KEY},
+    {"hset",HSET,true,FIRST_KEY},
+    {"hget",HGET,false,FIRST_KEY},
+    {"hdel",HDEL,true,FIRST_KEY},
+    {"hkeys",HKEYS,false,FIRST_KEY},
+    {"hvals",HVALS,false,FIRST_KEY},
+    {"hmget",HMGET,false,FIRST_KEY},
+    {"hgetall",HGETALL,false,FIRST_KEY},
+    {"hincrby",HINCRBY,true,FIRST_KEY},
+    {"flushdb",FLUSHDB,true,NO_KEYS},
+    {"swapdb",SWAPDB,true,NO_KEYS},
+    {"move",MOVE,true,NO_KEYS}
+};
+
+#define ERROR_REPLY_PREFIX "(error) " //错误回复的前缀，和redis-cli显示错误的格式相同，RESP据此编码为-错误
+
+//把错误信息包装为错误回复，code为Redis的错误类型（ERR、WRONGTYPE、EXECABORT等）
+inline std::string errorReply(std::string_view message,std::string_view code="ERR"){
+    std::string reply(ERROR_REPLY_PREFIX);
+    reply.append(code).append(" ").append(message);
+    return reply;
+}
 
 static std::vector<std::string> split(const std::string &s, char delimiter=' ') {
     std::vector<std::string> tokens;
@@ -1,12 +1,38 @@
 #include "RedisServer.h"
 #include "buttonrpc.hpp"
+#include "RespServer.h"
+#include <algorithm>
+#include <thread>
 
 int main() {
     buttonrpc server;  // 创建一个buttonrpc服务器实例
-    server.as_server(5555);  // 将服务器设置为监听端口5555
+    // 将服务器设置为监听端口5555，每个CPU核心一个工作线程并行处理请求
+    server.as_server(5555, std::max(1u, std::thread::hardware_concurrency()));
     //server.bind("redis_command", redis_command);  // 绑定一个名为"redis_command"的函数到服务器，该函数未在代码中定义
     RedisServer::getInstance()->start();  // 启动Redis服务器实例
-    server.bind("redis_command", &RedisServer::handleClient, RedisServer::getInstance());  // 绑定一个名为"redis_command"的函数到服务器，该函数是RedisServer类的成员函数，用于处理客户端请求
+    RedisServer *redisServer = RedisServer::getInstance();
+    // 绑定一个名为"redis_command"的函数到服务器，用于处理客户端请求；命令在请求所属客户端的会话中执行，客户端退出时释放会话
+    server.bind("redis_command", [redisServer](std::string_view data) {
+        uint64_t sessionId = buttonrpc::session_id();
+        std::string reply;
+        {
+            std::shared_ptr<RedisServer::Session> session = redisServer->getSession(sessionId);
+            RedisServer::SessionScope scope(*session);
+            reply = redisServer->handleClient(data);
+        }
+        if (reply == "stop") redisServer->releaseSession(sessionId);
+        return reply;
+    });
+    // 一个请求携带多条命令，按顺序返回每条命令的结果
+    server.bind("redis_batch", [redisServer](std::vector<std::string> commands) {
+        std::shared_ptr<RedisServer::Session> session = redisServer->getSession(buttonrpc::session_id());
+        RedisServer::SessionScope scope(*session);
+        return redisServer->handleBatch(std::move(commands));
+    });
+    RespServer respServer(RedisServer::getInstance());  // 同时在6379端口提供RESP协议，redis-cli和redis-benchmark可以直接连接
+    if (!respServer.start()) {
+        std::cout << "failed to listen on RESP port " << DEFAULT_RESP_PORT << std::endl;
+    }
    // std::cout << "run rpc server on: " << 5555 << std::endl;  // 打印服务器运行信息，但此行被注释掉
     server.run();  // 运行服务器，等待客户端连接和请求
 
@@ -0,0 +1,131 @@
+#include "AppendOnlyFile.h"
+#include "ParserFlyweightFactory.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#define AOF_TEST_FILE "append_only_file_test.aof"
+#define AOF_TEST_THREADS 4
+#define AOF_TEST_OPERATIONS 20000
+
+namespace
+{
+ParserFlyweightFactory factory;
+
+// 执行一条命令，命令修改数据后由RedisHelper写入日志
+std::string execute(const std::vector<std::string> &command)
+{
+    TokenBuffer tokens;
+    viewTokens(command, tokens);
+    RedisHelper::LoggedCommand loggedCommand(tokens);
+    return factory.getParser(tokens.front())->parse(tokens);
+}
+
+// 所有数据库的内容，用重写日志时生成的重建命令表示
+std::vector<std::vector<std::string>> dumpAll(RedisHelper &helper)
+{
+    std::vector<std::vector<std::string>> commands;
+    helper.rewriteCommands([&commands](const std::vector<std::string> &command)
+                           { commands.push_back(command); });
+    return commands;
+}
+
+// 几个key上的随机写命令，有的会失败（类型不对、key不存在），失败的命令不能写入日志
+std::vector<std::string> randomCommand(std::mt19937 &random)
+{
+    switch (random() % 12)
+    {
+    case 0:
+        return {"incrby", "n", std::to_string(random() % 10)};
+    case 1:
+        return {"set", "n", std::to_string(random() % 100)};
+    case 2:
+        return {"append", "s", "ab"};
+    case 3:
+        return {"del", "s", "n", "missing"};
+    case 4:
+        return {"rpush", "l", std::to_string(random() % 100)};
+    case 5:
+        return {"lpop", "l"};
+    case 6:
+        return {"hincrby", "h", "f" + std::to_string(random() % 3), "1"};
+    case 7:
+        return {"mset", "n", std::to_string(random() % 100), "s", "z"};
+    case 8:
+        return {"lpush", "n", "x"};
+    case 9:
+        return {"append", "n", "1"};
+    case 10:
+        return {"move", "s", "1"};
+    default:
+        return random() % 10 == 0 ? std::vector<std::string>{"swapdb", "0", "1"} : std::vector<std::string>{"incrby", "s", "1"};
+    }
+}
+
+// 多个线程并发修改相同的key，日志中的记录顺序必须和执行顺序一致：重放日志得到的数据和执行后的数据相同
+void testConcurrentSameKeyReplay()
+{
+    std::remove(AOF_TEST_FILE);
+    std::shared_ptr<RedisHelper> live = std::make_shared<RedisHelper>();
+    for (int i = 0; i < 2; i++)
+    {
+        live->select(i);
+        live->flushdb();
+    }
+    live->select(0);
+    CommandParser::setRedisHelper(live);
+    std::unique_ptr<AppendOnlyFile> appendOnlyFile(new AppendOnlyFile(AOF_TEST_FILE, FSYNC_NO));
+    live->setAppendOnlyFile(appendOnlyFile.get());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < AOF_TEST_THREADS; t++)
+    {
+        threads.emplace_back([t]()
+                             {
+            std::atomic<int> dataBaseIndex{t % 2}; // 一半线程在1号数据库，日志中会穿插select记录
+            RedisHelper::SessionDataBase session(dataBaseIndex);
+            std::mt19937 random(20240601 + t);
+            for (int i = 0; i < AOF_TEST_OPERATIONS; i++)
+            {
+                execute(randomCommand(random));
+            } });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    live->setAppendOnlyFile(nullptr);
+    appendOnlyFile.reset(); // 写完缓冲区中的记录
+
+    std::shared_ptr<RedisHelper> replayed = std::make_shared<RedisHelper>();
+    for (int i = 0; i < 2; i++)
+    {
+        replayed->select(i);
+        replayed->flushdb();
+    }
+    replayed->select(0);
+    CommandParser::setRedisHelper(replayed);
+    int failed = 0;
+    int count = AppendOnlyFile::replay(AOF_TEST_FILE, [&failed](TokenSpan tokens, const AppendOnlyFile::Position &)
+                                       {
+        if (factory.getParser(tokens.front())->parse(tokens).compare(0, std::strlen(ERROR_REPLY_PREFIX), ERROR_REPLY_PREFIX) == 0)
+        {
+            failed++;
+        } });
+    CHECK(count > 0);
+    CHECK(failed == 0);
+    replayed->select(0);
+    CHECK(dumpAll(*live) == dumpAll(*replayed));
+    std::remove(AOF_TEST_FILE);
+}
+}
+
+int main()
+{
+    testConcurrentSameKeyReplay();
+    return testResult();
+}
@@ -0,0 +1,162 @@
+#include "RedisValue/CompactHash.h"
+#include "TestCheck.h"
+#include <map>
+#include <random>
+#include <string>
+
+namespace
+{
+// 哈希中的内容和参照的map完全一致
+bool sameContent(const CompactHash &hash, const std::map<std::string, std::string> &expected)
+{
+    if (hash.size() != expected.size())
+    {
+        return false;
+    }
+    size_t visited = 0;
+    bool same = true;
+    hash.forEach([&](std::string_view field, std::string_view value)
+                 {
+        auto it = expected.find(std::string(field));
+        same = same && it != expected.end() && it->second == value;
+        visited++; });
+    return same && visited == expected.size();
+}
+
+// 紧凑数组中字段数超过上限时转换为哈希表，转换前后内容不变
+void testConvertByCount()
+{
+    CompactHash hash;
+    std::map<std::string, std::string> expected;
+    for (int i = 0; i < HASH_MAX_LISTPACK_ENTRIES; i++)
+    {
+        std::string field = "field" + std::to_string(i);
+        CHECK(hash.set(field, std::to_string(i)));
+        expected[field] = std::to_string(i);
+    }
+    CHECK(hash.isPacked());
+    CHECK(!hash.set("field0", "updated")); // 覆盖已有字段不增加字段数
+    expected["field0"] = "updated";
+    CHECK(hash.isPacked());
+    CHECK(sameContent(hash, expected));
+    CHECK(hash.set("overflow", "x"));
+    expected["overflow"] = "x";
+    CHECK(!hash.isPacked());
+    CHECK(sameContent(hash, expected));
+}
+
+// 字段名或值超过HASH_MAX_LISTPACK_VALUE时转换为哈希表
+void testConvertByLength()
+{
+    CompactHash hash;
+    hash.set("short", "value");
+    CHECK(hash.isPacked());
+    std::string longValue(HASH_MAX_LISTPACK_VALUE + 1, 'v');
+    CHECK(hash.set("long", longValue));
+    CHECK(!hash.isPacked());
+    std::string_view value;
+    CHECK(hash.find("short", value) && value == "value");
+    CHECK(hash.find("long", value) && value == longValue);
+
+    CompactHash fieldHash;
+    std::string longField(HASH_MAX_LISTPACK_VALUE + 1, 'f');
+    CHECK(fieldHash.set(longField, "1"));
+    CHECK(!fieldHash.isPacked());
+    CHECK(fieldHash.find(longField, value) && value == "1");
+}
+
+// 连续插入让哈希表多次扩容，每次插入后检查迁移中的两张表都能查到所有字段
+void testIncrementalRehash()
+{
+    CompactHash hash;
+    for (int i = 0; i < 5000; i++)
+    {
+        hash.set("key" + std::to_string(i), std::to_string(i));
+        if (i % 97 == 0)
+        {
+            for (int j = 0; j <= i; j++)
+            {
+                std::string_view value;
+                CHECK(hash.find("key" + std::to_string(j), value) && value == std::to_string(j));
+            }
+        }
+    }
+    CHECK(hash.size() == 5000);
+}
+
+// 大量删除后再插入：旧表满是墓碑时新表按存活字段数分配，迁移完成前新表就会装满，触发一次性重建；
+// 迁移期间删除的字段不能从旧表复活
+void testEraseAndRebuildDuringRehash()
+{
+    CompactHash hash;
+    std::map<std::string, std::string> expected;
+    for (int round = 0; round < 5; round++)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            std::string field = "r" + std::to_string(round) + "_" + std::to_string(i);
+            hash.set(field, field);
+            expected[field] = field;
+        }
+        for (int i = 0; i < 1000; i++)
+        {
+            if (i % 100 == 0)
+            {
+                continue;
+            }
+            std::string field = "r" + std::to_string(round) + "_" + std::to_string(i);
+            CHECK(hash.erase(field));
+            CHECK(!hash.erase(field));
+            expected.erase(field);
+        }
+        CHECK(sameContent(hash, expected));
+    }
+}
+
+// 随机操作和std::map对照，覆盖转换、扩容、迁移中的增删改查
+void testRandomOperations()
+{
+    std::mt19937 random(20240601);
+    CompactHash hash;
+    std::map<std::string, std::string> expected;
+    for (int i = 0; i < 200000; i++)
+    {
+        std::string field = "f" + std::to_string(random() % 3000);
+        int operation = random() % 10;
+        if (operation < 5)
+        {
+            std::string value = std::to_string(random());
+            bool created = expected.find(field) == expected.end();
+            CHECK(hash.set(field, value) == created);
+            expected[field] = value;
+        }
+        else if (operation < 8)
+        {
+            CHECK(hash.erase(field) == (expected.erase(field) == 1));
+        }
+        else
+        {
+            std::string_view value;
+            auto it = expected.find(field);
+            CHECK(hash.find(field, value) == (it != expected.end()));
+            CHECK(it == expected.end() || value == it->second);
+        }
+        CHECK(hash.size() == expected.size());
+        if (i % 20000 == 0)
+        {
+            CHECK(sameContent(hash, expected));
+        }
+    }
+    CHECK(sameContent(hash, expected));
+}
+}
+
+int main()
+{
+    testConvertByCount();
+    testConvertByLength();
+    testIncrementalRehash();
+    testEraseAndRebuildDuringRehash();
+    testRandomOperations();
+    return testResult();
+}
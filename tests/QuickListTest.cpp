@@ -0,0 +1,200 @@
+#include "RedisValue/QuickList.h"
+#include "TestCheck.h"
+#include <deque>
+#include <random>
+#include <string>
+
+namespace
+{
+// 列表中的元素和参照的deque完全一致
+bool sameContent(const QuickList &list, const std::deque<std::string> &expected)
+{
+    if (list.size() != expected.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        if (list[i] != expected[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 只有一个节点时从QUICKLIST_MIN_NODE_SIZE开始扩容，两端插入都要保持顺序
+void testSmallNodeGrowth()
+{
+    QuickList list;
+    std::deque<std::string> expected;
+    for (int i = 0; i < QUICKLIST_NODE_SIZE; i++)
+    {
+        std::string value = std::to_string(i);
+        if (i % 3 == 0)
+        {
+            list.pushFront(value);
+            expected.push_front(value);
+        }
+        else
+        {
+            list.pushBack(value);
+            expected.push_back(value);
+        }
+        CHECK(sameContent(list, expected));
+    }
+}
+
+// 超过一个节点后按下标访问、修改跨越节点边界的元素
+void testMultipleNodes()
+{
+    QuickList list;
+    std::deque<std::string> expected;
+    for (int i = 0; i < QUICKLIST_NODE_SIZE * 5 + 7; i++)
+    {
+        list.pushBack(std::to_string(i));
+        expected.push_back(std::to_string(i));
+    }
+    for (int i = 0; i < QUICKLIST_NODE_SIZE * 2 + 3; i++)
+    {
+        list.pushFront("front" + std::to_string(i));
+        expected.push_front("front" + std::to_string(i));
+    }
+    CHECK(sameContent(list, expected));
+    for (size_t i = 0; i < expected.size(); i += 17)
+    {
+        list[i] = "changed" + std::to_string(i);
+        expected[i] = "changed" + std::to_string(i);
+    }
+    CHECK(sameContent(list, expected));
+    QuickList copy(list);
+    CHECK(copy == list);
+    QuickList moved(std::move(copy));
+    CHECK(moved == list);
+}
+
+// 两端弹出直到为空，节点被逐个释放后还能继续使用
+void testPops()
+{
+    QuickList list;
+    std::deque<std::string> expected;
+    for (int i = 0; i < QUICKLIST_NODE_SIZE * 3; i++)
+    {
+        list.pushBack(std::to_string(i));
+        expected.push_back(std::to_string(i));
+    }
+    while (!expected.empty())
+    {
+        if (expected.size() % 2 == 0)
+        {
+            CHECK(list.popFront() == expected.front());
+            expected.pop_front();
+        }
+        else
+        {
+            CHECK(list.popBack() == expected.back());
+            expected.pop_back();
+        }
+        CHECK(list.size() == expected.size());
+    }
+    CHECK(list.empty());
+    list.pushFront("again");
+    CHECK(list.size() == 1 && list[0] == "again");
+}
+
+// trim只保留[start, stop]之间的元素，start > stop时清空
+void testTrim()
+{
+    for (size_t size : {1, 5, QUICKLIST_NODE_SIZE, QUICKLIST_NODE_SIZE * 4 + 9})
+    {
+        for (size_t start : {size_t(0), size / 3, size - 1})
+        {
+            for (size_t stop : {start, size / 2, size - 1})
+            {
+                QuickList list;
+                std::deque<std::string> expected;
+                for (size_t i = 0; i < size; i++)
+                {
+                    list.pushBack(std::to_string(i));
+                    expected.push_back(std::to_string(i));
+                }
+                list.trim(start, stop);
+                if (start > stop)
+                {
+                    expected.clear();
+                }
+                else
+                {
+                    expected.erase(expected.begin() + stop + 1, expected.end());
+                    expected.erase(expected.begin(), expected.begin() + start);
+                }
+                CHECK(sameContent(list, expected));
+                list.pushFront("head");
+                expected.push_front("head");
+                CHECK(sameContent(list, expected));
+            }
+        }
+    }
+}
+
+// 随机操作和std::deque对照
+void testRandomOperations()
+{
+    std::mt19937 random(20240601);
+    QuickList list;
+    std::deque<std::string> expected;
+    for (int i = 0; i < 200000; i++)
+    {
+        int operation = random() % 100;
+        if (operation < 30)
+        {
+            list.pushBack(std::to_string(i));
+            expected.push_back(std::to_string(i));
+        }
+        else if (operation < 60)
+        {
+            list.pushFront(std::to_string(i));
+            expected.push_front(std::to_string(i));
+        }
+        else if (operation < 75 && !expected.empty())
+        {
+            CHECK(list.popBack() == expected.back());
+            expected.pop_back();
+        }
+        else if (operation < 90 && !expected.empty())
+        {
+            CHECK(list.popFront() == expected.front());
+            expected.pop_front();
+        }
+        else if (operation < 99 && !expected.empty())
+        {
+            size_t index = random() % expected.size();
+            CHECK(list[index] == expected[index]);
+        }
+        else if (!expected.empty())
+        {
+            size_t start = random() % expected.size();
+            size_t stop = start + random() % (expected.size() - start);
+            list.trim(start, stop);
+            expected.erase(expected.begin() + stop + 1, expected.end());
+            expected.erase(expected.begin(), expected.begin() + start);
+        }
+        CHECK(list.size() == expected.size());
+        if (i % 10000 == 0)
+        {
+            CHECK(sameContent(list, expected));
+        }
+    }
+    CHECK(sameContent(list, expected));
+}
+}
+
+int main()
+{
+    testSmallNodeGrowth();
+    testMultipleNodes();
+    testPops();
+    testTrim();
+    testRandomOperations();
+    return testResult();
+}
@@ -0,0 +1,124 @@
+#include "SkipList.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#define SKIP_LIST_TEST_THREADS 8
+#define SKIP_LIST_TEST_KEYS 4 // key很少，同一个key上的删除和重新插入频繁交错
+#define SKIP_LIST_TEST_FIXED_KEYS 256 // 始终存在的key，让节点有足够的层高，热点key夹在它们中间
+#define SKIP_LIST_TEST_OPERATIONS 100000
+
+namespace
+{
+typedef SkipList<std::string, std::string> TestList;
+
+// 遍历结果严格递增，个数和size()一致，每个key都能查到
+bool consistent(TestList &list)
+{
+    EpochGuard guard;
+    bool ordered = true;
+    bool found = true;
+    int count = 0;
+    std::string previous;
+    list.forEach([&](const std::string &key, std::string &value)
+                 {
+        ordered = ordered && (count == 0 || previous < key);
+        found = found && list.searchItem(key) != nullptr && value == key;
+        previous = key;
+        count++; });
+    return ordered && found && count == list.size();
+}
+
+std::string hotKey(int i)
+{
+    return "key" + std::to_string(i * SKIP_LIST_TEST_FIXED_KEYS / SKIP_LIST_TEST_KEYS) + "~";
+}
+
+// 多个线程在少数几个key上并发插入、删除和查找；删除的节点被回收复用后不能再从任何一层访问到，
+// 否则高层指针指向复用的节点，始终存在的key会查找不到
+void testSameKeyDeleteAndReinsert(bool useHashIndex)
+{
+    TestList list(useHashIndex);
+    for (int i = 0; i < SKIP_LIST_TEST_FIXED_KEYS; i++)
+    {
+        std::string key = "key" + std::to_string(i);
+        CHECK(list.addItem(key, key));
+    }
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < SKIP_LIST_TEST_THREADS; t++)
+    {
+        threads.emplace_back([&list, &mismatches, t]()
+                             {
+            std::mt19937 random(20240601 + t);
+            for (int i = 0; i < SKIP_LIST_TEST_OPERATIONS; i++)
+            {
+                std::string key = hotKey(random() % SKIP_LIST_TEST_KEYS);
+                int operation = random() % 5;
+                if (operation == 0)
+                {
+                    list.addItem(key, key);
+                }
+                else if (operation == 1)
+                {
+                    list.upsert(key, key, [&](std::string &value, bool)
+                                {
+                        if (value != key)
+                        {
+                            mismatches++;
+                        } });
+                }
+                else if (operation == 2)
+                {
+                    list.deleteItem(key);
+                }
+                else if (operation == 3)
+                {
+                    EpochGuard guard;
+                    auto *node = list.searchItem(key);
+                    if (node != nullptr && node->key != key)
+                    {
+                        mismatches++;
+                    }
+                }
+                else
+                {
+                    EpochGuard guard;
+                    std::string fixedKey = "key" + std::to_string(random() % SKIP_LIST_TEST_FIXED_KEYS);
+                    auto *node = list.searchItem(fixedKey);
+                    if (node == nullptr || node->key != fixedKey)
+                    {
+                        mismatches++;
+                    }
+                }
+            } });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(mismatches.load() == 0);
+    CHECK(consistent(list));
+    for (int i = 0; i < SKIP_LIST_TEST_KEYS; i++)
+    {
+        list.deleteItem(hotKey(i));
+    }
+    CHECK(list.size() == SKIP_LIST_TEST_FIXED_KEYS);
+    CHECK(consistent(list));
+    for (int i = 0; i < SKIP_LIST_TEST_KEYS; i++)
+    {
+        CHECK(list.addItem(hotKey(i), hotKey(i)));
+    }
+    CHECK(list.size() == SKIP_LIST_TEST_FIXED_KEYS + SKIP_LIST_TEST_KEYS);
+    CHECK(consistent(list));
+}
+}
+
+int main()
+{
+    testSameKeyDeleteAndReinsert(false);
+    testSameKeyDeleteAndReinsert(true);
+    return testResult();
+}
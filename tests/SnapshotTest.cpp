@@ -0,0 +1,191 @@
+#include "Snapshot.h"
+#include "RedisValue/CompactHash.h"
+#include "RedisValue/QuickList.h"
+#include "TestCheck.h"
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#define SNAPSHOT_TEST_FILE "snapshot_test.trdb"
+
+namespace
+{
+std::map<std::string, RedisValue> readAll(const std::string &filePath, bool &valid)
+{
+    std::map<std::string, RedisValue> entries;
+    SnapshotReader reader(filePath);
+    std::string key;
+    RedisValue value;
+    while (reader.readEntry(key, value))
+    {
+        entries[key] = value;
+    }
+    valid = reader.isSnapshot() && reader.isValid();
+    return entries;
+}
+
+std::string readFile(const std::string &filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string &filePath, const std::string &data)
+{
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+}
+
+// 各种类型和编码的值写入后原样读回
+void testRoundTrip()
+{
+    QuickList list;
+    list.pushBack("a");
+    list.pushBack("42"); // 元素按整数编码写入，读回仍是字符串
+    list.pushBack(std::string("bin\0ary", 7));
+    CompactHash smallHash;
+    smallHash.set("field", "value");
+    smallHash.set("count", "-7");
+    CompactHash largeHash;
+    for (int i = 0; i < HASH_MAX_LISTPACK_ENTRIES * 2; i++)
+    {
+        largeHash.set("f" + std::to_string(i), std::to_string(i * 1.5));
+    }
+    CHECK(!largeHash.isPacked());
+
+    std::map<std::string, RedisValue> expected;
+    expected["string"] = RedisValue("hello");
+    expected["empty"] = RedisValue("");
+    expected["digits"] = RedisValue("0123"); // 不是规范的整数写法，按字符串保存
+    expected["integer"] = RedisValue(int64_t(-1234567890123));
+    expected["double"] = RedisValue(3.25);
+    expected["list"] = RedisValue(QuickList(list));
+    expected["smallHash"] = RedisValue(CompactHash(smallHash));
+    expected["largeHash"] = RedisValue(CompactHash(largeHash));
+
+    {
+        SnapshotWriter writer(SNAPSHOT_TEST_FILE);
+        CHECK(writer.isOpen());
+        for (auto &entry : expected)
+        {
+            writer.writeEntry(entry.first, entry.second);
+        }
+        CHECK(writer.finish());
+    }
+    bool valid = false;
+    std::map<std::string, RedisValue> entries = readAll(SNAPSHOT_TEST_FILE, valid);
+    CHECK(valid);
+    CHECK(entries.size() == expected.size());
+    for (auto &entry : expected)
+    {
+        auto it = entries.find(entry.first);
+        CHECK(it != entries.end());
+        if (it == entries.end())
+        {
+            continue;
+        }
+        RedisValue &value = it->second;
+        CHECK(value.type() == entry.second.type());
+        CHECK(value.toString() == entry.second.toString());
+        if (value.isList())
+        {
+            CHECK(value.listItems() == entry.second.listItems());
+        }
+        if (value.isHash())
+        {
+            CHECK(value.hashItems() == entry.second.hashItems());
+        }
+    }
+}
+
+// 头部记下写入时追加日志的代数和偏移，读回后用于跳过日志中快照已包含的记录
+void testLogPosition()
+{
+    AppendOnlyFile::Position position;
+    position.generation = 0x123456789abcdefULL;
+    position.offset = 98765;
+    {
+        SnapshotWriter writer(SNAPSHOT_TEST_FILE, position);
+        writer.writeEntry("key", RedisValue("value"));
+        CHECK(writer.finish());
+    }
+    SnapshotReader reader(SNAPSHOT_TEST_FILE);
+    std::string key;
+    RedisValue value;
+    CHECK(reader.readEntry(key, value) && key == "key");
+    CHECK(!reader.readEntry(key, value) && reader.isValid());
+    AppendOnlyFile::Position loaded = reader.getLogPosition();
+    CHECK(loaded.generation == position.generation && loaded.offset == position.offset);
+
+    {
+        SnapshotWriter writer(SNAPSHOT_TEST_FILE); // 不对应任何日志
+        CHECK(writer.finish());
+    }
+    SnapshotReader emptyReader(SNAPSHOT_TEST_FILE);
+    CHECK(!emptyReader.readEntry(key, value) && emptyReader.isValid());
+    CHECK(emptyReader.getLogPosition().generation == 0);
+}
+
+// 改动一个字节后校验和不匹配，文件按损坏处理
+void testChecksum()
+{
+    {
+        SnapshotWriter writer(SNAPSHOT_TEST_FILE);
+        writer.writeEntry("key", RedisValue("value"));
+        CHECK(writer.finish());
+    }
+    std::string data = readFile(SNAPSHOT_TEST_FILE);
+    data[data.size() - 6] ^= 1; // 值的最后一个字节
+    writeFile(SNAPSHOT_TEST_FILE, data);
+    bool valid = true;
+    readAll(SNAPSHOT_TEST_FILE, valid);
+    CHECK(!valid);
+}
+
+// 损坏的长度超过文件剩余字节数时直接判为损坏，不按这个长度分配内存
+void testCorruptLength()
+{
+    std::string data(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE);
+    data += static_cast<char>(SNAPSHOT_VERSION);
+    data += '\0'; // 日志代数
+    data += '\0'; // 日志偏移
+    data += static_cast<char>(SNAPSHOT_STRING);
+    for (int i = 0; i < 8; i++)
+    {
+        data += static_cast<char>(0xFF); // key的长度约为2^56
+    }
+    data += '\x01';
+    data += "key";
+    writeFile(SNAPSHOT_TEST_FILE, data);
+    bool valid = true;
+    std::map<std::string, RedisValue> entries = readAll(SNAPSHOT_TEST_FILE, valid);
+    CHECK(!valid);
+    CHECK(entries.empty());
+}
+
+// 截断的文件没有结束标记，按损坏处理
+void testTruncated()
+{
+    {
+        SnapshotWriter writer(SNAPSHOT_TEST_FILE);
+        writer.writeEntry("key", RedisValue(std::string(1000, 'x')));
+        CHECK(writer.finish());
+    }
+    std::string data = readFile(SNAPSHOT_TEST_FILE);
+    writeFile(SNAPSHOT_TEST_FILE, data.substr(0, data.size() / 2));
+    bool valid = true;
+    readAll(SNAPSHOT_TEST_FILE, valid);
+    CHECK(!valid);
+}
+}
+
+int main()
+{
+    testRoundTrip();
+    testLogPosition();
+    testChecksum();
+    testCorruptLength();
+    testTruncated();
+    std::remove(SNAPSHOT_TEST_FILE);
+    return testResult();
+}
@@ -0,0 +1,31 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+#include <iostream>
+
+/*
+    测试用的检查宏：条件不成立时输出文件、行号和条件，继续执行后面的检查，
+    main最后返回testResult()，有检查失败时以非零退出码结束，ctest据此判断测试失败。
+*/
+static int testFailures = 0;
+
+#define CHECK(condition)                                                                              \
+    do                                                                                                \
+    {                                                                                                 \
+        if (!(condition))                                                                             \
+        {                                                                                             \
+            std::cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            testFailures++;                                                                           \
+        }                                                                                             \
+    } while (0)
+
+inline int testResult()
+{
+    if (testFailures > 0)
+    {
+        std::cout << testFailures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#endif